@@ -0,0 +1,199 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+
+/*
+** Send and receive benchmarks on the host model
+**
+** Each run is reported as one JSON line on stdout: SPI bytes per payload
+** byte, transactions per datagram and host CPU time per byte. Given a file
+** of such lines as baselines, a run whose bus efficiency is worse than its
+** baseline by more than TOLERANCE fails the program with 1, and a driver call
+** that does not return what the run expects fails it with 2. To take new
+** baselines, which leave out the CPU time:
+**
+**   build/bench -b > bench_baselines.json
+**
+************************************/
+
+#define TOLERANCE 0.02     //Fraction a run may be worse than its baseline
+#define MAX_BASELINES 96
+#define UDP_SOCKET 1
+#define TCP_SOCKET 2
+#define SENDS 20
+#define DATAGRAMS 4
+
+static const uint16_t lengths[] = {1, 16, 64, 256, 1024};
+static const uint8_t escapes[] = {0, 1, 10, 50};
+
+static struct wiznetHostBaseline baselines[MAX_BASELINES];
+static int baselineCount;
+static int regressions;
+static int errors;
+static uint8_t timing = 1;
+static uint8_t payload[1024];
+static uint8_t buf[2 * 1024 + 2];
+
+/* This function reports a finished run and checks it against its baseline
+*/
+static void finish(struct wiznetHostBench* bench, uint32_t bytes, uint32_t datagrams) {
+	wiznetHostBenchEnd(bench, bytes, datagrams);
+	wiznetHostBenchReport(bench, stdout, timing);
+	if (wiznetHostBenchCheck(bench, baselines, baselineCount, TOLERANCE) != 0) {
+		fprintf(stderr, "regression: %s\n", bench->name);
+		regressions++;
+	}
+}
+
+/* This function notes a call within a run that did not return what was
+** expected of it
+*/
+static void expect(const char* run, const char* call, int ret, int want) {
+	if (ret != want) {
+		fprintf(stderr, "error: %s: %s returned %d\n", run, call, ret);
+		errors++;
+	}
+}
+
+/* This function SLIP-encodes payload into buf as one frame
+*/
+static uint16_t encodeSLIP(uint16_t length) {
+	uint16_t n = 0, i;
+
+	buf[n++] = 0xC0;
+	for (i = 0; i < length; i++) {
+		if (payload[i] == 0xC0 || payload[i] == 0xDB) {
+			buf[n++] = 0xDB;
+			buf[n++] = (payload[i] == 0xC0) ? 0xDC : 0xDD;
+		} else
+			buf[n++] = payload[i];
+	}
+	buf[n++] = 0xC0;
+	return n;
+}
+
+static void benchOpen(const uint8_t* ip) {
+	struct wiznetHostBench bench;
+	uint8_t i;
+
+	wiznetHostBenchBegin(&bench, "open/udp");
+	for (i = 0; i < 10; i++)
+		expect(bench.name, "wiznetOpenSocket", wiznetOpenSocket(UDP_SOCKET, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	finish(&bench, 0, 10);
+
+	wiznetHostBenchBegin(&bench, "open+connect/tcp");
+	for (i = 0; i < 10; i++) {
+		expect(bench.name, "wiznetOpenSocket", wiznetOpenSocket(TCP_SOCKET, SOCK_TCP, 80, 0), WIZNET_SUCCESS);
+		expect(bench.name, "wiznetConnectSocket", wiznetConnectSocket(TCP_SOCKET, (uint8_t*)ip, 80), WIZNET_SUCCESS);
+	}
+	finish(&bench, 0, 10);
+}
+
+static void benchSend(uint16_t length, uint32_t* seed) {
+	struct wiznetHostBench bench;
+	char name[48];
+	uint8_t i, e;
+
+	wiznetHostFillPayload(payload, length, 0, seed);
+	sprintf(name, "sendData/%u", length);
+	wiznetHostBenchBegin(&bench, name);
+	for (i = 0; i < SENDS; i++) {
+		expect(name, "wiznetSendBegin", wiznetSendBegin(TCP_SOCKET), WIZNET_SUCCESS);
+		wiznetSendData(payload, length);
+		expect(name, "wiznetSendCommit", wiznetSendCommit(), WIZNET_SUCCESS);
+	}
+	finish(&bench, (uint32_t)SENDS * length, SENDS);
+
+	for (e = 0; e < sizeof(escapes); e++) {
+		wiznetHostFillPayload(payload, length, escapes[e], seed);
+		sprintf(name, "sendSLIPData/%u/esc%u", length, escapes[e]);
+		wiznetHostBenchBegin(&bench, name);
+		for (i = 0; i < SENDS; i++) {
+			expect(name, "wiznetSendBeginSLIP", wiznetSendBeginSLIP(TCP_SOCKET), WIZNET_SUCCESS);
+			wiznetSendSLIPData(payload, length);
+			expect(name, "wiznetSendCommitSLIP", wiznetSendCommitSLIP(), WIZNET_SUCCESS);
+		}
+		finish(&bench, (uint32_t)SENDS * length, SENDS);
+	}
+}
+
+static void benchRecv(uint16_t length, const uint8_t* ip, uint32_t* seed) {
+	struct wiznetHostBench bench;
+	uint8_t from[4];
+	uint16_t port;
+	char name[48];
+	uint8_t i, e;
+
+	wiznetHostFillPayload(payload, length, 0, seed);
+	sprintf(name, "recvHeaderUDP+recvData/%u", length);
+	for (i = 0; i < DATAGRAMS; i++)
+		expect(name, "wiznetHostInjectUDP", wiznetHostInjectUDP(UDP_SOCKET, ip, 7, payload, length), 0);
+	wiznetHostBenchBegin(&bench, name);
+	for (i = 0; i < DATAGRAMS; i++) {
+		expect(name, "wiznetRecvBegin", wiznetRecvBegin(UDP_SOCKET), WIZNET_SUCCESS);
+		expect(name, "wiznetRecvHeaderUDP", wiznetRecvHeaderUDP(from, &port), length);
+		wiznetRecvData(buf, length);
+		expect(name, "wiznetRecvCommit", wiznetRecvCommit(length), WIZNET_SUCCESS);
+	}
+	finish(&bench, (uint32_t)DATAGRAMS * length, DATAGRAMS);
+
+	sprintf(name, "recvData/%u", length);
+	expect(name, "wiznetHostInjectRaw", wiznetHostInjectRaw(TCP_SOCKET, payload, length), 0);
+	wiznetHostBenchBegin(&bench, name);
+	expect(name, "wiznetRecvBegin", wiznetRecvBegin(TCP_SOCKET), WIZNET_SUCCESS);
+	wiznetRecvData(buf, length);
+	expect(name, "wiznetRecvCommit", wiznetRecvCommit(0), WIZNET_SUCCESS);
+	finish(&bench, length, 1);
+
+	for (e = 0; e < sizeof(escapes); e++) {
+		wiznetHostFillPayload(payload, length, escapes[e], seed);
+		sprintf(name, "recvSLIPData/%u/esc%u", length, escapes[e]);
+		expect(name, "wiznetHostInjectRaw", wiznetHostInjectRaw(TCP_SOCKET, buf, encodeSLIP(length)), 0);
+		wiznetHostBenchBegin(&bench, name);
+		expect(name, "wiznetRecvBeginSLIP", wiznetRecvBeginSLIP(TCP_SOCKET), WIZNET_SUCCESS);
+		expect(name, "wiznetRecvSLIPData", wiznetRecvSLIPData(buf, length), 0);
+		expect(name, "wiznetRecvCommitSLIP", wiznetRecvCommitSLIP(), WIZNET_SUCCESS);
+		finish(&bench, length, 1);
+	}
+}
+
+int main(int argc, char** argv) {
+	uint8_t sizes[8] = {1, 8, 2, 1, 1, 1, 1, 1};  //Room for DATAGRAMS of the largest length
+	uint8_t ip[4] = {10, 0, 0, 2};
+	uint32_t seed = 1;
+	uint8_t k;
+	FILE* in;
+
+	if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+		timing = 0;
+		argc--;
+		argv++;
+	}
+	if (argc > 1) {
+		if ((in = fopen(argv[1], "r")) == NULL) {
+			perror(argv[1]);
+			return 2;
+		}
+		baselineCount = wiznetHostBenchLoadBaselines(in, baselines, MAX_BASELINES);
+		fclose(in);
+	}
+
+	wiznetHostInit();
+	wiznetReset();
+	if (wiznetInit(sizes) != WIZNET_SUCCESS) {
+		fprintf(stderr, "error: wiznetInit failed\n");
+		return 2;
+	}
+	benchOpen(ip);
+	for (k = 0; k < sizeof(lengths) / sizeof(lengths[0]); k++) {
+		benchSend(lengths[k], &seed);
+		benchRecv(lengths[k], ip, &seed);
+	}
+	if (errors)
+		fprintf(stderr, "%d errors\n", errors);
+	if (regressions)
+		fprintf(stderr, "%d regressions\n", regressions);
+	return errors ? 2 : regressions ? 1 : 0;
+}
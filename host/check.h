@@ -0,0 +1,28 @@
+#ifndef CHECK_H
+#define CHECK_H
+#include <stdio.h>
+
+/*
+** Assertions for the host-model tests. A failed check is reported with its
+** line and counted, and main returns checkFailures so that make stops.
+*/
+
+static int checkFailures;
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		checkFailures++; \
+	} \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+	long checkA = (long)(a), checkB = (long)(b); \
+	if (checkA != checkB) { \
+		fprintf(stderr, "%s:%d: check failed: %s == %s (%ld != %ld)\n", \
+				__FILE__, __LINE__, #a, #b, checkA, checkB); \
+		checkFailures++; \
+	} \
+} while (0)
+
+#endif
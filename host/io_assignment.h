@@ -0,0 +1,9 @@
+#ifndef IO_ASSIGNMENT_H
+#define IO_ASSIGNMENT_H
+
+/*
+** Stand-in for the io_assignment.h a project provides, for the host-model
+** builds. The model needs no pins.
+*/
+
+#endif
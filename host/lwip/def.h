@@ -0,0 +1,5 @@
+#ifndef LWIP_HDR_DEF_H
+#define LWIP_HDR_DEF_H
+#include "lwip/opt.h"
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef LWIP_HDR_ERR_H
+#define LWIP_HDR_ERR_H
+#include "lwip/opt.h"
+
+typedef int8_t err_t;
+
+enum {
+	ERR_OK = 0,
+	ERR_MEM = -1,
+	ERR_IF = -12
+};
+
+#endif
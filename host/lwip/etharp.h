@@ -0,0 +1,7 @@
+#ifndef LWIP_HDR_ETHARP_H
+#define LWIP_HDR_ETHARP_H
+#include "lwip/netif.h"
+
+err_t etharp_output(struct netif* netif, struct pbuf* q, const void* ipaddr);
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef LWIP_HDR_ETHIP6_H
+#define LWIP_HDR_ETHIP6_H
+#include "lwip/netif.h"
+
+err_t ethip6_output(struct netif* netif, struct pbuf* q, const void* ip6addr);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef LWIP_HDR_NETIF_H
+#define LWIP_HDR_NETIF_H
+#include "lwip/opt.h"
+#include "lwip/err.h"
+#include "lwip/pbuf.h"
+
+#define NETIF_FLAG_UP 0x01U
+#define NETIF_FLAG_BROADCAST 0x02U
+#define NETIF_FLAG_LINK_UP 0x04U
+#define NETIF_FLAG_ETHARP 0x08U
+#define NETIF_FLAG_ETHERNET 0x10U
+
+struct netif;
+typedef err_t (*netif_input_fn)(struct pbuf* p, struct netif* inp);
+typedef err_t (*netif_output_fn)(struct netif* netif, struct pbuf* p, const void* ipaddr);
+typedef err_t (*netif_linkoutput_fn)(struct netif* netif, struct pbuf* p);
+
+struct netif {
+	netif_input_fn input;
+	netif_output_fn output;
+	netif_output_fn output_ip6;
+	netif_linkoutput_fn linkoutput;
+	uint16_t mtu;
+	uint8_t hwaddr[6];
+	uint8_t hwaddr_len;
+	uint8_t flags;
+	char name[2];
+};
+
+#endif
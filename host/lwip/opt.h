@@ -0,0 +1,25 @@
+#ifndef LWIP_HDR_OPT_H
+#define LWIP_HDR_OPT_H
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+** Stand-in for the part of lwIP used by wiznet_lwip.c, for the host-model
+** builds. Only what the port touches is here, with lwIP's names and
+** meanings; lwip_stub.c implements it.
+*/
+
+#ifndef LWIP_IPV4
+#define LWIP_IPV4 1
+#endif
+#ifndef LWIP_IPV6
+#define LWIP_IPV6 1
+#endif
+#ifndef ETH_PAD_SIZE
+#define ETH_PAD_SIZE 0
+#endif
+#ifndef PBUF_POOL_BUFSIZE
+#define PBUF_POOL_BUFSIZE 256
+#endif
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef LWIP_HDR_PBUF_H
+#define LWIP_HDR_PBUF_H
+#include "lwip/opt.h"
+#include "lwip/err.h"
+
+typedef enum {
+	PBUF_RAW = 0
+} pbuf_layer;
+
+typedef enum {
+	PBUF_RAM,
+	PBUF_POOL
+} pbuf_type;
+
+// PBUF_POOL allocations are chains of PBUF_POOL_BUFSIZE pbufs, PBUF_RAM
+// allocations a single pbuf, as in lwIP
+struct pbuf {
+	struct pbuf* next;
+	void* payload;
+	uint16_t tot_len;
+	uint16_t len;
+};
+
+struct pbuf* pbuf_alloc(pbuf_layer layer, uint16_t length, pbuf_type type);
+uint8_t pbuf_free(struct pbuf* p);
+uint16_t pbuf_clen(const struct pbuf* p);
+struct pbuf* pbuf_clone(pbuf_layer layer, pbuf_type type, struct pbuf* p);
+uint8_t pbuf_remove_header(struct pbuf* p, size_t size);
+uint8_t pbuf_add_header(struct pbuf* p, size_t size);
+
+// Controls of the stand-in
+extern uint32_t lwipStubPbufsInUse;
+void lwipStubFailNextAlloc(void);
+
+#endif
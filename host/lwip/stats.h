@@ -0,0 +1,21 @@
+#ifndef LWIP_HDR_STATS_H
+#define LWIP_HDR_STATS_H
+#include "lwip/opt.h"
+
+struct stats_proto {
+	uint32_t xmit;
+	uint32_t recv;
+	uint32_t drop;
+	uint32_t memerr;
+	uint32_t err;
+};
+
+struct stats_ {
+	struct stats_proto link;
+};
+
+extern struct stats_ lwip_stats;
+
+#define LINK_STATS_INC(x) (lwip_stats.x++)
+
+#endif
@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lwip/opt.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/etharp.h"
+#include "lwip/ethip6.h"
+
+/*
+** Stand-in for the lwIP functions wiznet_lwip.c calls. Each pbuf is one
+** allocation holding its own data, and every one handed out is counted so
+** that a test can check none is leaked.
+*/
+
+struct stats_ lwip_stats;
+uint32_t lwipStubPbufsInUse;
+static uint8_t failNext;
+
+/* This function makes the next pbuf_alloc or pbuf_clone fail, as when the
+** pool has run out
+*/
+void lwipStubFailNextAlloc(void) {
+	failNext = 1;
+}
+
+/* This function allocates one pbuf with room for len bytes
+*/
+static struct pbuf* stubPbuf(uint16_t len) {
+	struct pbuf* p = malloc(sizeof(*p) + len);
+	if (p == NULL)
+		abort();
+	p->next = NULL;
+	p->payload = p + 1;
+	p->len = len;
+	p->tot_len = len;
+	lwipStubPbufsInUse++;
+	return p;
+}
+
+struct pbuf* pbuf_alloc(pbuf_layer layer, uint16_t length, pbuf_type type) {
+	struct pbuf *p = NULL, **tail = &p;
+	uint16_t left = length, len;
+
+	(void)layer;
+	if (failNext) {
+		failNext = 0;
+		return NULL;
+	}
+	do {
+		len = (type == PBUF_POOL && left > PBUF_POOL_BUFSIZE) ? PBUF_POOL_BUFSIZE : left;
+		*tail = stubPbuf(len);
+		(*tail)->tot_len = left;
+		tail = &(*tail)->next;
+		left -= len;
+	} while (left);
+	return p;
+}
+
+uint8_t pbuf_free(struct pbuf* p) {
+	struct pbuf* next;
+	uint8_t count = 0;
+
+	while (p != NULL) {
+		next = p->next;
+		free(p);
+		lwipStubPbufsInUse--;
+		count++;
+		p = next;
+	}
+	return count;
+}
+
+uint16_t pbuf_clen(const struct pbuf* p) {
+	uint16_t count = 0;
+	for (; p != NULL; p = p->next)
+		count++;
+	return count;
+}
+
+struct pbuf* pbuf_clone(pbuf_layer layer, pbuf_type type, struct pbuf* p) {
+	struct pbuf* q = pbuf_alloc(layer, p->tot_len, type);
+	uint16_t offset = 0;
+
+	if (q == NULL)
+		return NULL;
+	for (; p != NULL; p = p->next) {
+		memcpy((uint8_t*)q->payload + offset, p->payload, p->len);
+		offset += p->len;
+	}
+	return q;
+}
+
+// As in lwIP, only the first pbuf of the chain moves its payload
+uint8_t pbuf_remove_header(struct pbuf* p, size_t size) {
+	if (size > p->len)
+		return 1;
+	p->payload = (uint8_t*)p->payload + size;
+	p->len -= size;
+	p->tot_len -= size;
+	return 0;
+}
+
+uint8_t pbuf_add_header(struct pbuf* p, size_t size) {
+	p->payload = (uint8_t*)p->payload - size;
+	p->len += size;
+	p->tot_len += size;
+	return 0;
+}
+
+err_t etharp_output(struct netif* netif, struct pbuf* q, const void* ipaddr) {
+	(void)ipaddr;
+	return netif->linkoutput(netif, q);
+}
+
+err_t ethip6_output(struct netif* netif, struct pbuf* q, const void* ip6addr) {
+	(void)ip6addr;
+	return netif->linkoutput(netif, q);
+}
@@ -0,0 +1,7 @@
+#ifndef LWIP_HDR_NETIF_ETHERNET_H
+#define LWIP_HDR_NETIF_ETHERNET_H
+#include "lwip/netif.h"
+
+#define ETH_HWADDR_LEN 6
+
+#endif
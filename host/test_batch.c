@@ -0,0 +1,114 @@
+#include <stdint.h>
+#include <string.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** Batched UDP receive: every waiting datagram taken with one read of
+** Sn_RX_RSR, one SPI transaction for all the data and a single RECEIVE,
+** whatever the number of datagrams
+*/
+
+#define DGRAMS 6
+
+static uint8_t payload[DGRAMS][120];
+static uint8_t back[DGRAMS][120];
+static struct wiznetDatagram dgrams[DGRAMS];
+
+/* This function returns the SPI transactions since it was last called
+*/
+static uint32_t transactions(void) {
+	struct wiznetHostStats stats;
+
+	wiznetHostGetStats(&stats);
+	wiznetHostResetStats();
+	return stats.transactions;
+}
+
+/* This function has datagrams first to first+count-1 arrive on the socket
+*/
+static void inject(uint8_t first, uint8_t count) {
+	static const uint8_t ip[4] = {10, 0, 0, 2};
+	uint8_t i;
+
+	for (i = first; i < first + count; i++)
+		CHECK_EQ(wiznetHostInjectUDP(1, ip, 7000 + i, payload[i], 20 * (i + 1)), 0);
+}
+
+/* This function checks a received datagram against the one sent
+*/
+static void checkDatagram(uint8_t slot, uint8_t i) {
+	CHECK_EQ(dgrams[slot].length, 20 * (i + 1));
+	CHECK_EQ(dgrams[slot].port, 7000 + i);
+	CHECK_EQ(dgrams[slot].ip[3], 2);
+	CHECK(memcmp(back[slot], payload[i], dgrams[slot].length < dgrams[slot].size
+			? dgrams[slot].length : dgrams[slot].size) == 0);
+}
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	struct wiznetTransaction* rx;
+	uint32_t two;
+	uint8_t i, j;
+
+	for (i = 0; i < DGRAMS; i++) {
+		for (j = 0; j < sizeof(payload[i]); j++)
+			payload[i][j] = (uint8_t)(i * 50 + j);
+		dgrams[i].data = back[i];
+		dgrams[i].size = sizeof(back[i]);
+	}
+	wiznetHostInit();
+	wiznetReset();
+	wiznetInit(sizes);
+	CHECK_EQ(wiznetOpenSocket(1, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+
+	// Two datagrams or six cost the same
+	inject(0, 2);
+	transactions();
+	CHECK_EQ(wiznetRecvBatch(1, dgrams, DGRAMS), 2);
+	two = transactions();
+	checkDatagram(0, 0);
+	checkDatagram(1, 1);
+	inject(0, DGRAMS);
+	CHECK_EQ(wiznetRecvBatch(1, dgrams, DGRAMS), DGRAMS);
+	CHECK_EQ(transactions(), two);
+	for (i = 0; i < DGRAMS; i++)
+		checkDatagram(i, i);
+	CHECK_EQ(wiznetRecvPeek(1), 0);
+
+	// No more than count are taken, and the rest wait for the next call
+	inject(0, 3);
+	CHECK_EQ(wiznetRecvBatch(1, dgrams, 2), 2);
+	checkDatagram(0, 0);
+	checkDatagram(1, 1);
+	CHECK_EQ(wiznetRecvPeek(1), 8 + 20 * 3);
+	CHECK_EQ(wiznetRecvBatch(1, dgrams, 2), 1);
+	checkDatagram(0, 2);
+
+	// A datagram longer than its buffer is truncated, its full length
+	// reported, and the next is still found. Skipping the rest of it costs
+	// one more transaction.
+	inject(2, 2);
+	dgrams[0].size = 10;
+	transactions();
+	CHECK_EQ(wiznetRecvBatch(1, dgrams, DGRAMS), 2);
+	CHECK_EQ(transactions(), two + 1);
+	checkDatagram(0, 2);
+	checkDatagram(1, 3);
+	dgrams[0].size = sizeof(back[0]);
+
+	// Nothing waiting costs the one read of Sn_RX_RSR
+	CHECK_EQ(wiznetRecvBatch(1, dgrams, DGRAMS), 0);
+	CHECK_EQ(transactions(), 1);
+
+	// A receive transaction already open on the socket is not disturbed
+	inject(0, 1);
+	CHECK_EQ(wiznetRxBegin(1, &rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvBatch(1, dgrams, DGRAMS), WIZNET_ERROR_RECV_COLLISION);
+	CHECK_EQ(wiznetRxAbandon(rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvBatch(1, dgrams, DGRAMS), 1);
+	checkDatagram(0, 0);
+
+	return checkFailures;
+}
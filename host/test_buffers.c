@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include <string.h>
+#include "util.h"
+#include "io_assignment.h"
+#include "wiznet_arch.h"
+#include "wiznet.h"
+#include "wiznet_io.h"
+#include "wiznet_regs.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** Buffer allocation: sizes that are refused, and with WIZNET_ADAPTIVE_BUFFERS
+** the re-sizing of a socket's buffers when it is reopened, with the higher
+** sockets moved up, shrunk where they no longer fit and never below 1KB
+*/
+
+static uint8_t data[4096];
+
+/* This function returns the SPI transactions since it was last called
+*/
+static uint32_t transactions(void) {
+	struct wiznetHostStats stats;
+
+	wiznetHostGetStats(&stats);
+	wiznetHostResetStats();
+	return stats.transactions;
+}
+
+/* This function allocates the same sizes in both directions and opens a
+** socket for the first time, which keeps them
+*/
+static void allocate(const uint8_t* sizes, uint8_t socket) {
+	uint8_t copy[WIZNET_MAX_SOCKETS];
+
+	memcpy(copy, sizes, sizeof(copy));
+	wiznetHostInit();
+	wiznetReset();
+	CHECK_EQ(wiznetInit(copy), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetOpenSocket(socket, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+}
+
+/* This function fills a socket's RX buffer, lets the driver see it full and
+** then drops the data by closing the socket
+*/
+static void overrun(uint8_t socket, uint16_t size) {
+	struct wiznetTransaction* rx;
+	uint16_t length;
+
+	CHECK_EQ(wiznetHostInjectRaw(socket, data, size), 0);
+	wiznetRxBeginLen16(socket, &rx, &length);
+	wiznetRxAbandon(rx);
+	wiznetCloseSocket(socket);
+}
+
+/* This function checks the sizes on the chip, in KB, in both directions
+*/
+static void checkSizes(const uint8_t* rx, const uint8_t* tx) {
+	uint8_t i;
+	for (i = 0; i < WIZNET_MAX_SOCKETS; i++) {
+		CHECK_EQ(wiznetGetSocketRXBufferSize(i), rx[i]);
+		CHECK_EQ(wiznetGetSocketTXBufferSize(i), tx[i]);
+	}
+}
+
+int main(void) {
+	static const uint8_t three[8] = {2, 2, 2, 0, 0, 0, 0, 0};
+	static const uint8_t grown[8] = {2, 2, 4, 0, 0, 0, 0, 0};
+	static const uint8_t halved[8] = {2, 2, 1, 0, 0, 0, 0, 0};
+	static const uint8_t packed[8] = {2, 8, 2, 2, 2, 0, 0, 0};
+	static const uint8_t packedRX[8] = {4, 8, 2, 1, 1, 0, 0, 0};
+	static const uint8_t packedTX[8] = {1, 8, 2, 2, 2, 0, 0, 0};
+	static const uint8_t squeezed[8] = {8, 4, 2, 1, 0, 0, 0, 1};
+	static const uint8_t full[8] = {8, 4, 2, 0, 1, 1, 0, 0};
+	struct wiznetBufferStats stats;
+	uint8_t odd[8] = {2, 2, 3, 2, 2, 2, 2, 0};
+	uint8_t over[8] = {4, 4, 4, 4, 2, 0, 0, 0};
+	uint8_t good[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+
+	// Sizes that are not a power of two or add up to more than 16KB are
+	// refused without touching the chip
+	wiznetHostInit();
+	wiznetReset();
+	CHECK_EQ(wiznetInit(good), WIZNET_SUCCESS);
+	transactions();
+	CHECK_EQ(wiznetInit(odd), WIZNET_ERROR_BUFFER_SIZE);
+	CHECK_EQ(wiznetInitBufferSizes(good, over), WIZNET_ERROR_BUFFER_SIZE);
+	CHECK_EQ(transactions(), 0);
+	checkSizes(good, good);
+
+	// A socket that overran gets twice the RX memory, and one that never
+	// used a quarter of its TX memory gets half, with the model finding
+	// the new sizes where the driver put them
+	allocate(three, 2);
+	overrun(2, 2048);
+	wiznetGetBufferStats(2, &stats);
+	CHECK_EQ(stats.rxOverruns, 1);
+	CHECK_EQ(stats.rxPeak, 2048);
+	CHECK_EQ(stats.txPeak, 0);
+	CHECK_EQ(wiznetOpenSocket(2, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	checkSizes(grown, halved);
+	wiznetGetBufferStats(2, &stats);
+	CHECK_EQ(stats.rxOverruns, 0);
+	CHECK_EQ(stats.rxPeak, 0);
+	CHECK_EQ(wiznetHostInjectRaw(2, data, 4096), 0);
+	CHECK_EQ(wiznetRecvPeek(2), 4096);
+	CHECK_EQ(wiznetHostInjectRaw(1, data, 2048), 0);
+	CHECK_EQ(wiznetHostInjectRaw(1, data, 1), -1);
+
+	// Not while a higher socket is open, as its buffers would move
+	allocate(three, 1);
+	CHECK_EQ(wiznetOpenSocket(2, SOCK_UDP, 5001, 0), WIZNET_SUCCESS);
+	overrun(1, 2048);
+	CHECK_EQ(wiznetOpenSocket(1, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	checkSizes(three, three);
+
+	// Growing a low socket pushes the higher ones up and shrinks those
+	// that no longer fit, each of them keeping 1KB
+	allocate(packed, 0);
+	overrun(0, 2048);
+	CHECK_EQ(wiznetOpenSocket(0, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	checkSizes(packedRX, packedTX);
+
+	// Squeezed between the lower sockets and a higher one, a socket keeps
+	// 1KB rather than growing or losing its buffer
+	allocate(squeezed, 3);
+	overrun(3, 1024);
+	CHECK_EQ(wiznetOpenSocket(3, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	checkSizes(squeezed, squeezed);
+
+	// With no memory left for it at all, the sizes stay as they are
+	allocate(full, 3);
+	wiznetCloseSocket(3);
+	CHECK_EQ(wiznetOpenSocket(3, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	checkSizes(full, full);
+
+	return checkFailures;
+}
@@ -0,0 +1,124 @@
+#include <stdint.h>
+#include <string.h>
+#include "util.h"
+#include "io_assignment.h"
+#include "wiznet_arch.h"
+#include "wiznet.h"
+#include "wiznet_io.h"
+#include "wiznet_regs.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** Register op-lists and forwarding: wiznetRegBurst shares an SPI transaction
+** between accesses that carry on from each other in one direction, the
+** accessors and socket paths built on it cost what they should, and
+** wiznetForward relays a stream between sockets through its small buffer
+*/
+
+#define LENGTH 100
+
+static uint8_t captured[LENGTH];
+static uint16_t capturedLength;
+
+static void capture(uint8_t socket, const uint8_t* buf, uint16_t len) {
+	(void)socket;
+	if (capturedLength + len <= LENGTH)
+		memcpy(captured + capturedLength, buf, len);
+	capturedLength += len;
+}
+
+/* This function returns the SPI transactions since it was last called
+*/
+static uint32_t transactions(void) {
+	struct wiznetHostStats stats;
+
+	wiznetHostGetStats(&stats);
+	wiznetHostResetStats();
+	return stats.transactions;
+}
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t ip[4] = {10, 0, 0, 2}, readIP[4], port[2], tos[2], ttl, ir, data[LENGTH];
+	struct wiznetRegOp ops[2];
+	struct wiznetTransaction *rx, *tx;
+	uint16_t rsr, i;
+
+	for (i = 0; i < LENGTH; i++)
+		data[i] = (uint8_t)(i * 3);
+	wiznetHostInit();
+	wiznetHostSetSendHook(capture);
+	wiznetReset();
+	wiznetInit(sizes);
+
+	// Opening a UDP socket, beginning a datagram and connecting over TCP
+	transactions();
+	CHECK_EQ(wiznetOpenSocket(1, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	CHECK_EQ(transactions(), 6);
+	CHECK_EQ(wiznetSendToBegin(1, ip, 6000), WIZNET_SUCCESS);
+	CHECK_EQ(transactions(), 2);
+	CHECK_EQ(wiznetSendToAbandon(), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetOpenSocket(2, SOCK_TCP, 5001, 0), WIZNET_SUCCESS);
+	transactions();
+	CHECK_EQ(wiznetConnectSocket(2, ip, 80), WIZNET_SUCCESS);
+	CHECK_EQ(transactions(), 5);
+
+	// Sn_DIPR and Sn_DPORT follow on from each other: one transaction
+	ops[0] = (struct wiznetRegOp){REG_Sn_DIPR, 4, 0, readIP};
+	ops[1] = (struct wiznetRegOp){REG_Sn_DPORT, 2, 0, port};
+	wiznetRegBurst(1, ops, 2);
+	CHECK_EQ(transactions(), 1);
+	CHECK(memcmp(readIP, ip, 4) == 0);
+	CHECK_EQ((port[0] << 8) | port[1], 6000);
+
+	// A gap between the accesses starts a new transaction
+	ops[0] = (struct wiznetRegOp){REG_Sn_DPORT, 2, 0, port};
+	ops[1] = (struct wiznetRegOp){REG_Sn_TOS, 2, 0, tos};
+	wiznetRegBurst(1, ops, 2);
+	CHECK_EQ(transactions(), 2);
+
+	// So does a change of direction, and the read sees the write
+	ttl = 0x40;
+	ops[0] = (struct wiznetRegOp){REG_Sn_TTL, 1, 1, &ttl};
+	ops[1] = (struct wiznetRegOp){REG_Sn_TTL, 1, 0, &tos[0]};
+	wiznetRegBurst(1, ops, 2);
+	CHECK_EQ(transactions(), 2);
+	CHECK_EQ(tos[0], 0x40);
+
+	// An empty list touches nothing
+	wiznetRegBurst(1, ops, 0);
+	CHECK_EQ(transactions(), 0);
+
+	// The combined accessors are one transaction each
+	wiznetSetSocketDest(1, ip, 6001);
+	CHECK_EQ(transactions(), 1);
+	CHECK_EQ(wiznetGetSocketDestPort(1), 6001);
+	transactions();
+	CHECK_EQ(wiznetGetSocketInterruptAndStatus(2, &ir), Sn_SR_ESTABLISHED);
+	CHECK_EQ(transactions(), 1);
+	rsr = 1;
+	CHECK_EQ(wiznetGetSocketRXState(1, &rsr), 0);
+	CHECK_EQ(transactions(), 1);
+	CHECK_EQ(rsr, 0);
+
+	// Forwarding from socket 2 to socket 1 costs a read and a write per chunk
+	CHECK_EQ(wiznetHostInjectRaw(2, data, LENGTH), 0);
+	CHECK_EQ(wiznetRxBegin(2, &rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetTxBeginTo(1, ip, 6000, &tx), WIZNET_SUCCESS);
+	transactions();
+	CHECK_EQ(wiznetForward(rx, tx, LENGTH), WIZNET_SUCCESS);
+	CHECK_EQ(transactions(), 2 * ((LENGTH + WIZNET_FORWARD_CHUNK - 1) / WIZNET_FORWARD_CHUNK));
+	CHECK_EQ(wiznetRxCommit(rx, LENGTH), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetTxCommit(tx), WIZNET_SUCCESS);
+	CHECK_EQ(capturedLength, LENGTH);
+	CHECK(memcmp(captured, data, LENGTH) == 0);
+
+	// Either transaction not in progress
+	CHECK_EQ(wiznetForward(rx, tx, LENGTH), WIZNET_ERROR_NOT_RECVING);
+	CHECK_EQ(wiznetRxBegin(2, &rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetForward(rx, tx, LENGTH), WIZNET_ERROR_NOT_SENDING);
+	wiznetRxAbandon(rx);
+
+	return checkFailures;
+}
@@ -0,0 +1,184 @@
+#include <stdint.h>
+#include <stdio.h>
+#include "util.h"
+#include "io_assignment.h"
+#include "wiznet_arch.h"
+#include "wiznet.h"
+#include "wiznet_io.h"
+#include "wiznet_regs.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** Control phase bytes: wiznetCommonControl, wiznetSocketControl and
+** wiznetRegControl fold to constants, match the BSB/RWB/OM encoding in the
+** datasheet, and the control bytes a WIZNET_TRACE build records on the bus
+** are the same whichever path opened the transaction.
+*/
+
+#define DEPTH 256
+
+// Static initialisers must be constant expressions, so this table does not
+// compile unless every entry folds
+static const uint8_t folded[] = {
+	wiznetCommonControl(0),
+	wiznetCommonControl(1),
+	wiznetRegControl(-1, 0),
+	wiznetRegControl(-1, 1),
+	wiznetRegControl(0, 0),
+	wiznetRegControl(1, 1),
+	wiznetSocketControl(2, WIZNET_BLOCK_TX, 1),
+	wiznetSocketControl(3, WIZNET_BLOCK_RX, 0),
+	wiznetSocketControl(7, WIZNET_BLOCK_REGS, 1),
+	wiznetSocketControl(7, WIZNET_BLOCK_RX, 1)
+};
+
+// Datasheet: BSB is 0 for the common registers, then 4n+1, 4n+2 and 4n+3
+// for socket n's registers, TX and RX buffers; RWB is 1 to write; OM is 0
+static const uint8_t datasheet[] = {
+	0x00, 0x04, 0x00, 0x04, 0x08, 0x2C, 0x54, 0x78, 0xEC, 0xFC
+};
+
+static struct wiznetTraceRecord records[DEPTH];
+static FILE* file;
+
+static void writeFile(void* ctx, const uint8_t* data, uint16_t length) {
+	fwrite(data, 1, length, (FILE*)ctx);
+}
+
+/* This function loads the trace taken since the last call and starts a new
+** one
+**
+** returns - number of records loaded
+*/
+static int takeTrace(void) {
+	struct wiznetTraceHeader header;
+	int count;
+
+	rewind(file);
+	wiznetTraceExport(writeFile, file);
+	fflush(file);
+	rewind(file);
+	count = wiznetHostTraceLoad(file, &header, records, DEPTH);
+	wiznetTraceReset();
+	return count;
+}
+
+/* This function checks that a control byte is one the chip accepts: the
+** common block or one of a socket's three blocks, variable-length mode, and
+** never a write to an RX buffer or a read from a TX buffer
+*/
+static int validControl(uint8_t control) {
+	uint8_t block = (control >> 3) & 0x03;
+	uint8_t write = (control & WIZNET_CONTROL_WRITE) != 0;
+
+	if ((control & 0x03) != 0)
+		return 0;
+	if ((control >> 3) == 0)
+		return 1;
+	if (block == 0)
+		return 0;
+	if (block == WIZNET_BLOCK_TX)
+		return write;
+	if (block == WIZNET_BLOCK_RX)
+		return !write;
+	return 1;
+}
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t ip[4] = {10, 0, 0, 2};
+	uint8_t payload[100] = {0}, from[4], value;
+	struct wiznetHostStats stats;
+	uint16_t port;
+	int socket, block, write, count, i;
+
+	for (i = 0; i < (int)sizeof(folded); i++)
+		CHECK_EQ(folded[i], datasheet[i]);
+
+	// With the socket only known at run time
+	for (socket = 0; socket < WIZNET_MAX_SOCKETS; socket++)
+		for (block = WIZNET_BLOCK_REGS; block <= WIZNET_BLOCK_RX; block++)
+			for (write = 0; write <= 1; write++)
+				CHECK_EQ(wiznetSocketControl(socket, block, write), ((4 * socket + block) << 3) | (write << 2));
+	for (socket = -1; socket < WIZNET_MAX_SOCKETS; socket++)
+		for (write = 0; write <= 1; write++)
+			CHECK_EQ(wiznetRegControl(socket, write),
+					socket < 0 ? write << 2 : wiznetSocketControl(socket, WIZNET_BLOCK_REGS, write));
+
+	file = tmpfile();
+	CHECK(file != NULL);
+	if (file == NULL)
+		return checkFailures;
+	wiznetHostInit();
+	wiznetReset();
+	CHECK_EQ(wiznetInit(sizes), WIZNET_SUCCESS);
+	wiznetTraceReset();
+
+	// The character-coded wiznetIOBegin, the register helpers and
+	// wiznetIOBeginControl put the same bytes on the bus
+	CHECK_EQ(wiznetIOBegin(-1, REG_VERSIONR, 'r', 'x'), 0);
+	value = wiznetHostTransceiveByte(0);
+	wiznetIOFinish();
+	CHECK_EQ(wiznetRegReadByte(-1, REG_VERSIONR), value);
+	for (socket = 0; socket < WIZNET_MAX_SOCKETS; socket++) {
+		CHECK_EQ(wiznetIOBegin(socket, REG_Sn_TTL, 'w', 'x'), 0);
+		wiznetHostTransceiveByte((uint8_t)(0x40 + socket));
+		wiznetIOFinish();
+		CHECK_EQ(wiznetRegReadByte(socket, REG_Sn_TTL), 0x40 + socket);
+		CHECK_EQ(wiznetIOBegin(socket, 0, 'r', 'r'), 0);
+		wiznetIOFinish();
+		wiznetIOBeginControl(0, wiznetSocketControl(socket, WIZNET_BLOCK_RX, 0));
+		wiznetIOFinish();
+		CHECK_EQ(wiznetIOBegin(socket, 0, 'w', 't'), 0);
+		wiznetIOFinish();
+		wiznetIOBeginControl(0, wiznetSocketControl(socket, WIZNET_BLOCK_TX, 1));
+		wiznetIOFinish();
+	}
+	CHECK_EQ(takeTrace(), 2 + 6 * WIZNET_MAX_SOCKETS);
+	CHECK_EQ(records[0].control, 0x00);
+	CHECK_EQ(records[1].control, 0x00);
+	CHECK_EQ(records[0].address, REG_VERSIONR);
+	for (socket = 0; socket < WIZNET_MAX_SOCKETS; socket++) {
+		struct wiznetTraceRecord* r = &records[2 + 6 * socket];
+		CHECK_EQ(r[0].control, ((4 * socket + 1) << 3) | 0x04);
+		CHECK_EQ(r[1].control, (4 * socket + 1) << 3);
+		CHECK_EQ(r[0].address, REG_Sn_TTL);
+		CHECK_EQ(r[1].address, REG_Sn_TTL);
+		CHECK_EQ(r[2].control, (4 * socket + 3) << 3);
+		CHECK_EQ(r[3].control, r[2].control);
+		CHECK_EQ(r[4].control, ((4 * socket + 2) << 3) | 0x04);
+		CHECK_EQ(r[5].control, r[4].control);
+	}
+
+	// An unknown block is refused without selecting the chip
+	wiznetHostResetStats();
+	CHECK_EQ(wiznetIOBegin(1, 0, 'r', 'q'), -1);
+	wiznetHostGetStats(&stats);
+	CHECK_EQ(stats.transactions, 0);
+	CHECK_EQ(takeTrace(), 0);
+
+	// A datagram out and back: every control byte is well formed, and one is
+	// recorded per transaction the model saw
+	wiznetHostResetStats();
+	CHECK_EQ(wiznetOpenSocket(1, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetSendToBegin(1, ip, 6000), WIZNET_SUCCESS);
+	wiznetSendData(payload, sizeof(payload));
+	CHECK_EQ(wiznetSendToCommit(), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetHostInjectUDP(1, ip, 7000, payload, sizeof(payload)), 0);
+	CHECK_EQ(wiznetRecvBegin(1), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvHeaderUDP(from, &port), sizeof(payload));
+	wiznetRecvData(payload, sizeof(payload));
+	CHECK_EQ(wiznetRecvCommit(sizeof(payload)), WIZNET_SUCCESS);
+	wiznetHostGetStats(&stats);
+	count = takeTrace();
+	CHECK_EQ((uint32_t)count, stats.transactions);
+	for (i = 0; i < count; i++) {
+		CHECK(validControl(records[i].control));
+		if ((records[i].control >> 3) != 0)
+			CHECK_EQ(records[i].control >> 5, 1);
+	}
+
+	fclose(file);
+	return checkFailures;
+}
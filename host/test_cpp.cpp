@@ -0,0 +1,190 @@
+#include <array>
+#include <cstring>
+#include <vector>
+#include "wiznet.hpp"
+#include "check.h"
+
+/*
+** C++ interface: built as C++17 and C++20. Each wrapped call must move the
+** same data with the same SPI traffic as the C calls it stands for, and the
+** transaction objects must give their handle back however they end.
+*/
+
+using Udp = wiznet::Socket<1>;
+using Tcp = wiznet::Socket<2>;
+
+static uint8_t ip[4] = {10, 0, 0, 2};
+static uint8_t payload[512];
+static uint8_t sent[2][1024];
+static uint16_t sentLength[2];
+static uint8_t sends;
+
+static void capture(uint8_t, const uint8_t* data, uint16_t len) {
+	if (sends < 2) {
+		std::memcpy(sent[sends], data, len);
+		sentLength[sends] = len;
+	}
+	sends++;
+}
+
+/* This function runs the C and the C++ form of the same operation and
+** checks that they cost the same on the bus and, for sends, put the same
+** bytes on the wire
+*/
+template <typename C, typename Cpp>
+static void same(const char* label, C c, Cpp cpp) {
+	wiznetHostStats a, b;
+
+	sends = 0;
+	wiznetHostResetStats();
+	c();
+	wiznetHostGetStats(&a);
+	wiznetHostResetStats();
+	cpp();
+	wiznetHostGetStats(&b);
+	if (a.transactions != b.transactions || a.bytes != b.bytes)
+		std::fprintf(stderr, "%s: C %u transactions %u bytes, C++ %u transactions %u bytes\n", label,
+				(unsigned)a.transactions, (unsigned)a.bytes, (unsigned)b.transactions, (unsigned)b.bytes);
+	CHECK_EQ(a.transactions, b.transactions);
+	CHECK_EQ(a.bytes, b.bytes);
+	if (sends == 2) {
+		CHECK_EQ(sentLength[0], sentLength[1]);
+		CHECK(std::memcmp(sent[0], sent[1], sentLength[0]) == 0);
+	}
+}
+
+int main() {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t from[4], back[2][512];
+	uint16_t port, length[2];
+	std::array<uint8_t, 64> header{};
+	std::vector<uint8_t> body(300, 1);
+
+	for (unsigned i = 0; i < sizeof(payload); i++)
+		payload[i] = static_cast<uint8_t>(i * 7);
+	wiznetHostInit();
+	wiznetHostSetSendHook(capture);
+	wiznetReset();
+	wiznetInit(sizes);
+	CHECK_EQ(Udp::open(SOCK_UDP, 5000), WIZNET_SUCCESS);
+	CHECK_EQ(Tcp::open(SOCK_TCP, 80), WIZNET_SUCCESS);
+	CHECK_EQ(Tcp::connect(ip, 80), WIZNET_SUCCESS);
+
+	same("sendTo", [] {
+		wiznetTransaction* tx;
+		wiznetTxBeginTo(1, ip, 6000, &tx);
+		wiznetTxData(tx, payload, 100);
+		wiznetTxData(tx, payload + 100, 100);
+		wiznetTxCommit(tx);
+	}, [] {
+		auto tx = Udp::sendTo(ip, 6000);
+		tx.write({payload, 100});
+		tx.write(wiznet::Span<const uint8_t>(payload + 100, 100));
+		CHECK_EQ(tx.commit(), WIZNET_SUCCESS);
+		CHECK(!tx);
+	});
+
+	same("send containers", [&] {
+		wiznetTransaction* tx;
+		wiznetTxBegin(2, &tx);
+		wiznetTxData(tx, header.data(), header.size());
+		wiznetTxData(tx, body.data(), body.size());
+		wiznetTxCommit(tx);
+	}, [&] {
+		auto tx = Tcp::send();
+		tx.write(header);
+		tx.write(body);
+		tx.commit();
+	});
+
+	same("gathered send", [] {
+		wiznetIOVec iov[2] = {{payload, 10}, {payload + 50, 20}};
+		wiznetTransaction* tx;
+		wiznetTxBegin(2, &tx);
+		wiznetTxDataV(tx, iov, 2);
+		wiznetTxCommit(tx);
+	}, [] {
+		wiznetIOVec iov[2] = {{payload, 10}, {payload + 50, 20}};
+		auto tx = Tcp::send();
+		tx.writev(iov);
+		tx.commit();
+	});
+
+	wiznetHostInjectUDP(1, ip, 7000, payload, 150);
+	wiznetHostInjectUDP(1, ip, 7000, payload + 150, 150);
+	same("recv", [&] {
+		wiznetTransaction* rx;
+		wiznetRxBegin(1, &rx);
+		length[0] = wiznetRxHeaderUDP(rx, from, &port);
+		wiznetRxData(rx, back[0], length[0]);
+		wiznetRxCommit(rx, length[0]);
+	}, [&] {
+		auto rx = Udp::recv();
+		length[1] = rx.headerUDP(from, &port);
+		rx.read({back[1], length[1]});
+		CHECK_EQ(rx.commit(length[1]), WIZNET_SUCCESS);
+	});
+	CHECK_EQ(length[0], 150);
+	CHECK_EQ(length[1], 150);
+	CHECK(std::memcmp(back[0], payload, 150) == 0);
+	CHECK(std::memcmp(back[1], payload + 150, 150) == 0);
+
+	same("registers", [] {
+		wiznetGetSocketStatus(1);
+		wiznetGetSocketInterrupt(2);
+		wiznetGetSocketTXFreeSize(2);
+	}, [] {
+		Udp::status();
+		Tcp::interrupts();
+		Tcp::freeSize();
+	});
+
+	Tcp::setFraming(WIZNET_FRAMING_SLIP);
+	same("SLIP frame", [] {
+		wiznetTransaction* tx;
+		wiznetTxBeginFrame(2, &tx);
+		wiznetTxFrameData(tx, payload, 200);
+		wiznetTxCommitFrame(tx);
+	}, [] {
+		auto tx = Tcp::sendFrame();
+		tx.write({payload, 200});
+		tx.commit();
+	});
+	Tcp::setFraming(WIZNET_FRAMING_NONE);
+
+	// A transaction left open is abandoned when it goes out of scope
+	{
+		auto tx = Tcp::send();
+		tx.write({payload, 10});
+	}
+	{
+		auto tx = Tcp::send();
+		CHECK(static_cast<bool>(tx));
+		CHECK_EQ(tx.error(), WIZNET_SUCCESS);
+
+		// The handle is busy while it is open
+		auto second = Tcp::send();
+		CHECK(!second);
+		CHECK_EQ(second.error(), WIZNET_ERROR_SEND_COLLISION);
+
+		// and moves with the object
+		auto moved = std::move(tx);
+		CHECK(!tx);
+		CHECK(static_cast<bool>(moved));
+		wiznet::SendTx assigned;
+		assigned = std::move(moved);
+		CHECK(!moved);
+		CHECK(static_cast<bool>(assigned));
+	}
+	CHECK(static_cast<bool>(Tcp::send()));
+	CHECK_EQ(Tcp::send().commit(), WIZNET_SUCCESS);
+
+	{
+		auto rx = Udp::recv();
+		CHECK(static_cast<bool>(rx));
+	}
+	CHECK(static_cast<bool>(Udp::recv()));
+	CHECK_EQ(Udp::peek(), 0);
+
+	return checkFailures;
+}
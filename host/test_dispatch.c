@@ -0,0 +1,157 @@
+#include <stdint.h>
+#include <string.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "wiznet_regs_defs.h"
+#include "check.h"
+
+/*
+** wiznetDispatchEvents: the order handlers are called in, and the SPI
+** transactions it costs per serviced socket
+*/
+
+struct event {
+	uint8_t socket;
+	uint8_t event;
+};
+
+static struct event events[16];
+static uint8_t eventCount;
+static int8_t sendSocket;
+static int sendResult;
+
+static void record(uint8_t socket, uint8_t event) {
+	if (eventCount < sizeof(events) / sizeof(events[0])) {
+		events[eventCount].socket = socket;
+		events[eventCount].event = event;
+	}
+	eventCount++;
+}
+
+/* This handler raises RECEIVE again on its own socket, as more data arriving
+** while it runs would
+*/
+static void recordAndInject(uint8_t socket, uint8_t event) {
+	static const uint8_t ip[4] = {10, 0, 0, 9};
+	static uint8_t injected;
+	record(socket, event);
+	if (!injected)
+		wiznetHostInjectUDP(socket, ip, 9, (const uint8_t*)"again", 5);
+	injected = 1;
+}
+
+static void sendDone(uint8_t socket, int result) {
+	sendSocket = socket;
+	sendResult = result;
+	// The send completion is reported before the socket's event handlers
+	CHECK_EQ(eventCount, 0);
+}
+
+/* This function runs the dispatcher and returns the SPI transactions it
+** issued
+*/
+static uint32_t dispatch(uint8_t* serviced) {
+	struct wiznetHostStats stats;
+
+	eventCount = 0;
+	wiznetHostResetStats();
+	*serviced = wiznetDispatchEvents();
+	wiznetHostGetStats(&stats);
+	return stats.transactions;
+}
+
+/* This function drops everything received on a socket
+*/
+static void flushReceive(uint8_t socket) {
+	struct wiznetTransaction* rx;
+	wiznetRxBegin(socket, &rx);
+	wiznetRxData(rx, NULL, wiznetRecvPeek(socket));
+	wiznetRxCommit(rx, 0);
+}
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t ip[4] = {10, 0, 0, 1};
+	uint8_t serviced;
+	struct wiznetTransaction* tx;
+	uint8_t i;
+
+	wiznetHostInit();
+	wiznetReset();
+	wiznetInit(sizes);
+	wiznetOpenSocket(1, SOCK_UDP, 5000, 0);
+	wiznetOpenSocket(2, SOCK_TCP, 80, 0);
+	wiznetListenOnSocket(2);
+	wiznetOpenSocket(5, SOCK_UDP, 5001, 0);
+	for (i = 0; i < 8; i++)
+		wiznetSetEventHandler(i, Sn_IR_CONNECT | Sn_IR_DISCONNECT | Sn_IR_RECEIVE
+				| Sn_IR_TIMEOUT | Sn_IR_SEND_OK, record);
+	wiznetSetSendCompleteHandler(sendDone);
+
+	// Nothing pending: SIR alone is read
+	CHECK_EQ(dispatch(&serviced), 1);
+	CHECK_EQ(serviced, 0);
+	CHECK_EQ(eventCount, 0);
+
+	// One socket: SIR, then Sn_IR read and acknowledged
+	wiznetHostInjectUDP(1, ip, 9, (const uint8_t*)"one", 3);
+	CHECK_EQ(dispatch(&serviced), 3);
+	CHECK_EQ(serviced, 0x02);
+	CHECK_EQ(eventCount, 1);
+	CHECK(events[0].socket == 1 && events[0].event == Sn_IR_RECEIVE);
+	CHECK_EQ(dispatch(&serviced), 1);
+	flushReceive(1);
+
+	// Sockets in ascending order, events in Sn_IR bit order within a socket
+	wiznetHostInjectUDP(5, ip, 9, (const uint8_t*)"five", 4);
+	wiznetHostAcceptConnection(2, ip, 1234);
+	wiznetHostInjectRaw(2, (const uint8_t*)"two", 3);
+	wiznetHostInjectUDP(1, ip, 9, (const uint8_t*)"one", 3);
+	CHECK_EQ(dispatch(&serviced), 1 + 2 * 3);
+	CHECK_EQ(serviced, 0x26);
+	CHECK_EQ(eventCount, 4);
+	CHECK(events[0].socket == 1 && events[0].event == Sn_IR_RECEIVE);
+	CHECK(events[1].socket == 2 && events[1].event == Sn_IR_CONNECT);
+	CHECK(events[2].socket == 2 && events[2].event == Sn_IR_RECEIVE);
+	CHECK(events[3].socket == 5 && events[3].event == Sn_IR_RECEIVE);
+	flushReceive(1);
+	flushReceive(2);
+	flushReceive(5);
+
+	// A flag raised again while a handler runs is left for the next call
+	wiznetSetEventHandler(1, Sn_IR_RECEIVE, recordAndInject);
+	wiznetHostInjectUDP(1, ip, 9, (const uint8_t*)"one", 3);
+	dispatch(&serviced);
+	CHECK_EQ(eventCount, 1);
+	CHECK_EQ(dispatch(&serviced), 3);
+	CHECK_EQ(eventCount, 1);
+	CHECK(events[0].socket == 1 && events[0].event == Sn_IR_RECEIVE);
+	wiznetSetEventHandler(1, Sn_IR_RECEIVE, record);
+	flushReceive(1);
+
+	// An asynchronous send is completed by the dispatcher
+	sendSocket = -1;
+	wiznetTxBeginTo(5, ip, 9, &tx);
+	wiznetTxData(tx, (const uint8_t*)"z", 1);
+	wiznetTxCommitAsync(tx);
+	CHECK_EQ(dispatch(&serviced), 3);
+	CHECK_EQ(serviced, 0x20);
+	CHECK_EQ(sendSocket, 5);
+	CHECK_EQ(sendResult, WIZNET_SUCCESS);
+	CHECK_EQ(eventCount, 1);
+	CHECK(events[0].socket == 5 && events[0].event == Sn_IR_SEND_OK);
+	CHECK_EQ(wiznetSendPoll(5), WIZNET_SUCCESS);
+
+	// A timed-out send is reported as failed
+	sendSocket = -1;
+	wiznetHostFailNextSend(5);
+	wiznetTxBeginTo(5, ip, 9, &tx);
+	wiznetTxData(tx, (const uint8_t*)"z", 1);
+	wiznetTxCommitAsync(tx);
+	dispatch(&serviced);
+	CHECK_EQ(sendSocket, 5);
+	CHECK_EQ(sendResult, WIZNET_ERROR_SEND_DATA);
+	CHECK(events[0].socket == 5 && events[0].event == Sn_IR_TIMEOUT);
+
+	return checkFailures;
+}
@@ -0,0 +1,214 @@
+#include <stdint.h>
+#include <string.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** COBS and length-prefixed framing against reference encoders, with zero
+** bytes placed around the 254-byte group boundary, empty frames, frames
+** that arrive in two pieces and several frames taken in one transaction
+*/
+
+#define SOCKET 1
+#define MAX_DATA 700
+
+static uint8_t sent[MAX_DATA + MAX_DATA / 254 + 4];
+static uint16_t sentLength;
+
+static void capture(uint8_t socket, const uint8_t* data, uint16_t len) {
+	(void)socket;
+	memcpy(sent, data, len);
+	sentLength = len;
+}
+
+/* This function COBS-encodes a frame one byte at a time, with the zero
+** delimiter after it
+*/
+static uint16_t reference(const uint8_t* buf, uint16_t length, uint8_t* out) {
+	uint16_t n = 1, code = 0, i;
+
+	for (i = 0; i < length; i++) {
+		if (buf[i] == 0x00) {
+			out[code] = n - code;
+			code = n++;
+			continue;
+		}
+		out[n++] = buf[i];
+		if (n - code == 0xFF) {
+			out[code] = 0xFF;
+			code = n++;
+		}
+	}
+	out[code] = n - code;
+	out[n++] = 0x00;
+	return n;
+}
+
+/* This function sends buf as one COBS frame, written in two calls split at
+** cut, checks what went out against the reference, then receives it back
+*/
+static void roundTrip(const uint8_t* buf, uint16_t length, uint16_t cut) {
+	static uint8_t expect[sizeof(sent)];
+	static uint8_t back[MAX_DATA + 1];
+	struct wiznetTransaction *tx, *rx;
+	uint16_t n, received = 0xFFFF;
+	int failures = checkFailures;
+
+	n = reference(buf, length, expect);
+	wiznetTxBeginCOBS(SOCKET, &tx);
+	wiznetTxCOBSData(tx, buf, cut);
+	wiznetTxCOBSData(tx, buf + cut, length - cut);
+	CHECK_EQ(wiznetTxCommitCOBS(tx), WIZNET_SUCCESS);
+	CHECK_EQ(sentLength, n);
+	CHECK(memcmp(sent, expect, n) == 0);
+
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, expect, n), 0);
+	CHECK_EQ(wiznetRxBegin(SOCKET, &rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxCOBSFrame(rx, back, sizeof(back), &received), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxCommitCOBS(rx), WIZNET_SUCCESS);
+	CHECK_EQ(received, length);
+	CHECK(memcmp(back, buf, length) == 0);
+	CHECK_EQ(wiznetRecvPeek(SOCKET), 0);
+
+	if (checkFailures != failures)
+		fprintf(stderr, "  in a frame of %u bytes cut at %u\n", length, cut);
+}
+
+int main(void) {
+	static uint8_t data[MAX_DATA], encoded[sizeof(sent)], back[MAX_DATA];
+	static const uint16_t lengths[] = {0, 1, 253, 254, 255, 256, 508, 509, 510, MAX_DATA};
+	uint8_t sizes[8] = {2, 4, 2, 2, 2, 2, 2, 0};
+	uint8_t ip[4] = {10, 0, 0, 2}, prefix[2];
+	struct wiznetTransaction *tx, *rx;
+	uint16_t length, at, n, i, l;
+
+	wiznetHostInit();
+	wiznetHostSetSendHook(capture);
+	wiznetReset();
+	wiznetInit(sizes);
+	wiznetOpenSocket(SOCKET, SOCK_TCP, 5000, 0);
+	CHECK_EQ(wiznetConnectSocket(SOCKET, ip, 80), WIZNET_SUCCESS);
+
+	// No zeros, and one zero at every position around the group boundaries,
+	// written in one call and split just before it
+	for (l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+		length = lengths[l];
+		for (i = 0; i < length; i++)
+			data[i] = (uint8_t)(i % 255 + 1);
+		roundTrip(data, length, 0);
+		for (at = 0; at < length; at++) {
+			if (at > 3 && at + 3 < length && (at + 3) % 254 > 6)
+				continue;
+			data[at] = 0x00;
+			roundTrip(data, length, 0);
+			roundTrip(data, length, at);
+			data[at] = (uint8_t)(at % 255 + 1);
+		}
+	}
+
+	// Zeros only, and zeros either side of a full group
+	memset(data, 0x00, 300);
+	roundTrip(data, 300, 150);
+	memset(data + 1, 0x41, 254);
+	roundTrip(data, 256, 0);
+	roundTrip(data, 256, 255);
+
+	// A frame that arrives in two pieces: the receiver gives up on the
+	// first and takes the whole frame once the rest is in
+	for (i = 0; i < 300; i++)
+		data[i] = (uint8_t)(i % 7);
+	n = reference(data, 300, encoded);
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, encoded, 100), 0);
+	CHECK_EQ(wiznetRxBegin(SOCKET, &rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxCOBSFrame(rx, back, sizeof(back), &length), WIZNET_ERROR_FRAME_INCOMPLETE);
+	wiznetRxAbandon(rx);
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, encoded + 100, n - 100), 0);
+	CHECK_EQ(wiznetRxBegin(SOCKET, &rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxCOBSFrame(rx, back, sizeof(back), &length), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxCommitCOBS(rx), WIZNET_SUCCESS);
+	CHECK_EQ(length, 300);
+	CHECK(memcmp(back, data, 300) == 0);
+
+	// A frame skipped unread: commit scans for the delimiter, reports it
+	// missing and finds it once it has arrived, leaving the next frame
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, encoded, 200), 0);
+	CHECK_EQ(wiznetRxBegin(SOCKET, &rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxCommitCOBS(rx), WIZNET_ERROR_FRAME_INCOMPLETE);
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, encoded + 200, n - 200), 0);
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, encoded, n), 0);
+	CHECK_EQ(wiznetRxCommitCOBS(rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvPeek(SOCKET), n);
+	CHECK_EQ(wiznetRxBegin(SOCKET, &rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxCOBSFrame(rx, NULL, 0, &length), WIZNET_ERROR_FRAME_TOO_LONG);
+	CHECK_EQ(length, 300);
+	CHECK_EQ(wiznetRxCommitCOBS(rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvPeek(SOCKET), 0);
+
+	// Several frames, an empty one among them, in one transaction
+	for (i = 0; i < 3; i++) {
+		wiznetTxBeginCOBS(SOCKET, &tx);
+		wiznetTxCOBSData(tx, data, i * 10);
+		wiznetTxCommitCOBS(tx);
+		CHECK_EQ(wiznetHostInjectRaw(SOCKET, sent, sentLength), 0);
+	}
+	CHECK_EQ(wiznetRxBegin(SOCKET, &rx), WIZNET_SUCCESS);
+	for (i = 0; i < 3; i++) {
+		CHECK_EQ(wiznetRxCOBSFrame(rx, back, sizeof(back), &length), WIZNET_SUCCESS);
+		CHECK_EQ(length, i * 10);
+		CHECK(memcmp(back, data, length) == 0);
+	}
+	CHECK_EQ(wiznetRxCOBSFrame(rx, back, sizeof(back), &length), WIZNET_ERROR_FRAME_INCOMPLETE);
+	CHECK_EQ(wiznetRxCommitCOBS(rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvPeek(SOCKET), 0);
+
+	// Length-prefixed: the prefix goes out in front of the data, an empty
+	// frame included
+	for (length = 0; length <= 600; length += 300) {
+		wiznetTxBeginLen16(SOCKET, &tx);
+		wiznetTxData(tx, data, length);
+		CHECK_EQ(wiznetTxCommitLen16(tx), WIZNET_SUCCESS);
+		CHECK_EQ(sentLength, length + 2);
+		CHECK_EQ((sent[0] << 8) | sent[1], length);
+		CHECK(memcmp(sent + 2, data, length) == 0);
+		CHECK_EQ(wiznetHostInjectRaw(SOCKET, sent, sentLength), 0);
+		CHECK_EQ(wiznetRxBeginLen16(SOCKET, &rx, &n), WIZNET_SUCCESS);
+		CHECK_EQ(n, length);
+		wiznetRxData(rx, back, n);
+		CHECK_EQ(wiznetRxCommitLen16(rx), WIZNET_SUCCESS);
+		CHECK(memcmp(back, data, n) == 0);
+		CHECK_EQ(wiznetRecvPeek(SOCKET), 0);
+	}
+
+	// A prefix that arrives a byte at a time, then without its body
+	prefix[0] = 0x01;
+	prefix[1] = 0x2C;
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, prefix, 1), 0);
+	CHECK_EQ(wiznetRxBeginLen16(SOCKET, &rx, &n), WIZNET_ERROR_FRAME_INCOMPLETE);
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, prefix + 1, 1), 0);
+	CHECK_EQ(wiznetRxBeginLen16(SOCKET, &rx, &n), WIZNET_ERROR_FRAME_INCOMPLETE);
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, data, 299), 0);
+	CHECK_EQ(wiznetRxBeginLen16(SOCKET, &rx, &n), WIZNET_ERROR_FRAME_INCOMPLETE);
+	CHECK_EQ(wiznetRecvPeek(SOCKET), 301);
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, data + 299, 1), 0);
+	CHECK_EQ(wiznetRxBeginLen16(SOCKET, &rx, &n), WIZNET_SUCCESS);
+	CHECK_EQ(n, 300);
+	CHECK_EQ(wiznetRxCommitLen16(rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvPeek(SOCKET), 0);
+
+	// Two frames in one transaction, the second still missing its body
+	wiznetTxBeginLen16(SOCKET, &tx);
+	wiznetTxData(tx, data, 40);
+	wiznetTxCommitLen16(tx);
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, sent, sentLength), 0);
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, sent, 10), 0);
+	CHECK_EQ(wiznetRxBegin(SOCKET, &rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxLen16Frame(rx, back, 20, &n), WIZNET_ERROR_FRAME_TOO_LONG);
+	CHECK_EQ(n, 40);
+	CHECK(memcmp(back, data, 20) == 0);
+	CHECK_EQ(wiznetRxLen16Frame(rx, back, sizeof(back), &n), WIZNET_ERROR_FRAME_INCOMPLETE);
+	CHECK_EQ(wiznetRxCommitLen16(rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvPeek(SOCKET), 10);
+
+	return checkFailures;
+}
@@ -0,0 +1,103 @@
+#include <stdint.h>
+#include <string.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** Scatter-gather sends: fragments go out as one datagram written in one SPI
+** transaction, plain or SLIP-escaped, at the cost of a single-buffer send
+*/
+
+static uint8_t sent[512];
+static uint16_t sentLength;
+
+static void capture(uint8_t socket, const uint8_t* data, uint16_t len) {
+	(void)socket;
+	memcpy(sent, data, len);
+	sentLength = len;
+}
+
+/* This function returns the SPI transactions since it was last called
+*/
+static uint32_t transactions(void) {
+	struct wiznetHostStats stats;
+
+	wiznetHostGetStats(&stats);
+	wiznetHostResetStats();
+	return stats.transactions;
+}
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t ip[4] = {10, 0, 0, 2};
+	uint8_t header[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+	uint8_t body[200], whole[256], slip[520];
+	struct wiznetIOVec iov[3];
+	uint32_t single;
+	uint16_t i, n, escapes = 0;
+
+	for (i = 0; i < sizeof(body); i++)
+		body[i] = (uint8_t)(i * 5);
+	// Escapes at the ends of fragments
+	body[0] = 0xC0;
+	body[sizeof(body) - 1] = 0xDB;
+	header[7] = 0xC0;
+	memcpy(whole, header, sizeof(header));
+	memcpy(whole + sizeof(header), body, sizeof(body));
+	memcpy(whole + sizeof(header) + sizeof(body), "tail", 4);
+	iov[0].base = header;
+	iov[0].length = sizeof(header);
+	iov[1].base = body;
+	iov[1].length = sizeof(body);
+	iov[2].base = (const uint8_t*)"tail";
+	iov[2].length = 4;
+	n = sizeof(header) + sizeof(body) + 4;
+	for (i = 0; i < n; i++)
+		if (whole[i] == 0xC0 || whole[i] == 0xDB)
+			escapes++;
+
+	wiznetHostInit();
+	wiznetHostSetSendHook(capture);
+	wiznetReset();
+	wiznetInit(sizes);
+	CHECK_EQ(wiznetOpenSocket(1, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+
+	// The same datagram from one buffer and from three fragments
+	transactions();
+	CHECK_EQ(wiznetSendToBegin(1, ip, 6000), WIZNET_SUCCESS);
+	wiznetSendData(whole, n);
+	CHECK_EQ(wiznetSendToCommit(), WIZNET_SUCCESS);
+	single = transactions();
+	CHECK_EQ(wiznetSendToV(1, ip, 6000, iov, 3), WIZNET_SUCCESS);
+	CHECK_EQ(transactions(), single);
+	CHECK_EQ(sentLength, n);
+	CHECK(memcmp(sent, whole, n) == 0);
+
+	CHECK_EQ(wiznetSendToBegin(1, ip, 6000), WIZNET_SUCCESS);
+	wiznetSendDataV(iov, 3);
+	CHECK_EQ(wiznetSendToCommit(), WIZNET_SUCCESS);
+	CHECK_EQ(transactions(), single);
+	CHECK_EQ(sentLength, n);
+	CHECK(memcmp(sent, whole, n) == 0);
+
+	// SLIP-escaped, the fragments encode as the whole would
+	CHECK_EQ(wiznetSendBeginSLIP(1), WIZNET_SUCCESS);
+	wiznetSendSLIPData(whole, n);
+	CHECK_EQ(wiznetSendCommitSLIP(), WIZNET_SUCCESS);
+	single = transactions();
+	memcpy(slip, sent, sentLength);
+	CHECK_EQ(sentLength, n + 2 + escapes);
+	CHECK_EQ(wiznetSendBeginSLIP(1), WIZNET_SUCCESS);
+	wiznetSendSLIPDataV(iov, 3);
+	CHECK_EQ(wiznetSendCommitSLIP(), WIZNET_SUCCESS);
+	CHECK_EQ(transactions(), single);
+	CHECK_EQ(sentLength, n + 2 + escapes);
+	CHECK(memcmp(sent, slip, sentLength) == 0);
+
+	// An empty gather still sends an empty datagram
+	CHECK_EQ(wiznetSendToV(1, ip, 6000, iov, 0), WIZNET_SUCCESS);
+	CHECK_EQ(sentLength, 0);
+
+	return checkFailures;
+}
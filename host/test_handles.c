@@ -0,0 +1,121 @@
+#include <stdint.h>
+#include <string.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** Per-socket transaction handles: sends and receives on different sockets
+** interleaved, collisions on one socket, and the SPI cost of writing and
+** reading through a handle
+*/
+
+static uint8_t sent[4][64];
+static uint16_t sentLength[4];
+static uint8_t sentSocket[4];
+static uint8_t sends;
+
+static void capture(uint8_t socket, const uint8_t* data, uint16_t len) {
+	if (sends < 4) {
+		memcpy(sent[sends], data, len);
+		sentLength[sends] = len;
+		sentSocket[sends] = socket;
+	}
+	sends++;
+}
+
+/* This function returns the SPI transactions since it was last called
+*/
+static uint32_t transactions(void) {
+	struct wiznetHostStats stats;
+
+	wiznetHostGetStats(&stats);
+	wiznetHostResetStats();
+	return stats.transactions;
+}
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t ip[4] = {10, 0, 0, 2}, from[4];
+	struct wiznetTransaction *a, *b, *other;
+	uint8_t back[2][16];
+	uint16_t port;
+
+	wiznetHostInit();
+	wiznetHostSetSendHook(capture);
+	wiznetReset();
+	wiznetInit(sizes);
+	CHECK_EQ(wiznetOpenSocket(1, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetOpenSocket(2, SOCK_UDP, 5001, 0), WIZNET_SUCCESS);
+
+	// Two datagrams built side by side and committed in the other order.
+	// Each write through a handle is one transaction.
+	CHECK_EQ(wiznetTxBeginTo(1, ip, 6000, &a), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetTxBeginTo(2, ip, 6001, &b), WIZNET_SUCCESS);
+	CHECK(a != b);
+	transactions();
+	wiznetTxData(a, (const uint8_t*)"one-", 4);
+	wiznetTxData(b, (const uint8_t*)"two-", 4);
+	wiznetTxData(a, (const uint8_t*)"a", 1);
+	wiznetTxData(b, (const uint8_t*)"b", 1);
+	CHECK_EQ(transactions(), 4);
+	CHECK_EQ(wiznetTxCommit(b), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetTxCommit(a), WIZNET_SUCCESS);
+	CHECK_EQ(sends, 2);
+	CHECK_EQ(sentSocket[0], 2);
+	CHECK_EQ(sentLength[0], 5);
+	CHECK(memcmp(sent[0], "two-b", 5) == 0);
+	CHECK_EQ(sentSocket[1], 1);
+	CHECK(memcmp(sent[1], "one-a", 5) == 0);
+
+	// A socket has one send handle, shared with the global API
+	CHECK_EQ(wiznetTxBegin(1, &a), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetTxBegin(1, &other), WIZNET_ERROR_SEND_COLLISION);
+	CHECK_EQ(wiznetTxBeginTo(1, ip, 6000, &other), WIZNET_ERROR_SEND_COLLISION);
+	CHECK_EQ(wiznetSendBegin(1), WIZNET_ERROR_SEND_COLLISION);
+	CHECK_EQ(wiznetSendBegin(2), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetSendAbandon(), WIZNET_SUCCESS);
+	wiznetTxData(a, (const uint8_t*)"dropped", 7);
+	CHECK_EQ(wiznetTxAbandon(a), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetTxCommit(a), WIZNET_ERROR_NOT_SENDING);
+	CHECK_EQ(sends, 2);
+	CHECK_EQ(wiznetTxBegin(1, &a), WIZNET_SUCCESS);
+	wiznetTxData(a, (const uint8_t*)"kept", 4);
+	CHECK_EQ(wiznetTxCommit(a), WIZNET_SUCCESS);
+	CHECK_EQ(sentLength[2], 4);
+	CHECK(memcmp(sent[2], "kept", 4) == 0);
+
+	// Receives on two sockets read in turn
+	CHECK_EQ(wiznetHostInjectUDP(1, ip, 7001, (const uint8_t*)"first datagram", 14), 0);
+	CHECK_EQ(wiznetHostInjectUDP(2, ip, 7002, (const uint8_t*)"second one", 10), 0);
+	CHECK_EQ(wiznetRxBegin(1, &a), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxBegin(2, &b), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxBegin(2, &other), WIZNET_ERROR_RECV_COLLISION);
+	CHECK_EQ(wiznetRecvBegin(2), WIZNET_ERROR_RECV_COLLISION);
+	CHECK_EQ(wiznetRxHeaderUDP(b, from, &port), 10);
+	CHECK_EQ(port, 7002);
+	CHECK_EQ(wiznetRxHeaderUDP(a, from, &port), 14);
+	CHECK_EQ(port, 7001);
+	transactions();
+	wiznetRxData(a, back[0], 6);
+	wiznetRxData(b, back[1], 7);
+	wiznetRxData(a, back[0] + 6, 8);
+	wiznetRxData(b, back[1] + 7, 3);
+	CHECK_EQ(transactions(), 4);
+	CHECK(memcmp(back[0], "first datagram", 14) == 0);
+	CHECK(memcmp(back[1], "second one", 10) == 0);
+	CHECK_EQ(wiznetRxCommit(a, 14), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvPeek(1), 0);
+
+	// An abandoned receive leaves the datagram where it was
+	CHECK_EQ(wiznetRxAbandon(b), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvPeek(2), 10 + 8);
+	CHECK_EQ(wiznetRecvBegin(2), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvHeaderUDP(from, &port), 10);
+	wiznetRecvData(back[1], 10);
+	CHECK_EQ(wiznetRecvCommit(10), WIZNET_SUCCESS);
+	CHECK(memcmp(back[1], "second one", 10) == 0);
+	CHECK_EQ(wiznetRecvPeek(2), 0);
+
+	return checkFailures;
+}
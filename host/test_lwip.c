@@ -0,0 +1,260 @@
+#include <stdint.h>
+#include <string.h>
+#include "util.h"
+#include "io_assignment.h"
+#include "wiznet_arch.h"
+#include "wiznet.h"
+#include "wiznet_io.h"
+#include "wiznet_regs.h"
+#include "wiznet_host.h"
+#include "wiznet_lwip.h"
+#include "lwip/stats.h"
+#include "check.h"
+
+/*
+** The lwIP port against the stand-in for lwIP in lwip/ and lwip_stub.c:
+** queued frames read into chained pool pbufs with one Sn_RX_RSR read and
+** one RECEIVE, frames that have not all arrived, corrupt headers, an empty
+** pool, and pbuf chains gathered into the chip by wiznetSendMACRAWV
+*/
+
+#define FRAMES 12
+#define MAX_FRAME 1514
+
+static uint8_t frame[FRAMES][MAX_FRAME];
+static uint8_t input[FRAMES][MAX_FRAME];
+static uint16_t inputLength[FRAMES];
+static uint8_t inputs, refuse;
+static uint8_t sent[MAX_FRAME];
+static uint16_t sentLength;
+
+static void capture(uint8_t socket, const uint8_t* data, uint16_t len) {
+	(void)socket;
+	memcpy(sent, data, len);
+	sentLength = len;
+}
+
+/* This function stands in for ethernet_input, keeping a flat copy of each
+** frame without its padding
+*/
+static err_t receive(struct pbuf* p, struct netif* netif) {
+	struct pbuf* q;
+	uint16_t offset = 0;
+
+	(void)netif;
+	if (refuse)
+		return ERR_MEM;
+	for (q = p; q != NULL; q = q->next) {
+		memcpy(input[inputs] + offset, q->payload, q->len);
+		offset += q->len;
+	}
+	CHECK_EQ(offset, p->tot_len);
+	inputLength[inputs] = offset - ETH_PAD_SIZE;
+	memmove(input[inputs], input[inputs] + ETH_PAD_SIZE, inputLength[inputs]);
+	inputs++;
+	pbuf_free(p);
+	return ERR_OK;
+}
+
+/* This function returns the SPI transactions since it was last called
+*/
+static uint32_t transactions(void) {
+	struct wiznetHostStats stats;
+
+	wiznetHostGetStats(&stats);
+	wiznetHostResetStats();
+	return stats.transactions;
+}
+
+/* This function returns the frames counted on the socket since it was last
+** called
+*/
+static uint16_t counted(void) {
+	struct wiznetStats stats;
+
+	wiznetGetStats(&stats);
+	wiznetResetStats();
+	return stats.sockets[WIZNET_LWIP_SOCKET].datagrams;
+}
+
+/* This function checks the frames passed to lwIP against frames first to
+** first+count-1 and forgets them
+*/
+static void checkInput(uint8_t first, uint8_t count, const uint16_t* lengths) {
+	uint8_t i;
+
+	CHECK_EQ(inputs, count);
+	for (i = 0; i < count && i < inputs; i++) {
+		CHECK_EQ(inputLength[i], lengths[first + i]);
+		CHECK(memcmp(input[i], frame[first + i], lengths[first + i]) == 0);
+	}
+	inputs = 0;
+}
+
+/* This function builds a pbuf chain out of a frame, in pieces of the given
+** lengths
+*/
+static struct pbuf* chain(const uint8_t* data, const uint16_t* pieces, uint8_t count) {
+	struct pbuf *p = NULL, *q, **tail = &p;
+	uint16_t total = 0;
+	uint8_t i;
+
+	for (i = 0; i < count; i++)
+		total += pieces[i];
+	for (i = 0; i < count; i++) {
+		q = pbuf_alloc(PBUF_RAW, pieces[i] + (i == 0 ? ETH_PAD_SIZE : 0), PBUF_RAM);
+		memcpy((uint8_t*)q->payload + (i == 0 ? ETH_PAD_SIZE : 0), data, pieces[i]);
+		q->tot_len = total + ETH_PAD_SIZE;
+		total -= pieces[i];
+		data += pieces[i];
+		*tail = q;
+		tail = &q->next;
+	}
+	return p;
+}
+
+int main(void) {
+	static const uint16_t lengths[FRAMES] = {60, 600, 1514, 255, 256, 257, 60, 64, 70, 80, 90, 100};
+	static const uint16_t two[2] = {14, 586};
+	static const uint16_t four[4] = {14, 20, 8, 558};
+	static const uint16_t five[5] = {14, 20, 8, 300, 258};
+	uint8_t sizes[8] = {8, 0, 0, 0, 0, 0, 0, 0};
+	uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01}, header[2];
+	uint32_t seed = 11, expect, one;
+	struct netif netif;
+	struct pbuf* p;
+	uint8_t i;
+
+	for (i = 0; i < FRAMES; i++)
+		wiznetHostFillPayload(frame[i], lengths[i], 0, &seed);
+	wiznetHostInit();
+	wiznetHostSetSendHook(capture);
+	wiznetReset();
+	wiznetInit(sizes);
+	wiznetSetSourceMAC(mac);
+	memset(&netif, 0, sizeof(netif));
+	CHECK_EQ(wiznetLwipInit(&netif), ERR_OK);
+	CHECK(memcmp(netif.hwaddr, mac, sizeof(mac)) == 0);
+	CHECK_EQ(wiznetGetSocketStatus(WIZNET_LWIP_SOCKET), Sn_SR_MACRAW);
+	netif.input = receive;
+
+	// Nothing waiting costs one read of Sn_RX_RSR with Sn_RX_RD
+	transactions();
+	CHECK_EQ(wiznetLwipPoll(&netif), 0);
+	CHECK_EQ(transactions(), 1);
+
+	// Queued frames land in chains of pool pbufs: one transaction to begin,
+	// one per header and per pbuf, and a single RECEIVE to finish
+	for (i = 0; i < 6; i++)
+		CHECK_EQ(wiznetHostInjectMACRAW(0, frame[i], lengths[i]), 0);
+	counted();
+	transactions();
+	CHECK_EQ(wiznetLwipPoll(&netif), 6);
+	expect = 1;
+	for (i = 0; i < 6; i++)
+		expect += 1 + (lengths[i] + ETH_PAD_SIZE + PBUF_POOL_BUFSIZE - 1) / PBUF_POOL_BUFSIZE;
+	CHECK_EQ(transactions() - expect, 3);
+	checkInput(0, 6, lengths);
+	CHECK_EQ(counted(), 6);
+	CHECK_EQ(lwip_stats.link.recv, 6);
+	CHECK_EQ(wiznetRecvPeek(0), 0);
+
+	// No more than WIZNET_LWIP_BATCH frames are taken at a time
+	for (i = 0; i < FRAMES; i++)
+		CHECK_EQ(wiznetHostInjectMACRAW(0, frame[i], lengths[i]), 0);
+	CHECK_EQ(wiznetLwipPoll(&netif), WIZNET_LWIP_BATCH);
+	checkInput(0, WIZNET_LWIP_BATCH, lengths);
+	CHECK_EQ(wiznetLwipPoll(&netif), FRAMES - WIZNET_LWIP_BATCH);
+	checkInput(WIZNET_LWIP_BATCH, FRAMES - WIZNET_LWIP_BATCH, lengths);
+	CHECK_EQ(counted(), FRAMES);
+
+	// A frame that has not all arrived is left for the next poll
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[0], lengths[0]), 0);
+	header[0] = (uint8_t)((lengths[1] + 2) >> 8);
+	header[1] = (uint8_t)(lengths[1] + 2);
+	CHECK_EQ(wiznetHostInjectRaw(0, header, sizeof(header)), 0);
+	CHECK_EQ(wiznetHostInjectRaw(0, frame[1], 100), 0);
+	CHECK_EQ(wiznetLwipPoll(&netif), 1);
+	checkInput(0, 1, lengths);
+	CHECK_EQ(wiznetLwipPoll(&netif), 0);
+	CHECK_EQ(wiznetRecvPeek(0), 102);
+	CHECK_EQ(wiznetHostInjectRaw(0, frame[1] + 100, lengths[1] - 100), 0);
+	CHECK_EQ(wiznetLwipPoll(&netif), 1);
+	checkInput(1, 1, lengths);
+	CHECK_EQ(counted(), 2);
+
+	// With the pool empty the frame is dropped and the next one still read
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[2], lengths[2]), 0);
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[3], lengths[3]), 0);
+	lwipStubFailNextAlloc();
+	CHECK_EQ(wiznetLwipPoll(&netif), 1);
+	checkInput(3, 1, lengths);
+	CHECK_EQ(lwip_stats.link.memerr, 1);
+	CHECK_EQ(lwip_stats.link.drop, 1);
+	CHECK_EQ(counted(), 2);
+
+	// A corrupt header: the frames before it go up, the rest is dropped and
+	// the next frame is found
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[4], lengths[4]), 0);
+	header[0] = 0x00;
+	header[1] = 0x01;
+	CHECK_EQ(wiznetHostInjectRaw(0, header, sizeof(header)), 0);
+	CHECK_EQ(wiznetHostInjectRaw(0, frame[5], 40), 0);
+	CHECK_EQ(wiznetLwipPoll(&netif), 1);
+	checkInput(4, 1, lengths);
+	CHECK_EQ(lwip_stats.link.err, 1);
+	CHECK_EQ(wiznetRecvPeek(0), 0);
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[5], lengths[5]), 0);
+	CHECK_EQ(wiznetLwipPoll(&netif), 1);
+	checkInput(5, 1, lengths);
+
+	// A frame lwIP does not take is freed
+	refuse = 1;
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[0], lengths[0]), 0);
+	CHECK_EQ(wiznetLwipPoll(&netif), 1);
+	refuse = 0;
+	CHECK_EQ(lwipStubPbufsInUse, 0);
+
+	// Sending: a chain is gathered into the chip with the same SPI traffic
+	// as a single pbuf, up to WIZNET_LWIP_IOV pieces
+	p = chain(frame[1], &lengths[1], 1);
+	transactions();
+	CHECK_EQ(netif.linkoutput(&netif, p), ERR_OK);
+	one = transactions();
+	CHECK_EQ(sentLength, lengths[1]);
+	CHECK(memcmp(sent, frame[1], lengths[1]) == 0);
+	CHECK_EQ(p->tot_len, lengths[1] + ETH_PAD_SIZE);
+	pbuf_free(p);
+	CHECK_EQ(wiznetSendWait(0), WIZNET_SUCCESS);
+	p = chain(frame[1], two, 2);
+	transactions();
+	CHECK_EQ(netif.linkoutput(&netif, p), ERR_OK);
+	CHECK_EQ(transactions(), one);
+	CHECK(memcmp(sent, frame[1], lengths[1]) == 0);
+	pbuf_free(p);
+	CHECK_EQ(wiznetSendWait(0), WIZNET_SUCCESS);
+	p = chain(frame[1], four, 4);
+	transactions();
+	CHECK_EQ(netif.linkoutput(&netif, p), ERR_OK);
+	CHECK_EQ(transactions(), one);
+	CHECK(memcmp(sent, frame[1], lengths[1]) == 0);
+	pbuf_free(p);
+	CHECK_EQ(wiznetSendWait(0), WIZNET_SUCCESS);
+
+	// A longer chain is flattened first, and is dropped if that fails
+	p = chain(frame[1], five, 5);
+	CHECK_EQ(netif.linkoutput(&netif, p), ERR_OK);
+	CHECK_EQ(sentLength, lengths[1]);
+	CHECK(memcmp(sent, frame[1], lengths[1]) == 0);
+	CHECK_EQ(wiznetSendWait(0), WIZNET_SUCCESS);
+	lwipStubFailNextAlloc();
+	sentLength = 0;
+	CHECK_EQ(netif.linkoutput(&netif, p), ERR_MEM);
+	CHECK_EQ(sentLength, 0);
+	CHECK_EQ(p->tot_len, lengths[1] + ETH_PAD_SIZE);
+	pbuf_free(p);
+	CHECK_EQ(lwip_stats.link.xmit, 4);
+	CHECK_EQ(lwipStubPbufsInUse, 0);
+
+	return checkFailures;
+}
@@ -0,0 +1,199 @@
+#include <stdint.h>
+#include <string.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** MACRAW round trip: frames gathered from fragments go out through
+** wiznetSendMACRAWV, are fed back in as received frames and read with
+** wiznetRecvMACRAWBatch and wiznetRecvMACRAWVisit, which count only the
+** frames they commit and drop the buffer when a header is corrupt
+*/
+
+#define FRAMES 8
+#define MAX_FRAME 1514
+
+static uint8_t sent[FRAMES][MAX_FRAME];
+static uint16_t sentLength[FRAMES];
+static uint8_t sends;
+
+static void capture(uint8_t socket, const uint8_t* data, uint16_t len) {
+	(void)socket;
+	if (sends < FRAMES) {
+		memcpy(sent[sends], data, len);
+		sentLength[sends] = len;
+	}
+	sends++;
+}
+
+static uint32_t visited, frameEnds;
+
+/* This function returns the frames counted on socket 0 since it was last
+** called, or 0 without WIZNET_STATS
+*/
+static uint16_t counted(void) {
+#ifdef WIZNET_STATS
+	struct wiznetStats stats;
+
+	wiznetGetStats(&stats);
+	wiznetResetStats();
+	return stats.sockets[0].datagrams;
+#else
+	return 0;
+#endif
+}
+
+/* This function has a header giving length come in, followed by the start
+** of a frame
+*/
+static void injectHeader(uint16_t length, const uint8_t* data) {
+	uint8_t header[2] = {(uint8_t)((length + 2) >> 8), (uint8_t)(length + 2)};
+
+	CHECK_EQ(wiznetHostInjectRaw(0, header, sizeof(header)), 0);
+	CHECK_EQ(wiznetHostInjectRaw(0, data, 20), 0);
+}
+
+static int visit(void* ctx, const uint8_t* data, uint16_t length) {
+	if (data == NULL) {
+		frameEnds++;
+		return (ctx != NULL) ? WIZNET_VISIT_STOP : 0;
+	}
+	visited += length;
+	return 0;
+}
+
+int main(void) {
+	static uint8_t frame[FRAMES][MAX_FRAME];
+	static uint8_t back[FRAMES][MAX_FRAME];
+	static const uint16_t lengths[FRAMES] = {60, 64, 100, 333, 590, 1000, 1513, 1514};
+	uint8_t sizes[8] = {8, 0, 0, 0, 0, 0, 0, 0};
+	struct wiznetRawFrame frames[FRAMES];
+	struct wiznetIOVec iov[3];
+	uint32_t seed = 7;
+	uint16_t split;
+	uint8_t i;
+
+	wiznetHostInit();
+	wiznetHostSetSendHook(capture);
+	wiznetReset();
+	wiznetInit(sizes);
+	CHECK_EQ(wiznetOpenSocket(0, SOCK_MACRAW, 0, 0), WIZNET_SUCCESS);
+
+	// Send each frame in three fragments, the first ending inside the header
+	for (i = 0; i < FRAMES; i++) {
+		wiznetHostFillPayload(frame[i], lengths[i], 0, &seed);
+		split = lengths[i] / 3;
+		iov[0].base = frame[i];
+		iov[0].length = 13;
+		iov[1].base = frame[i] + 13;
+		iov[1].length = split;
+		iov[2].base = frame[i] + 13 + split;
+		iov[2].length = lengths[i] - 13 - split;
+		CHECK_EQ(wiznetSendMACRAWV(0, iov, 3), WIZNET_SUCCESS);
+	}
+	CHECK_EQ(wiznetSendWait(0), WIZNET_SUCCESS);
+	CHECK_EQ(sends, FRAMES);
+	for (i = 0; i < FRAMES; i++) {
+		CHECK_EQ(sentLength[i], lengths[i]);
+		CHECK(memcmp(sent[i], frame[i], lengths[i]) == 0);
+	}
+
+	// Feed them back in and take them all with one batch
+	for (i = 0; i < FRAMES; i++) {
+		CHECK_EQ(wiznetHostInjectMACRAW(0, sent[i], sentLength[i]), 0);
+		frames[i].data = back[i];
+		frames[i].size = MAX_FRAME;
+	}
+	CHECK_EQ(wiznetRecvMACRAWBatch(0, frames, 4), 4);
+	CHECK_EQ(wiznetRecvMACRAWBatch(0, frames + 4, FRAMES - 4), FRAMES - 4);
+	for (i = 0; i < FRAMES; i++) {
+		CHECK_EQ(frames[i].length, lengths[i]);
+		CHECK(memcmp(back[i], frame[i], lengths[i]) == 0);
+	}
+	CHECK_EQ(wiznetRecvPeek(0), 0);
+	CHECK_EQ(wiznetRecvMACRAWBatch(0, frames, FRAMES), 0);
+
+	// A short buffer truncates the frame but reports its full length, and
+	// the next frame is still found
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[7], lengths[7]), 0);
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[0], lengths[0]), 0);
+	frames[0].size = 100;
+	CHECK_EQ(wiznetRecvMACRAWBatch(0, frames, 2), 2);
+	CHECK_EQ(frames[0].length, lengths[7]);
+	CHECK(memcmp(back[0], frame[7], 100) == 0);
+	CHECK_EQ(frames[1].length, lengths[0]);
+	CHECK(memcmp(back[1], frame[0], lengths[0]) == 0);
+
+	// Visiting sees every byte and the end of every frame, and can stop
+	for (i = 0; i < 3; i++)
+		CHECK_EQ(wiznetHostInjectMACRAW(0, frame[i], lengths[i]), 0);
+	CHECK_EQ(wiznetRecvMACRAWVisit(0, visit, NULL, FRAMES), 3);
+	CHECK_EQ(visited, lengths[0] + lengths[1] + lengths[2]);
+	CHECK_EQ(frameEnds, 3);
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[0], lengths[0]), 0);
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[1], lengths[1]), 0);
+	CHECK_EQ(wiznetRecvMACRAWVisit(0, visit, (void*)1, FRAMES), 1);
+	CHECK_EQ(wiznetRecvPeek(0), lengths[1] + 2);
+	CHECK_EQ(wiznetRecvMACRAWVisit(0, visit, NULL, FRAMES), 1);
+
+	// A frame only part of which has come in is left, and not counted
+	counted();
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[0], lengths[0]), 0);
+	injectHeader(lengths[1], frame[1]);
+	CHECK_EQ(wiznetRecvMACRAWBatch(0, frames, FRAMES), 1);
+	CHECK_EQ(wiznetRecvMACRAWVisit(0, visit, NULL, FRAMES), 0);
+	CHECK_EQ(wiznetRecvPeek(0), 2 + 20);
+	CHECK_EQ(wiznetHostInjectRaw(0, frame[1] + 20, lengths[1] - 20), 0);
+	CHECK_EQ(wiznetRecvMACRAWVisit(0, visit, NULL, FRAMES), 1);
+#ifdef WIZNET_STATS
+	CHECK_EQ(counted(), 2);
+#endif
+
+	// A header giving a length no frame can have, even one that wraps: the
+	// frames before it are taken, then everything waiting is dropped and
+	// the next frame is found
+	injectHeader(WIZNET_MACRAW_MIN - 1, frame[2]);
+	CHECK_EQ(wiznetRecvMACRAWBatch(0, frames, FRAMES), WIZNET_ERROR_FRAME_CORRUPT);
+	CHECK_EQ(wiznetRecvPeek(0), 0);
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[0], lengths[0]), 0);
+	injectHeader(0xFFFF, frame[2]);
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[1], lengths[1]), 0);
+	CHECK_EQ(wiznetRecvMACRAWBatch(0, frames, FRAMES), 1);
+	CHECK_EQ(frames[0].length, lengths[0]);
+	CHECK_EQ(wiznetRecvMACRAWBatch(0, frames, FRAMES), WIZNET_ERROR_FRAME_CORRUPT);
+	CHECK_EQ(wiznetRecvPeek(0), 0);
+	injectHeader(WIZNET_MACRAW_MAX + 1, frame[2]);
+	CHECK_EQ(wiznetRecvMACRAWVisit(0, visit, NULL, FRAMES), WIZNET_ERROR_FRAME_CORRUPT);
+	CHECK_EQ(wiznetRecvPeek(0), 0);
+	CHECK_EQ(wiznetHostInjectMACRAW(0, frame[1], lengths[1]), 0);
+	CHECK_EQ(wiznetRecvMACRAWBatch(0, frames, FRAMES), 1);
+	CHECK_EQ(frames[0].length, lengths[1]);
+	CHECK(memcmp(back[0], frame[1], lengths[1]) == 0);
+#ifdef WIZNET_STATS
+	CHECK_EQ(counted(), 2);
+#endif
+
+	// A frame larger than the TX memory is refused
+	sizes[0] = 1;
+	wiznetInitBufferSizes(sizes, sizes);
+	CHECK_EQ(wiznetOpenSocket(0, SOCK_MACRAW, 0, 0), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetSendMACRAW(0, frame[7], lengths[7]), WIZNET_ERROR_FRAME_TOO_LONG);
+
+	// A frame is not written over one still waiting in the TX memory. The
+	// next SEND goes out from Sn_TX_RD, so it carries both.
+	sends = 0;
+	wiznetHostSetLatency(10);
+	wiznetHostFailNextSend(0);
+	CHECK_EQ(wiznetSendMACRAW(0, frame[5], 600), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetSendMACRAW(0, frame[4], 590), WIZNET_IN_PROGRESS);
+	CHECK_EQ(wiznetSendMACRAW(0, frame[0], 60), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetSendWait(0), WIZNET_SUCCESS);
+	CHECK_EQ(sends, 1);
+	CHECK_EQ(sentLength[0], 600 + 60);
+	CHECK(memcmp(sent[0], frame[5], 600) == 0);
+	CHECK(memcmp(sent[0] + 600, frame[0], 60) == 0);
+	wiznetHostSetLatency(0);
+
+	return checkFailures;
+}
@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <string.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** Non-blocking send commits: a commit returns while the chip is sending,
+** the outcome is collected by wiznetSendPoll, wiznetSendWait or
+** wiznetSendReap, and closing the socket forgets it
+*/
+
+static uint8_t sent[4][64];
+static uint16_t sentLength[4];
+static uint8_t sends;
+static uint8_t doneSockets;
+static int doneResult;
+
+static void capture(uint8_t socket, const uint8_t* data, uint16_t len) {
+	(void)socket;
+	if (sends < 4) {
+		memcpy(sent[sends], data, len);
+		sentLength[sends] = len;
+	}
+	sends++;
+}
+
+static void sendDone(uint8_t socket, int result) {
+	doneSockets |= 1 << socket;
+	doneResult = result;
+}
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t ip[4] = {10, 0, 0, 2};
+	uint8_t i;
+
+	wiznetHostInit();
+	wiznetHostSetSendHook(capture);
+	wiznetReset();
+	wiznetInit(sizes);
+	CHECK_EQ(wiznetOpenSocket(1, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetOpenSocket(2, SOCK_UDP, 5001, 0), WIZNET_SUCCESS);
+	wiznetSetSendCompleteHandler(sendDone);
+
+	// The commit returns while the chip is still sending
+	wiznetHostSetLatency(20);
+	CHECK_EQ(wiznetSendToBegin(1, ip, 6000), WIZNET_SUCCESS);
+	wiznetSendData((const uint8_t*)"first", 5);
+	CHECK_EQ(wiznetSendToCommitAsync(), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetSendPoll(1), WIZNET_IN_PROGRESS);
+	CHECK_EQ(doneSockets, 0);
+
+	// and the next datagram can be written meanwhile. Its commit waits for
+	// the first to finish, as the chip takes one SEND at a time.
+	CHECK_EQ(wiznetSendToBegin(1, ip, 6000), WIZNET_SUCCESS);
+	wiznetSendData((const uint8_t*)"second", 6);
+	CHECK_EQ(wiznetSendToCommitAsync(), WIZNET_SUCCESS);
+	CHECK_EQ(doneSockets, 1 << 1);
+	CHECK_EQ(doneResult, WIZNET_SUCCESS);
+	CHECK_EQ(wiznetSendPoll(1), WIZNET_IN_PROGRESS);
+	CHECK_EQ(sends, 2);
+	CHECK_EQ(sentLength[0], 5);
+	CHECK(memcmp(sent[0], "first", 5) == 0);
+	CHECK_EQ(sentLength[1], 6);
+	CHECK(memcmp(sent[1], "second", 6) == 0);
+
+	// wiznetSendReap collects every finished send
+	CHECK_EQ(wiznetSendToBegin(2, ip, 6000), WIZNET_SUCCESS);
+	wiznetSendData((const uint8_t*)"third", 5);
+	CHECK_EQ(wiznetSendToCommitAsync(), WIZNET_SUCCESS);
+	doneSockets = 0;
+	for (i = 0; i < 100 && doneSockets != ((1 << 1) | (1 << 2)); i++)
+		wiznetSendReap();
+	CHECK_EQ(doneSockets, (1 << 1) | (1 << 2));
+	CHECK_EQ(sends, 3);
+	CHECK(memcmp(sent[2], "third", 5) == 0);
+	CHECK_EQ(wiznetSendPoll(1), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetSendWait(2), WIZNET_SUCCESS);
+
+	// A send that times out is reported as failed
+	wiznetHostFailNextSend(1);
+	CHECK_EQ(wiznetSendToBegin(1, ip, 6000), WIZNET_SUCCESS);
+	wiznetSendData((const uint8_t*)"lost", 4);
+	CHECK_EQ(wiznetSendToCommitAsync(), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetSendWait(1), WIZNET_ERROR_SEND_DATA);
+	CHECK_EQ(doneResult, WIZNET_ERROR_SEND_DATA);
+	CHECK_EQ(wiznetSendPoll(1), WIZNET_ERROR_SEND_DATA);
+
+	// Closing the socket forgets that outcome, and a send still in flight
+	// is dropped without calling the handler
+	wiznetCloseSocket(1);
+	CHECK_EQ(wiznetSendPoll(1), WIZNET_ERROR_NOT_SENDING);
+	CHECK_EQ(wiznetSendToBegin(2, ip, 6000), WIZNET_SUCCESS);
+	wiznetSendData((const uint8_t*)"fifth", 5);
+	CHECK_EQ(wiznetSendToCommitAsync(), WIZNET_SUCCESS);
+	wiznetCloseSocket(2);
+	doneSockets = 0;
+	CHECK_EQ(wiznetSendWait(2), WIZNET_ERROR_NOT_SENDING);
+	CHECK_EQ(doneSockets, 0);
+
+	// After reopening the socket only its new sends are reported
+	wiznetHostSetLatency(0);
+	CHECK_EQ(wiznetOpenSocket(1, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetSendPoll(1), WIZNET_ERROR_NOT_SENDING);
+	CHECK_EQ(wiznetSendToBegin(1, ip, 6000), WIZNET_SUCCESS);
+	wiznetSendData((const uint8_t*)"sixth", 5);
+	CHECK_EQ(wiznetSendToCommit(), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetSendPoll(1), WIZNET_SUCCESS);
+
+	return checkFailures;
+}
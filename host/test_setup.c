@@ -0,0 +1,98 @@
+#include <stdint.h>
+#include "util.h"
+#include "io_assignment.h"
+#include "wiznet_arch.h"
+#include "wiznet.h"
+#include "wiznet_io.h"
+#include "wiznet_regs.h"
+#include "check.h"
+
+/*
+** Non-blocking socket set-up: several sockets opened, connected and set
+** listening from one loop of wiznetSocketPoll, one SPI transaction per
+** poll, and set-ups that fail or are abandoned
+*/
+
+/* This function polls a socket and returns the SPI transactions it took
+*/
+static uint32_t poll(uint8_t socket, int* ret) {
+	struct wiznetHostStats stats;
+
+	wiznetHostResetStats();
+	*ret = wiznetSocketPoll(socket);
+	wiznetHostGetStats(&stats);
+	return stats.transactions;
+}
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t ip[4] = {10, 0, 0, 2};
+	uint8_t pending, loops, i;
+	int ret[8];
+
+	wiznetHostInit();
+	wiznetReset();
+	wiznetInit(sizes);
+	wiznetHostSetLatency(10);
+
+	// Open three sockets from one loop
+	CHECK_EQ(wiznetOpenSocketStart(1, SOCK_UDP, 5000, 0), WIZNET_IN_PROGRESS);
+	CHECK_EQ(wiznetOpenSocketStart(2, SOCK_TCP, 5001, 0), WIZNET_IN_PROGRESS);
+	CHECK_EQ(wiznetOpenSocketStart(3, SOCK_TCP, 5002, 0), WIZNET_IN_PROGRESS);
+	CHECK_EQ(wiznetOpenSocketStart(4, 9, 5003, 0), WIZNET_ERROR_UNKNOWN_PROTOCOL);
+	for (i = 1; i <= 3; i++) {
+		CHECK_EQ(poll(i, &ret[i]), 1);
+		CHECK_EQ(ret[i], WIZNET_SUCCESS);
+	}
+
+	// then connect one and set another listening, side by side. Each poll
+	// reads Sn_IR and Sn_SR in one transaction.
+	CHECK_EQ(wiznetConnectSocketStart(2, ip, 80), WIZNET_IN_PROGRESS);
+	CHECK_EQ(wiznetListenOnSocketStart(3), WIZNET_IN_PROGRESS);
+	pending = (1 << 2) | (1 << 3);
+	for (loops = 0; pending && loops < 50; loops++)
+		for (i = 2; i <= 3; i++) {
+			if (!(pending & (1 << i)))
+				continue;
+			CHECK_EQ(poll(i, &ret[i]), 1);
+			if (ret[i] != WIZNET_IN_PROGRESS)
+				pending &= ~(1 << i);
+		}
+	CHECK_EQ(pending, 0);
+	CHECK(loops > 1);
+	CHECK_EQ(ret[2], WIZNET_SUCCESS);
+	CHECK_EQ(ret[3], WIZNET_SUCCESS);
+	CHECK_EQ(wiznetGetSocketStatus(2), Sn_SR_ESTABLISHED);
+	CHECK_EQ(wiznetGetSocketStatus(3), Sn_SR_LISTEN);
+
+	// A finished set-up keeps reporting its result without touching the bus
+	CHECK_EQ(poll(2, &ret[2]), 0);
+	CHECK_EQ(ret[2], WIZNET_SUCCESS);
+
+	// An unreachable peer times the connection out and closes the socket
+	wiznetHostSetPeerReachable(2, 0);
+	CHECK_EQ(wiznetOpenSocket(2, SOCK_TCP, 5001, 0), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetConnectSocketStart(2, ip, 80), WIZNET_IN_PROGRESS);
+	for (loops = 0; loops < 50 && (ret[2] = wiznetSocketPoll(2)) == WIZNET_IN_PROGRESS; loops++)
+		;
+	CHECK_EQ(ret[2], WIZNET_ERROR_SOCKET_TIMEOUT);
+	CHECK_EQ(wiznetGetSocketStatus(2), Sn_SR_CLOSED);
+	CHECK_EQ(wiznetSocketPoll(2), WIZNET_ERROR_SOCKET_TIMEOUT);
+	wiznetHostSetPeerReachable(2, 1);
+
+	// Closing the socket abandons a set-up under way. It is not picked up
+	// again by the next poll, and the socket opens afresh.
+	CHECK_EQ(wiznetOpenSocket(2, SOCK_TCP, 5001, 0), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetConnectSocketStart(2, ip, 80), WIZNET_IN_PROGRESS);
+	CHECK_EQ(poll(2, &ret[2]), 1);
+	CHECK_EQ(ret[2], WIZNET_IN_PROGRESS);
+	wiznetCloseSocket(2);
+	CHECK_EQ(poll(2, &ret[2]), 0);
+	CHECK_EQ(ret[2], WIZNET_ERROR_SOCKET_OPEN);
+	CHECK_EQ(wiznetOpenSocket(2, SOCK_UDP, 5001, 0), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetGetSocketStatus(2), Sn_SR_UDP);
+	CHECK_EQ(poll(2, &ret[2]), 0);
+	CHECK_EQ(ret[2], WIZNET_SUCCESS);
+
+	return checkFailures;
+}
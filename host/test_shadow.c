@@ -0,0 +1,97 @@
+#include <stdint.h>
+#include <string.h>
+#include "util.h"
+#include "io_assignment.h"
+#include "wiznet_arch.h"
+#include "wiznet.h"
+#include "wiznet_io.h"
+#include "wiznet_regs.h"
+#include "check.h"
+
+/*
+** Shadow registers: built with and without WIZNET_SHADOW_REGISTERS, the
+** SPI cost of sending a datagram, to the same and to a new destination,
+** and that datagrams still arrive intact through the cached buffer
+** pointers. wiznetShadowResync is checked after the chip has been reset
+** behind the driver's back.
+*/
+
+#ifdef WIZNET_SHADOW_REGISTERS
+#define SEND_NEW 7      //Sn_TX_WR comes from the shadow
+#define SEND_SAME 6     //and Sn_DIPR/Sn_DPORT are not written again
+#define SEND_READ 2     //Sn_TX_FSR is the only register read
+#else
+#define SEND_NEW 8
+#define SEND_SAME 8
+#define SEND_READ 4
+#endif
+
+static uint8_t sent[300];
+static uint16_t sentLength;
+
+static void capture(uint8_t socket, const uint8_t* data, uint16_t len) {
+	(void)socket;
+	memcpy(sent, data, len);
+	sentLength = len;
+}
+
+/* This function sends one datagram and returns the SPI transactions it took
+*/
+static uint32_t sendTo(uint8_t* ip, uint16_t port, const uint8_t* data, uint16_t length) {
+	struct wiznetHostStats stats;
+
+	wiznetHostResetStats();
+	CHECK_EQ(wiznetSendToBegin(1, ip, port), WIZNET_SUCCESS);
+	wiznetSendData(data, length);
+	CHECK_EQ(wiznetSendToCommit(), WIZNET_SUCCESS);
+	wiznetHostGetStats(&stats);
+	CHECK_EQ(stats.readBytes, SEND_READ);
+	CHECK_EQ(sentLength, length);
+	CHECK(memcmp(sent, data, length) == 0);
+	return stats.transactions;
+}
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t ip[4] = {10, 0, 0, 2}, other[4] = {10, 0, 0, 3};
+	uint8_t payload[300], back[300], from[4];
+	uint16_t port, i;
+
+	for (i = 0; i < sizeof(payload); i++)
+		payload[i] = (uint8_t)(i * 3);
+	wiznetHostInit();
+	wiznetHostSetSendHook(capture);
+	wiznetReset();
+	wiznetInit(sizes);
+	CHECK_EQ(wiznetOpenSocket(1, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+
+	CHECK_EQ(sendTo(ip, 6000, payload, 100), SEND_NEW);
+	CHECK_EQ(sendTo(ip, 6000, payload, 100), SEND_SAME);
+	CHECK_EQ(sendTo(other, 6000, payload, 100), SEND_NEW);
+	CHECK_EQ(sendTo(other, 6001, payload, 100), SEND_NEW);
+	CHECK_EQ(sendTo(other, 6001, payload, 100), SEND_SAME);
+
+	// Enough datagrams each way to wrap the 2KB buffers several times
+	for (i = 0; i < 20; i++) {
+		payload[0] = (uint8_t)i;
+		sendTo(ip, 6000, payload, sizeof(payload));
+		CHECK_EQ(wiznetHostInjectUDP(1, ip, 7000, payload, sizeof(payload)), 0);
+		CHECK_EQ(wiznetRecvBegin(1), WIZNET_SUCCESS);
+		CHECK_EQ(wiznetRecvHeaderUDP(from, &port), sizeof(payload));
+		wiznetRecvData(back, sizeof(back));
+		CHECK_EQ(wiznetRecvCommit(sizeof(back)), WIZNET_SUCCESS);
+		CHECK(memcmp(back, payload, sizeof(payload)) == 0);
+	}
+	CHECK_EQ(wiznetRecvPeek(1), 0);
+
+#ifdef WIZNET_SHADOW_REGISTERS
+	// A reset the driver did not make leaves the shadow stale until resynced
+	wiznetHostInit();
+	CHECK_EQ(wiznetGetSocketSourcePort(1), 5000);
+	wiznetShadowResync();
+	CHECK_EQ(wiznetGetSocketSourcePort(1), 0);
+	CHECK_EQ(wiznetGetSocketMode(1), 0);
+#endif
+
+	return checkFailures;
+}
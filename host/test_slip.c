@@ -0,0 +1,131 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** SLIP encoding and decoding against a byte-at-a-time reference, with the
+** bytes to escape placed at every position around the word boundaries the
+** clean-run scan works on, and at random over a range of escape densities
+*/
+
+#define SOCKET 1
+#define MAX_DATA 640
+
+static uint8_t sent[2 * MAX_DATA + 2];
+static uint16_t sentLength;
+
+static void capture(uint8_t socket, const uint8_t* data, uint16_t len) {
+	(void)socket;
+	memcpy(sent, data, len);
+	sentLength = len;
+}
+
+/* This function SLIP-encodes a frame one byte at a time
+*/
+static uint16_t reference(const uint8_t* buf, uint16_t length, uint8_t* out) {
+	uint16_t n = 0, i;
+
+	out[n++] = 0xC0;
+	for (i = 0; i < length; i++) {
+		if (buf[i] == 0xC0) {
+			out[n++] = 0xDB;
+			out[n++] = 0xDC;
+		} else if (buf[i] == 0xDB) {
+			out[n++] = 0xDB;
+			out[n++] = 0xDD;
+		} else
+			out[n++] = buf[i];
+	}
+	out[n++] = 0xC0;
+	return n;
+}
+
+/* This function sends buf as one SLIP frame, checks what went out against
+** the reference, then receives it back and checks the decoded data. An
+** empty frame is only sent, as a receiver passes over it like line noise.
+*/
+static void roundTrip(const uint8_t* buf, uint16_t length) {
+	static uint8_t expect[2 * MAX_DATA + 2];
+	static uint8_t back[MAX_DATA + 1];
+	struct wiznetTransaction *tx, *rx;
+	uint16_t n, received = 0;
+	int failures = checkFailures;
+
+	n = reference(buf, length, expect);
+	wiznetTxBeginSLIP(SOCKET, &tx);
+	wiznetTxSLIPData(tx, buf, length);
+	CHECK_EQ(wiznetTxCommitSLIP(tx), WIZNET_SUCCESS);
+	CHECK_EQ(sentLength, n);
+	CHECK(memcmp(sent, expect, n) == 0);
+	if (length == 0)
+		return;
+
+	CHECK_EQ(wiznetHostInjectRaw(SOCKET, expect, n), 0);
+	CHECK_EQ(wiznetRxBeginSLIP(SOCKET, &rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxSLIPFrame(rx, back, sizeof(back), &received), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxCommitSLIP(rx), WIZNET_SUCCESS);
+	CHECK_EQ(received, length);
+	CHECK(memcmp(back, buf, length) == 0);
+	CHECK_EQ(wiznetRecvPeek(SOCKET), 0);
+
+	if (checkFailures != failures)
+		fprintf(stderr, "  in a frame of %u bytes at offset %u\n", length,
+				(unsigned)((uintptr_t)buf & (sizeof(uintptr_t) - 1)));
+}
+
+int main(void) {
+	static const uint8_t specials[] = {0xC0, 0xDB};
+	// Bytes one bit or one step away from the escaped values, and their
+	// 7-bit counterparts, which a faulty word test could confuse with them
+	static const uint8_t near[] = {0xC1, 0xBF, 0xDA, 0xDC, 0x40, 0x5B, 0x00, 0xFF};
+	static const uint8_t densities[] = {0, 1, 10, 50, 100};
+	static uint8_t data[MAX_DATA + 16];
+	uint8_t sizes[8] = {2, 4, 2, 2, 2, 2, 2, 0};
+	uint8_t ip[4] = {10, 0, 0, 2};
+	uint16_t length, at, offset, i, d;
+	uint32_t seed = 1;
+	uint8_t s;
+
+	wiznetHostInit();
+	wiznetHostSetSendHook(capture);
+	wiznetReset();
+	wiznetInit(sizes);
+	wiznetOpenSocket(SOCKET, SOCK_TCP, 5000, 0);
+	CHECK_EQ(wiznetConnectSocket(SOCKET, ip, 80), WIZNET_SUCCESS);
+
+	// One byte to escape, at every position and alignment
+	for (offset = 0; offset < 8; offset++)
+		for (length = 0; length <= 3 * 8 + 1; length++)
+			for (at = 0; at <= length; at++)
+				for (s = 0; s < sizeof(specials); s++) {
+					for (i = 0; i < length; i++)
+						data[offset + i] = near[(i + at) % sizeof(near)];
+					if (at < length)
+						data[offset + at] = specials[s];
+					roundTrip(data + offset, length);
+				}
+
+	// Two bytes to escape, one word apart and side by side
+	for (offset = 0; offset < 8; offset++)
+		for (at = 0; at + 9 <= 32; at++) {
+			memset(data + offset, 0x41, 32);
+			data[offset + at] = 0xDB;
+			data[offset + at + 1] = 0xC0;
+			data[offset + at + 8] = 0xC0;
+			roundTrip(data + offset, 32);
+		}
+
+	// Random frames over a range of escape densities
+	for (d = 0; d < sizeof(densities); d++)
+		for (i = 0; i < 50; i++) {
+			offset = i % 8;
+			length = (uint16_t)(seed % MAX_DATA);
+			wiznetHostFillPayload(data + offset, length, densities[d], &seed);
+			roundTrip(data + offset, length);
+		}
+
+	return checkFailures;
+}
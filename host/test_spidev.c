@@ -0,0 +1,83 @@
+#include <stdint.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "wiznet_spidev.h"
+#include "check.h"
+
+/*
+** spidev backend through its stand-in for the ioctl layer: SPI_IOC_MESSAGE
+** calls per UDP datagram sent and received, with and without
+** WIZNET_SPIDEV_POSTED_WRITES, and what a failed ioctl hands back
+*/
+
+#ifdef WIZNET_SPIDEV_POSTED_WRITES
+#define SEND_SYSCALLS 4    //Writes ride along with the read that follows them
+#define RECV_SYSCALLS 4
+#else
+#define SEND_SYSCALLS 8    //One per SPI transaction
+#define RECV_SYSCALLS 6
+#endif
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t ip[4] = {10, 0, 0, 2};
+	uint8_t payload[100], back[100], from[4];
+	struct wiznetSpidevStats stats;
+	struct wiznetHostStats bus;
+	uint16_t port, i;
+
+	for (i = 0; i < sizeof(payload); i++)
+		payload[i] = (uint8_t)i;
+	wiznetHostInit();
+	CHECK_EQ(wiznetSpidevOpen("/dev/null", 1000000), 0);
+	wiznetReset();
+	wiznetInit(sizes);
+	CHECK_EQ(wiznetOpenSocket(1, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+
+	// One datagram out
+	wiznetSpidevResetStats();
+	wiznetHostResetStats();
+	CHECK_EQ(wiznetSendToBegin(1, ip, 6000), WIZNET_SUCCESS);
+	wiznetSendData(payload, sizeof(payload));
+	CHECK_EQ(wiznetSendToCommit(), WIZNET_SUCCESS);
+	wiznetSpidevGetStats(&stats);
+	wiznetHostGetStats(&bus);
+	CHECK_EQ(stats.syscalls, SEND_SYSCALLS);
+	CHECK_EQ(stats.transfers, bus.transactions);
+	CHECK_EQ(stats.bytes, bus.bytes);
+	CHECK_EQ(stats.errors, 0);
+
+	// and one in
+	CHECK_EQ(wiznetHostInjectUDP(1, ip, 7000, payload, sizeof(payload)), 0);
+	wiznetSpidevResetStats();
+	wiznetHostResetStats();
+	CHECK_EQ(wiznetRecvBegin(1), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvHeaderUDP(from, &port), sizeof(payload));
+	wiznetRecvData(back, sizeof(back));
+	CHECK_EQ(wiznetRecvCommit(sizeof(back)), WIZNET_SUCCESS);
+	wiznetSpidevGetStats(&stats);
+	wiznetHostGetStats(&bus);
+	CHECK_EQ(stats.syscalls, RECV_SYSCALLS);
+	CHECK_EQ(stats.transfers, bus.transactions);
+	CHECK_EQ(port, 7000);
+	for (i = 0; i < sizeof(payload); i++)
+		CHECK_EQ(back[i], payload[i]);
+	CHECK_EQ(wiznetSpidevError(), 0);
+
+	// A read in a failed message returns zeros, not the last message's data,
+	// and the failure is latched until it is read
+	CHECK_EQ(wiznetHostInjectUDP(1, ip, 7000, payload, sizeof(payload)), 0);
+	CHECK_EQ(wiznetRecvPeek(1), sizeof(payload) + 8);
+	wiznetSpidevResetStats();
+	wiznetSpidevFailNext(1);
+	CHECK_EQ(wiznetRecvPeek(1), 0);
+	wiznetSpidevGetStats(&stats);
+	CHECK_EQ(stats.errors, 1);
+	CHECK_EQ(stats.syscalls, 0);
+	CHECK_EQ(wiznetSpidevError(), -1);
+	CHECK_EQ(wiznetSpidevError(), 0);
+	CHECK_EQ(wiznetRecvPeek(1), sizeof(payload) + 8);
+
+	wiznetSpidevClose();
+	return checkFailures;
+}
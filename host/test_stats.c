@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <string.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** WIZNET_STATS counters over a run of UDP and TCP traffic, a collision and
+** a SEND that times out: the bus figures agree with the host model's own
+** accounting, and the per-socket figures with what the run did. Built with
+** WIZNET_ADAPTIVE_BUFFERS as well, for the buffer usage kept beside them.
+*/
+
+static uint8_t data[3000];
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t ip[4] = {10, 0, 0, 2};
+	struct wiznetDatagram dgrams[2];
+	struct wiznetTransaction *tx, *other;
+	struct wiznetHostStats bus;
+	struct wiznetStats stats;
+	struct wiznetBufferStats usage;
+	uint8_t back[2][100];
+	uint32_t sockets = 0;
+	uint16_t sent, i;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = (uint8_t)i;
+	wiznetHostInit();
+	wiznetReset();
+	wiznetInit(sizes);
+	CHECK_EQ(wiznetOpenSocket(1, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetOpenSocket(2, SOCK_TCP, 5001, 0), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetConnectSocket(2, ip, 80), WIZNET_SUCCESS);
+	wiznetResetStats();
+	wiznetHostResetStats();
+
+	// Three datagrams out and two in on socket 1
+	for (i = 0; i < 3; i++) {
+		CHECK_EQ(wiznetSendToBegin(1, ip, 6000), WIZNET_SUCCESS);
+		wiznetSendData(data, 100);
+		CHECK_EQ(wiznetSendToCommit(), WIZNET_SUCCESS);
+	}
+	CHECK_EQ(wiznetHostInjectUDP(1, ip, 6000, data, 50), 0);
+	CHECK_EQ(wiznetHostInjectUDP(1, ip, 6000, data, 70), 0);
+	for (i = 0; i < 2; i++) {
+		dgrams[i].data = back[i];
+		dgrams[i].size = sizeof(back[i]);
+	}
+	CHECK_EQ(wiznetRecvBatch(1, dgrams, 2), 2);
+
+	// A stream out and some data in on socket 2
+	CHECK_EQ(wiznetSendStream(2, data, sizeof(data), &sent, 0), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetHostInjectRaw(2, data, 500), 0);
+	CHECK_EQ(wiznetRecvPeek(2), 500);
+	CHECK_EQ(wiznetRecvBegin(2), WIZNET_SUCCESS);
+	wiznetRecvData(back[0], 100);
+	CHECK_EQ(wiznetRecvCommit(0), WIZNET_SUCCESS);
+
+	// A collision and a SEND that times out on socket 1
+	CHECK_EQ(wiznetTxBegin(1, &tx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetTxBegin(1, &other), WIZNET_ERROR_SEND_COLLISION);
+	wiznetTxAbandon(tx);
+	wiznetHostFailNextSend(1);
+	CHECK_EQ(wiznetSendToBegin(1, ip, 6000), WIZNET_SUCCESS);
+	wiznetSendData(data, 40);
+	CHECK_EQ(wiznetSendToCommit(), WIZNET_ERROR_SEND_DATA);
+
+	// The bus as the model saw it, with every socket's share within it
+	wiznetGetStats(&stats);
+	wiznetHostGetStats(&bus);
+	CHECK_EQ(stats.spiTransactions, bus.transactions);
+	CHECK_EQ(stats.spiBytes, bus.bytes);
+	CHECK_EQ(stats.chipSelects, bus.chipSelects);
+	for (i = 0; i < WIZNET_MAX_SOCKETS; i++)
+		sockets += stats.sockets[i].spiTransactions;
+	CHECK(sockets <= stats.spiTransactions);
+	CHECK_EQ(stats.sockets[0].spiTransactions, 0);
+
+	// What each socket did
+	CHECK_EQ(stats.sockets[1].sends, 4);
+	CHECK_EQ(stats.sockets[1].bytesSent, 3 * 100 + 40);
+	CHECK_EQ(stats.sockets[1].sendTimeouts, 1);
+	CHECK_EQ(stats.sockets[1].collisions, 1);
+	CHECK_EQ(stats.sockets[1].datagrams, 2);
+	CHECK_EQ(stats.sockets[1].bytesReceived, 8 + 50 + 8 + 70);
+	CHECK_EQ(stats.sockets[1].rxHighWater, 8 + 50 + 8 + 70);
+	CHECK_EQ(stats.sockets[2].bytesSent, sizeof(data));
+	CHECK_EQ(stats.sockets[2].sends, 3);
+	CHECK_EQ(stats.sockets[2].bytesReceived, 100);
+	CHECK_EQ(stats.sockets[2].rxHighWater, 500);
+	CHECK_EQ(stats.sockets[2].datagrams, 0);
+	CHECK_EQ(stats.sockets[2].sendTimeouts, 0);
+
+	// The buffer usage kept for the next time each socket is opened
+	wiznetGetBufferStats(1, &usage);
+	CHECK_EQ(usage.txPeak, 100);
+	CHECK_EQ(usage.rxPeak, 8 + 50 + 8 + 70);
+	CHECK_EQ(usage.rxOverruns, 0);
+	wiznetGetBufferStats(2, &usage);
+	CHECK_EQ(usage.txPeak, 1024);
+	CHECK_EQ(usage.rxPeak, 500);
+
+	// Reset clears every counter
+	wiznetResetStats();
+	wiznetGetStats(&stats);
+	for (i = 0; i < sizeof(stats); i++)
+		CHECK_EQ(((uint8_t*)&stats)[i], 0);
+
+	return checkFailures;
+}
@@ -0,0 +1,140 @@
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** wiznetSendStream: blocking and non-blocking streams, partial writes under
+** backpressure, and the failures that must end a stream rather than leave it
+** waiting. A hang is turned into a failure by an alarm.
+*/
+
+#define SOCKET 1
+#define LENGTH 65000
+
+static uint8_t data[LENGTH];
+static uint8_t captured[LENGTH];
+static uint32_t capturedLength;
+static uint16_t largestSend;
+
+static void capture(uint8_t socket, const uint8_t* buf, uint16_t len) {
+	(void)socket;
+	if (capturedLength + len <= LENGTH)
+		memcpy(captured + capturedLength, buf, len);
+	capturedLength += len;
+	if (len > largestSend)
+		largestSend = len;
+}
+
+static void resetCapture(void) {
+	capturedLength = 0;
+	largestSend = 0;
+}
+
+static void connectSocket(void) {
+	uint8_t ip[4] = {10, 0, 0, 2};
+	wiznetOpenSocket(SOCKET, SOCK_TCP, 5000, 0);
+	CHECK_EQ(wiznetConnectSocket(SOCKET, ip, 80), WIZNET_SUCCESS);
+}
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	struct wiznetTransaction* tx;
+	uint32_t offset, i;
+	uint16_t sent;
+	int ret, partial = 0, waited = 0;
+
+	alarm(20);
+	for (i = 0; i < LENGTH; i++)
+		data[i] = (uint8_t)(i * 7);
+	wiznetHostInit();
+	wiznetHostSetSendHook(capture);
+	wiznetReset();
+	wiznetInit(sizes);
+	connectSocket();
+
+	// Blocking: everything goes out, at most half the TX memory per SEND
+	resetCapture();
+	CHECK_EQ(wiznetSendStream(SOCKET, data, LENGTH, &sent, 0), WIZNET_SUCCESS);
+	CHECK_EQ(sent, LENGTH);
+	CHECK_EQ(capturedLength, LENGTH);
+	CHECK(memcmp(captured, data, LENGTH) == 0);
+	CHECK(largestSend <= 1024);
+
+	// Non-blocking with the chip slow to finish: the caller sees partial
+	// writes and WIZNET_IN_PROGRESS until the last SEND has been issued, and
+	// data written while a SEND is in flight still makes up no more than half
+	resetCapture();
+	wiznetHostSetLatency(20);
+	offset = 0;
+	do {
+		ret = wiznetSendStream(SOCKET, data + offset, (uint16_t)(LENGTH - offset), &sent,
+				WIZNET_STREAM_NONBLOCK);
+		if (ret == WIZNET_IN_PROGRESS && sent == 0)
+			waited++;
+		if (sent != 0 && sent < LENGTH - offset)
+			partial++;
+		offset += sent;
+	} while (ret == WIZNET_IN_PROGRESS);
+	CHECK_EQ(ret, WIZNET_SUCCESS);
+	CHECK_EQ(offset, LENGTH);
+	CHECK(partial > 0);
+	CHECK(waited > 0);
+	CHECK_EQ(wiznetSendWait(SOCKET), WIZNET_SUCCESS);
+	CHECK_EQ(capturedLength, LENGTH);
+	CHECK(memcmp(captured, data, LENGTH) == 0);
+	CHECK(largestSend <= 1024);
+
+	// Data written while a SEND is in flight is not lost when the stream is
+	// left to finish with a length of 0
+	resetCapture();
+	ret = wiznetSendStream(SOCKET, data, 3000, &sent, WIZNET_STREAM_NONBLOCK);
+	CHECK_EQ(ret, WIZNET_IN_PROGRESS);
+	offset = sent;
+	while (offset < 3000)
+		if ((ret = wiznetSendStream(SOCKET, data + offset, (uint16_t)(3000 - offset), &sent,
+				WIZNET_STREAM_NONBLOCK)) >= 0)
+			offset += sent;
+	CHECK_EQ(wiznetSendStream(SOCKET, NULL, 0, &sent, 0), WIZNET_SUCCESS);
+	CHECK_EQ(capturedLength, 3000);
+	CHECK(memcmp(captured, data, 3000) == 0);
+	wiznetHostSetLatency(0);
+
+	// Another send transaction on the socket
+	wiznetTxBegin(SOCKET, &tx);
+	CHECK_EQ(wiznetSendStream(SOCKET, data, 10, &sent, 0), WIZNET_ERROR_SEND_COLLISION);
+	CHECK_EQ(sent, 0);
+	wiznetTxAbandon(tx);
+
+	// A SEND of the stream itself times out
+	wiznetHostFailNextSend(SOCKET);
+	CHECK_EQ(wiznetSendStream(SOCKET, data, 3000, &sent, 0), WIZNET_ERROR_SEND_DATA);
+	CHECK(wiznetTxBegin(SOCKET, &tx) == WIZNET_SUCCESS);
+	wiznetTxAbandon(tx);
+
+	// A SEND made before the stream holds the whole TX memory and times out
+	connectSocket();
+	wiznetHostSetLatency(30);
+	wiznetHostFailNextSend(SOCKET);
+	wiznetTxBegin(SOCKET, &tx);
+	wiznetTxData(tx, data, 2048);
+	CHECK_EQ(wiznetTxCommitAsync(tx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetSendStream(SOCKET, data, 100, &sent, 0), WIZNET_ERROR_SEND_DATA);
+	CHECK_EQ(sent, 0);
+	wiznetHostSetLatency(0);
+
+	// The socket closes: its SENDs never finish
+	connectSocket();
+	wiznetCloseSocket(SOCKET);
+	CHECK_EQ(wiznetSendStream(SOCKET, data, 3000, &sent, 0), WIZNET_ERROR_SEND_DATA);
+	connectSocket();
+	wiznetHostSetLatency(30);
+	CHECK_EQ(wiznetSendStream(SOCKET, data, 500, &sent, WIZNET_STREAM_NONBLOCK), WIZNET_IN_PROGRESS);
+	wiznetCloseSocket(SOCKET);
+	CHECK_EQ(wiznetSendStream(SOCKET, NULL, 0, &sent, 0), WIZNET_ERROR_SEND_DATA);
+	wiznetHostSetLatency(0);
+
+	return checkFailures;
+}
@@ -0,0 +1,137 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** SPI transaction trace: a WIZNET_TRACE build of the driver records its
+** traffic on the model, the trace is exported, loaded back, analysed and
+** replayed. The trace from reset is also left in TRACE_FILE for the trace
+** program to replay.
+*/
+
+#ifndef TRACE_FILE
+#define TRACE_FILE "trace.bin"
+#endif
+
+static struct wiznetTraceRecord records[WIZNET_TRACE_DEPTH];
+
+static void writeFile(void* ctx, const uint8_t* data, uint16_t length) {
+	fwrite(data, 1, length, (FILE*)ctx);
+}
+
+/* This function exports the trace and loads it back
+**
+** returns - number of records loaded
+*/
+static int exportAndLoad(FILE* file, struct wiznetTraceHeader* header) {
+	uint16_t exported;
+	int count;
+
+	rewind(file);
+	exported = wiznetTraceExport(writeFile, file);
+	fflush(file);
+	rewind(file);
+	count = wiznetHostTraceLoad(file, header, records, WIZNET_TRACE_DEPTH);
+	CHECK_EQ(count, exported);
+	return count;
+}
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t ip[4] = {10, 0, 0, 2};
+	uint8_t payload[300] = {0};
+	struct wiznetTraceHeader header;
+	struct wiznetHostTraceReport report;
+	struct wiznetHostStats stats, replayed;
+	uint32_t siteTotal = 0;
+	uint16_t sent, i;
+	FILE* file;
+	int count;
+
+	// Trace everything from reset
+	wiznetHostInit();
+	wiznetTraceReset();
+	wiznetReset();
+	wiznetInit(sizes);
+	wiznetOpenSocket(1, SOCK_UDP, 5000, 0);
+	for (i = 0; i < 3; i++) {
+		wiznetSendToBegin(1, ip, 6000);
+		wiznetSendData(payload, 200);
+		wiznetSendToCommit();
+	}
+	wiznetOpenSocket(2, SOCK_TCP, 5001, 0);
+	wiznetConnectSocket(2, ip, 80);
+	wiznetSendStream(2, payload, sizeof(payload), &sent, 0);
+	wiznetHostGetStats(&stats);
+
+	file = fopen(TRACE_FILE, "w+b");
+	CHECK(file != NULL);
+	if (file == NULL)
+		return checkFailures;
+	count = exportAndLoad(file, &header);
+	fclose(file);
+	CHECK_EQ(count, stats.transactions);
+	CHECK_EQ(header.dropped, 0);
+	CHECK(header.tickNs != 0);
+	CHECK(header.flags & WIZNET_TRACE_FLAG_HASH);
+
+	// The analysis accounts for every transaction and byte on the bus
+	wiznetHostTraceAnalyse(&header, records, count, &report);
+	CHECK_EQ(report.transactions, count);
+	CHECK_EQ(report.readTransactions + report.writeTransactions, count);
+	CHECK_EQ(report.bytes, stats.bytes);
+	CHECK(report.siteCount > 0);
+	for (i = 0; i < report.siteCount && i < WIZNET_HOST_TRACE_SITES; i++) {
+		siteTotal += report.sites[i].transactions;
+		if (i > 0)
+			CHECK(report.sites[i].transactions <= report.sites[i - 1].transactions);
+	}
+	CHECK(siteTotal <= (uint32_t)count);
+	if (report.siteCount <= WIZNET_HOST_TRACE_SITES)
+		CHECK_EQ(siteTotal, count);
+	CHECK(report.busyNs > 0);
+
+	// Replayed against a fresh model, every register read matches
+	wiznetHostInit();
+	CHECK_EQ(wiznetHostTraceReplay(records, count), 0);
+	wiznetHostGetStats(&replayed);
+	CHECK_EQ(replayed.transactions, stats.transactions);
+	CHECK_EQ(replayed.bytes, stats.bytes);
+
+	// and a register read that did not happen as recorded is found
+	for (i = 0; i < count; i++)
+		if (!(records[i].control & 0x04) && (records[i].control >> 3) % 4 != 2
+				&& (records[i].control >> 3) % 4 != 3 && records[i].length != 0)
+			break;
+	CHECK(i < count);
+	records[i].data[0] ^= 0xFF;
+	wiznetHostInit();
+	CHECK_EQ(wiznetHostTraceReplay(records, count), 1);
+
+	// A register polled without change shows up as redundant reads
+	file = tmpfile();
+	CHECK(file != NULL);
+	if (file == NULL)
+		return checkFailures;
+	wiznetTraceReset();
+	for (i = 0; i < 10; i++)
+		wiznetRecvPeek(1);
+	count = exportAndLoad(file, &header);
+	wiznetHostTraceAnalyse(&header, records, count, &report);
+	CHECK(report.redundantReads >= 9);
+	CHECK_EQ(report.sites[0].redundantReads, report.redundantReads);
+
+	// Past the depth of the ring the oldest records are dropped
+	wiznetTraceReset();
+	for (i = 0; i < WIZNET_TRACE_DEPTH + 10; i++)
+		wiznetGetSocketInts();
+	count = exportAndLoad(file, &header);
+	CHECK_EQ(count, WIZNET_TRACE_DEPTH);
+	CHECK_EQ(header.dropped, 10);
+	fclose(file);
+
+	return checkFailures;
+}
@@ -0,0 +1,115 @@
+#include <stdint.h>
+#include <string.h>
+#include "wiznet.h"
+#include "wiznet_host.h"
+#include "check.h"
+
+/*
+** Chunked receive: wiznetRxVisit hands a datagram over in chunks within one
+** SPI transaction, bytes the visitor skips and data skipped with a NULL
+** buffer are never clocked, and a visitor can stop early
+*/
+
+struct visit {
+	uint8_t data[256];
+	uint16_t length;
+	uint16_t chunks;
+	uint16_t largest;
+	int skipAfterFirst;     //Returned after the first chunk
+	int stopAfter;          //Chunks before returning WIZNET_VISIT_STOP, 0 for never
+};
+
+static int collect(void* ctx, const uint8_t* data, uint16_t length) {
+	struct visit* v = ctx;
+
+	memcpy(v->data + v->length, data, length);
+	v->length += length;
+	v->chunks++;
+	if (length > v->largest)
+		v->largest = length;
+	if (v->stopAfter && v->chunks == v->stopAfter)
+		return WIZNET_VISIT_STOP;
+	return (v->chunks == 1) ? v->skipAfterFirst : 0;
+}
+
+/* This function returns the bus traffic since it was last called
+*/
+static struct wiznetHostStats traffic(void) {
+	struct wiznetHostStats stats;
+
+	wiznetHostGetStats(&stats);
+	wiznetHostResetStats();
+	return stats;
+}
+
+int main(void) {
+	uint8_t sizes[8] = {2, 2, 2, 2, 2, 2, 2, 2};
+	uint8_t ip[4] = {10, 0, 0, 2}, from[4];
+	uint8_t payload[100], back[100];
+	struct wiznetTransaction* rx;
+	struct wiznetHostStats stats;
+	struct visit v;
+	uint16_t port, i;
+
+	for (i = 0; i < sizeof(payload); i++)
+		payload[i] = (uint8_t)(i + 1);
+	wiznetHostInit();
+	wiznetReset();
+	wiznetInit(sizes);
+	CHECK_EQ(wiznetOpenSocket(1, SOCK_UDP, 5000, 0), WIZNET_SUCCESS);
+	for (i = 0; i < 4; i++)
+		CHECK_EQ(wiznetHostInjectUDP(1, ip, 7000, payload, sizeof(payload)), 0);
+
+	// The whole datagram, in chunks of at most WIZNET_VISIT_CHUNK, over one
+	// transaction
+	memset(&v, 0, sizeof(v));
+	CHECK_EQ(wiznetRxBegin(1, &rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxHeaderUDP(rx, from, &port), sizeof(payload));
+	traffic();
+	CHECK_EQ(wiznetRxVisit(rx, sizeof(payload), collect, &v), WIZNET_SUCCESS);
+	stats = traffic();
+	CHECK_EQ(stats.transactions, 1);
+	CHECK_EQ(stats.readBytes, sizeof(payload));
+	CHECK_EQ(v.length, sizeof(payload));
+	CHECK_EQ(v.largest, WIZNET_VISIT_CHUNK);
+	CHECK_EQ(v.chunks, (sizeof(payload) + WIZNET_VISIT_CHUNK - 1) / WIZNET_VISIT_CHUNK);
+	CHECK(memcmp(v.data, payload, sizeof(payload)) == 0);
+	CHECK_EQ(wiznetRxCommit(rx, sizeof(payload)), WIZNET_SUCCESS);
+
+	// Bytes the visitor skips are stepped over in a new transaction
+	memset(&v, 0, sizeof(v));
+	v.skipAfterFirst = 40;
+	CHECK_EQ(wiznetRxBegin(1, &rx), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRxHeaderUDP(rx, from, &port), sizeof(payload));
+	traffic();
+	CHECK_EQ(wiznetRxVisit(rx, sizeof(payload), collect, &v), WIZNET_SUCCESS);
+	stats = traffic();
+	CHECK_EQ(stats.transactions, 2);
+	CHECK_EQ(stats.readBytes, sizeof(payload) - 40);
+	CHECK_EQ(v.length, sizeof(payload) - 40);
+	CHECK(memcmp(v.data, payload, WIZNET_VISIT_CHUNK) == 0);
+	CHECK(memcmp(v.data + WIZNET_VISIT_CHUNK, payload + WIZNET_VISIT_CHUNK + 40,
+			sizeof(payload) - WIZNET_VISIT_CHUNK - 40) == 0);
+	CHECK_EQ(wiznetRxCommit(rx, sizeof(payload)), WIZNET_SUCCESS);
+
+	// A visitor that stops leaves the cursor after the last chunk it saw, and
+	// data skipped with a NULL buffer costs nothing
+	memset(&v, 0, sizeof(v));
+	v.stopAfter = 2;
+	CHECK_EQ(wiznetRecvBegin(1), WIZNET_SUCCESS);
+	CHECK_EQ(wiznetRecvHeaderUDP(from, &port), sizeof(payload));
+	CHECK_EQ(wiznetRecvVisit(sizeof(payload), collect, &v), WIZNET_VISIT_STOP);
+	CHECK_EQ(v.length, 2 * WIZNET_VISIT_CHUNK);
+	traffic();
+	wiznetRecvData(NULL, 10);
+	CHECK_EQ(traffic().transactions, 0);
+	wiznetRecvData(back, sizeof(payload) - 2 * WIZNET_VISIT_CHUNK - 10);
+	CHECK(memcmp(back, payload + 2 * WIZNET_VISIT_CHUNK + 10, sizeof(payload) - 2 * WIZNET_VISIT_CHUNK - 10) == 0);
+	CHECK_EQ(wiznetRecvCommit(sizeof(payload)), WIZNET_SUCCESS);
+
+	// The last datagram is still waiting
+	CHECK_EQ(wiznetRecvPeek(1), sizeof(payload) + 8);
+	CHECK_EQ(wiznetRecvVisit(10, collect, &v), WIZNET_ERROR_NOT_RECVING);
+
+	return checkFailures;
+}
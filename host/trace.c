@@ -0,0 +1,59 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "wiznet_host.h"
+
+/*
+** Trace analysis
+**
+** Reads a trace written by wiznetTraceExport, on the host or on a target,
+** and prints its analysis: bus use, the busiest call sites and redundant
+** register reads. With -r the trace is also replayed against a freshly
+** reset model, which only matches for a trace taken from reset; the run
+** then fails if any register read differs from the trace.
+**
+**   build/trace [-r] trace.bin
+**
+************************************/
+
+#define MAX_RECORDS 65536
+
+static struct wiznetTraceRecord records[MAX_RECORDS];
+
+int main(int argc, char** argv) {
+	struct wiznetTraceHeader header;
+	struct wiznetHostTraceReport report;
+	uint32_t mismatches;
+	int replay = 0, count;
+	FILE* in;
+
+	if (argc > 1 && strcmp(argv[1], "-r") == 0) {
+		replay = 1;
+		argc--;
+		argv++;
+	}
+	if (argc != 2) {
+		fprintf(stderr, "usage: trace [-r] trace.bin\n");
+		return 2;
+	}
+	if ((in = fopen(argv[1], "rb")) == NULL) {
+		perror(argv[1]);
+		return 2;
+	}
+	count = wiznetHostTraceLoad(in, &header, records, MAX_RECORDS);
+	fclose(in);
+	if (count < 0) {
+		fprintf(stderr, "%s: not a trace this build can read\n", argv[1]);
+		return 2;
+	}
+
+	wiznetHostTraceAnalyse(&header, records, count, &report);
+	wiznetHostTracePrint(&header, &report, stdout);
+	if (!replay)
+		return 0;
+
+	wiznetHostInit();
+	mismatches = wiznetHostTraceReplay(records, count);
+	printf("replayed %d transactions, %lu register reads differed\n", count, (unsigned long)mismatches);
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,11 @@
+#ifndef UTIL_H
+#define UTIL_H
+
+/*
+** Stand-in for the util.h a project provides, for the host-model builds
+*/
+
+#define BYTE0(x) ((uint8_t)((x) & 0xFF))
+#define BYTE1(x) ((uint8_t)(((x) >> 8) & 0xFF))
+
+#endif
@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <string.h>
 #include "util.h"
 #include "io_assignment.h"
 #include "wiznet_arch.h"
@@ -6,7 +7,9 @@
 #include "wiznet_io.h"
 #include "wiznet_regs.h"
 
+#ifndef NULL
 #define NULL ((void*)0)
+#endif
 
 /* Globals for keeping track of the wiznet transmit and receive buffers
 */
@@ -14,12 +17,49 @@ uint16_t wiznetTXMemSize[WIZNET_MAX_SOCKETS];
 uint16_t wiznetTXMemBase[WIZNET_MAX_SOCKETS];
 uint16_t wiznetRXMemSize[WIZNET_MAX_SOCKETS];
 uint16_t wiznetRXMemBase[WIZNET_MAX_SOCKETS];
+#ifdef WIZNET_ADAPTIVE_BUFFERS
+struct wiznetBufferStats wiznetBufferUsage[WIZNET_MAX_SOCKETS];
+uint8_t wiznetBufferHistory;    //Sockets opened since the sizes were set
+#endif
 
-/* Globals for the buffer streaming protocol
+/* Globals for the buffer streaming protocol. Each socket has its own send
+** and receive transaction; the global API works on the one it was begun on.
 */
-uint16_t wiznetBufferWriteCur ,wiznetBufferReadCur;
+struct wiznetTransaction wiznetSendTransactions[WIZNET_MAX_SOCKETS];
+struct wiznetTransaction wiznetRecvTransactions[WIZNET_MAX_SOCKETS];
 int wiznetBufferWriteSocket, wiznetBufferReadSocket;
 
+/* Globals for sends that have been committed without waiting for completion
+*/
+uint8_t wiznetSendPending;
+uint8_t wiznetStreamPending;    //Sockets whose send transaction belongs to wiznetSendStream
+int8_t wiznetSendResult[WIZNET_MAX_SOCKETS];
+wiznetSendHandler wiznetSendCompleteHandler;
+
+/* Globals for socket set-up (open, connect, listen) in progress
+*/
+enum {
+	WIZNET_SETUP_IDLE = 0,
+	WIZNET_SETUP_OPENING,
+	WIZNET_SETUP_CONNECTING,
+	WIZNET_SETUP_LISTENING
+};
+
+struct wiznetSocketSetup {
+	uint8_t state;
+	uint8_t expect;
+	int8_t result;
+};
+struct wiznetSocketSetup wiznetSocketSetups[WIZNET_MAX_SOCKETS];
+
+/* Globals for the framing chosen on each socket
+*/
+uint8_t wiznetSocketFraming[WIZNET_MAX_SOCKETS];
+
+/* Globals for the event dispatcher, one handler per socket per Sn_IR flag
+*/
+wiznetEventHandler wiznetEventHandlers[WIZNET_MAX_SOCKETS][WIZNET_EVENT_COUNT];
+
 
 
 /* This function resets the wiznet chip and waits until it is stable
@@ -27,16 +67,28 @@ int wiznetBufferWriteSocket, wiznetBufferReadSocket;
 void wiznetReset(void) {
 	wiznetSetMode(MR_RESET);
 	while(wiznetGetMode()&MR_RESET);
+#ifdef WIZNET_SHADOW_REGISTERS
+	wiznetShadowResync();
+#endif
 }
 
 /* This function initializes the wiznet chip (Mode, Memory and Interrupts)
 **
 ** bufSize - an array of sizes, in kilobytes, for each socket's in/output
 **           buffers.
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_BUFFER_SIZE if the sizes are not valid, see
+**           wiznetInitBufferSizes; the chip is left untouched
 */
-void wiznetInit(uint8_t bufSize[]) {
+int wiznetInit(uint8_t bufSize[]) {
+	int ret;
+#ifdef WIZNET_SHADOW_REGISTERS
+	wiznetShadowResync();
+#endif
 	//Set-up the buffer and interrupt time
-	wiznetInitBufferSizes(bufSize, bufSize);
+	if ((ret = wiznetInitBufferSizes(bufSize, bufSize)) != WIZNET_SUCCESS)
+		return ret;
 	wiznetSetInterruptAssertWaitTime(4);
 
 	// Default values for the retry counts and times
@@ -45,32 +97,254 @@ void wiznetInit(uint8_t bufSize[]) {
 #ifdef WIZNET_INTERRUPTS_ENABLED
 	wiznetSetInterruptMask(IR_CONFLICT);
 #endif 
+	wiznetIOFlush();
+	return WIZNET_SUCCESS;
+}
+
+/* This function checks one direction of a buffer allocation. Each size must
+** be 0, 1, 2, 4, 8 or 16 kilobytes, and together they must fit in the 16KB
+** of memory the chip has for that direction.
+*/
+static int wiznetCheckBufferSizes(const uint8_t* sizes) {
+	uint8_t i, total = 0;
+	for (i = 0; i < WIZNET_MAX_SOCKETS; i++) {
+		if (sizes[i] > (WIZNET_MAX_BUFFER_SIZE >> 10) || (sizes[i] & (sizes[i] - 1)))
+			return WIZNET_ERROR_BUFFER_SIZE;
+		total += sizes[i];
+	}
+	if (total > (WIZNET_MAX_BUFFER_SIZE >> 10))
+		return WIZNET_ERROR_BUFFER_SIZE;
+	return WIZNET_SUCCESS;
+}
+
+/* This function fills in where each socket's buffers lie in the chip's
+** memory. The chip allocates them in socket order.
+*/
+static void wiznetLayoutBuffers(void) {
+	uint16_t rx = 0, tx = 0;
+	uint8_t i;
+	for (i = 0; i < WIZNET_MAX_SOCKETS; i++) {
+		wiznetRXMemBase[i] = rx;
+		wiznetTXMemBase[i] = tx;
+		rx += wiznetRXMemSize[i];
+		tx += wiznetTXMemSize[i];
+	}
 }
 
 /* This function sets the allocation of buffer memory in the wiznet.
 **
 ** rx - array of sizes, in kilobytes, for the read buffers
 ** tx - array of sizes, in kilobytes, for the writes buffers
-** TODO Proper checking that memory request is rational
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_BUFFER_SIZE if a size is not a power of two up to
+**           16, or the sizes in either direction add up to more than 16
+**
+** This and wiznetInit used to return nothing and write any sizes to the
+** chip. Callers that ignore the result still build, but a bad allocation
+** now leaves the chip as it was, so the result should be checked.
 */
-void wiznetInitBufferSizes(uint8_t* rx, uint8_t* tx) {
+int wiznetInitBufferSizes(uint8_t* rx, uint8_t* tx) {
 	int i;
 
-	// Initialize pointers to the current positions
-	// of the buffers.
+	if (wiznetCheckBufferSizes(rx) != WIZNET_SUCCESS || wiznetCheckBufferSizes(tx) != WIZNET_SUCCESS)
+		return WIZNET_ERROR_BUFFER_SIZE;
+
+	// Initialize the transactions on each socket.
 	// Only one read and one write buffer can be active at
-	// a time.
-	wiznetBufferWriteCur = 0;
+	// a time through the global API.
 	wiznetBufferWriteSocket = -1;
-	wiznetBufferReadCur = 0;
 	wiznetBufferReadSocket = -1;
+	wiznetSendPending = 0;
+	wiznetStreamPending = 0;
 
 	// Send the set-up commands for each of the buffer
 	// sizes.
 	for (i = 0 ; i < WIZNET_MAX_SOCKETS; i++) {
+		wiznetSendTransactions[i].socket = i;
+		wiznetSendTransactions[i].active = 0;
+		wiznetRecvTransactions[i].socket = i;
+		wiznetRecvTransactions[i].active = 0;
 		wiznetSetSocketRXBufferSize(i, rx[i]);
 		wiznetSetSocketTXBufferSize(i, tx[i]);
+		wiznetRXMemSize[i] = (uint16_t)rx[i] << 10;
+		wiznetTXMemSize[i] = (uint16_t)tx[i] << 10;
+#ifdef WIZNET_ADAPTIVE_BUFFERS
+		memset(&wiznetBufferUsage[i], 0, sizeof(wiznetBufferUsage[i]));
+#endif
+	}
+#ifdef WIZNET_ADAPTIVE_BUFFERS
+	wiznetBufferHistory = 0;
+#endif
+	wiznetLayoutBuffers();
+	wiznetIOFlush();
+	return WIZNET_SUCCESS;
+}
+
+/* This function records how full a socket's RX buffer was found. A full
+** buffer counts as an overrun, as the chip has had to refuse data.
+*/
+static void wiznetNoteRXUsage(uint8_t socket, uint16_t used) {
+#ifdef WIZNET_STATS
+	if (used > wiznetStatCounters.sockets[socket].rxHighWater)
+		wiznetStatCounters.sockets[socket].rxHighWater = used;
+#endif
+#ifdef WIZNET_ADAPTIVE_BUFFERS
+	struct wiznetBufferStats* st = &wiznetBufferUsage[socket];
+	if (used > st->rxPeak)
+		st->rxPeak = used;
+	if (used >= wiznetRXMemSize[socket] && st->rxOverruns < 0xFFFF)
+		st->rxOverruns++;
+#endif
+	(void)socket;
+	(void)used;
+}
+
+/* This function records how much a socket queued for one SEND, and whether
+** the sender had to wait for TX space.
+*/
+static void wiznetNoteTXUsage(uint8_t socket, uint16_t used, uint8_t stalled) {
+#ifdef WIZNET_ADAPTIVE_BUFFERS
+	struct wiznetBufferStats* st = &wiznetBufferUsage[socket];
+	if (used > st->txPeak)
+		st->txPeak = used;
+	if (stalled && st->txStalls < 0xFFFF)
+		st->txStalls++;
+#else
+	(void)socket;
+	(void)used;
+	(void)stalled;
+#endif
+}
+
+#ifdef WIZNET_ADAPTIVE_BUFFERS
+/* This function picks the next size of one of a socket's buffers from its
+** use since it was last opened: double it if it overran or stalled, halve it
+** if it never got a quarter full. The result is the largest power of two no
+** bigger than that and max, which must be at least 1KB.
+*/
+static uint8_t wiznetAdaptBufferSize(uint8_t size, uint16_t peak, uint16_t pressure, uint8_t max) {
+	uint8_t next = size ? size : 1;
+	if (pressure)
+		next <<= 1;
+	else if (next > 1 && peak < ((uint16_t)size << 8))
+		next >>= 1;
+	while (next > max)
+		next >>= 1;
+	return next;
+}
+
+/* This function counts the sockets after a given one that have a buffer,
+** each of which needs at least 1KB left for it
+*/
+static uint8_t wiznetBufferReserve(const uint8_t* sizes, uint8_t socket) {
+	uint8_t i, reserve = 0;
+	for (i = socket + 1; i < WIZNET_MAX_SOCKETS; i++)
+		if (sizes[i])
+			reserve++;
+	return reserve;
+}
+
+/* This function halves one of a socket's buffer sizes, no lower than 1KB,
+** until it leaves 1KB for each higher socket that has a buffer
+*/
+static uint8_t wiznetFitBufferSize(const uint8_t* sizes, uint8_t socket, uint8_t free) {
+	uint8_t size = sizes[socket], reserve = wiznetBufferReserve(sizes, socket);
+	while (size > 1 && size + reserve > free)
+		size >>= 1;
+	return size;
+}
+
+/* This function re-sizes the buffers of a socket about to be opened. The chip
+** lays the buffers out in socket order, so changing one moves those of every
+** higher socket; this is only done when all of them are closed. Each higher
+** socket that has a buffer keeps at least 1KB of it, and any of them that no
+** longer fit are shrunk. The first time a socket is opened it keeps the
+** sizes given to wiznetInitBufferSizes, as there is no use to go on yet, and
+** if the lower sockets leave too little memory for it to have 1KB besides
+** those, the sizes are left as they are.
+*/
+static void wiznetRebalanceBuffers(uint8_t socket) {
+	struct wiznetBufferStats* st = &wiznetBufferUsage[socket];
+	uint8_t rxSize[WIZNET_MAX_SOCKETS], txSize[WIZNET_MAX_SOCKETS];
+	uint8_t i, rxUsed = 0, txUsed = 0, rxReserve, txReserve, rxFree, txFree;
+
+	if (!(wiznetBufferHistory & (1 << socket))) {
+		wiznetBufferHistory |= 1 << socket;
+		memset(st, 0, sizeof(*st));
+		return;
+	}
+
+	for (i = socket + 1; i < WIZNET_MAX_SOCKETS; i++)
+		if (wiznetGetSocketStatus(i) != Sn_SR_CLOSED)
+			return;
+
+	for (i = 0; i < WIZNET_MAX_SOCKETS; i++) {
+		rxSize[i] = wiznetRXMemSize[i] >> 10;
+		txSize[i] = wiznetTXMemSize[i] >> 10;
+		if (i < socket) {
+			rxUsed += rxSize[i];
+			txUsed += txSize[i];
+		}
+	}
+	rxFree = (WIZNET_MAX_BUFFER_SIZE >> 10) - rxUsed;
+	txFree = (WIZNET_MAX_BUFFER_SIZE >> 10) - txUsed;
+	rxReserve = wiznetBufferReserve(rxSize, socket);
+	txReserve = wiznetBufferReserve(txSize, socket);
+	if (rxFree <= rxReserve || txFree <= txReserve) {
+		memset(st, 0, sizeof(*st));
+		return;
+	}
+	rxSize[socket] = wiznetAdaptBufferSize(rxSize[socket], st->rxPeak, st->rxOverruns, rxFree - rxReserve);
+	txSize[socket] = wiznetAdaptBufferSize(txSize[socket], st->txPeak, st->txStalls, txFree - txReserve);
+	memset(st, 0, sizeof(*st));
+
+	for (i = socket; i < WIZNET_MAX_SOCKETS; i++) {
+		rxSize[i] = wiznetFitBufferSize(rxSize, i, (WIZNET_MAX_BUFFER_SIZE >> 10) - rxUsed);
+		txSize[i] = wiznetFitBufferSize(txSize, i, (WIZNET_MAX_BUFFER_SIZE >> 10) - txUsed);
+		rxUsed += rxSize[i];
+		txUsed += txSize[i];
+		wiznetSetSocketRXBufferSize(i, rxSize[i]);
+		wiznetSetSocketTXBufferSize(i, txSize[i]);
+		wiznetRXMemSize[i] = (uint16_t)rxSize[i] << 10;
+		wiznetTXMemSize[i] = (uint16_t)txSize[i] << 10;
 	}
+	wiznetLayoutBuffers();
+}
+
+/* This function copies out the buffer usage recorded for a socket since it
+** was last opened
+**
+** socket - the socket number
+** stats  - filled in with the usage
+*/
+void wiznetGetBufferStats(uint8_t socket, struct wiznetBufferStats* stats) {
+	*stats = wiznetBufferUsage[socket];
+}
+#endif
+
+#ifdef WIZNET_STATS
+/* This function takes a snapshot of the driver counters
+**
+** stats - filled in with the counters
+*/
+void wiznetGetStats(struct wiznetStats* stats) {
+	*stats = wiznetStatCounters;
+}
+
+/* This function clears the driver counters
+*/
+void wiznetResetStats(void) {
+	memset(&wiznetStatCounters, 0, sizeof(wiznetStatCounters));
+}
+#endif
+
+/* This function counts a collision error on a socket and passes it on
+*/
+static int wiznetCollision(uint8_t socket, int error) {
+	wiznetSocketStatInc(socket, collisions);
+	(void)socket;
+	return error;
 }
 
 /* This function enables interrupts on a given socket
@@ -80,6 +354,7 @@ void wiznetInitBufferSizes(uint8_t* rx, uint8_t* tx) {
 */
 void wiznetSocketEnableInterrupts(uint8_t socket) {
 	wiznetSetInterruptsOnSocketsMask(wiznetGetInterruptsOnSocketsMask() | (1<<socket));
+	wiznetIOFlush();
 }
 
 /* This function disables interrupts on a given socket
@@ -89,6 +364,7 @@ void wiznetSocketEnableInterrupts(uint8_t socket) {
 */
 void wiznetSocketDisableInterrupts(uint8_t socket) {
 	wiznetSetInterruptsOnSocketsMask(wiznetGetInterruptsOnSocketsMask() & ~(1<<socket));
+	wiznetIOFlush();
 }
 
 /* This function checks which sockets are displaying that they
@@ -108,6 +384,7 @@ uint8_t wiznetGetSocketInts(void) {
 */
 void wiznetClearSocketRecvInt(uint8_t socket) {
 	wiznetSetSocketInterrupt(socket, Sn_IR_RECEIVE);
+	wiznetIOFlush();
 }
 
 /* This function gets the interrupt register for
@@ -133,6 +410,98 @@ uint8_t wiznetGetDeviceInts(void){
 
 void wiznetClearDeviceInts(void){
 	wiznetSetInterrupts(wiznetGetInterrupts());
+	wiznetIOFlush();
+}
+
+/* This function records the result of the send in flight on a socket
+*/
+static int wiznetSendFinish(uint8_t socket, int result) {
+	wiznetSendPending &= ~(1 << socket);
+	wiznetSendResult[socket] = result;
+	return result;
+}
+
+/* This function works out the Sn_IMR of a socket. SIR only flags a socket
+** for the events unmasked there, so besides the events the driver always
+** waits on, those with a handler are unmasked for wiznetDispatchEvents, and
+** SEND_OK if sends are to be completed through it.
+**
+** socket - socket number
+**
+** returns - the mask
+*/
+static uint8_t wiznetSocketInterruptMask(uint8_t socket) {
+	uint8_t mask = Sn_IR_RECEIVE | Sn_IR_DISCONNECT | Sn_IR_TIMEOUT;
+	uint8_t i;
+
+	for (i = 0; i < WIZNET_EVENT_COUNT; i++)
+		if (wiznetEventHandlers[socket][i] != NULL)
+			mask |= 1 << i;
+	if (wiznetSendCompleteHandler != NULL)
+		mask |= Sn_IR_SEND_OK;
+	return mask;
+}
+
+/* This function registers the handler called by wiznetDispatchEvents for
+** one or more events on a socket, and updates Sn_IMR to match
+**
+** socket  - socket number
+** events  - Sn_IR flags (Sn_IR_CONNECT, Sn_IR_DISCONNECT, Sn_IR_RECEIVE,
+**           Sn_IR_TIMEOUT, Sn_IR_SEND_OK) the handler is for
+** handler - function to call, or NULL to remove the handler
+*/
+void wiznetSetEventHandler(uint8_t socket, uint8_t events, wiznetEventHandler handler) {
+	uint8_t i;
+	for (i = 0; i < WIZNET_EVENT_COUNT; i++)
+		if (events & (1 << i))
+			wiznetEventHandlers[socket][i] = handler;
+	wiznetSetSocketInterruptMask(socket, wiznetSocketInterruptMask(socket));
+	wiznetIOFlush();
+}
+
+/* This function services every pending socket interrupt. SIR is read once,
+** then each flagged socket has its Sn_IR read and acknowledged before the
+** registered handlers are called, so a flag raised again while a handler
+** runs (e.g. RECEIVE with data remaining) is not lost. Servicing n sockets
+** costs 1 + 2n SPI transactions.
+** A send started with one of the *Async commits is completed here when its
+** SEND_OK or TIMEOUT arrives, and a TIMEOUT on a socket still being set up is
+** left for wiznetSocketPoll.
+**
+** returns - bitmask of the sockets that were serviced
+*/
+uint8_t wiznetDispatchEvents(void) {
+	uint8_t sockets, socket, ir, i;
+	wiznetEventHandler handler;
+
+	sockets = wiznetGetInterruptsOnSockets();
+	for (socket = 0; socket < WIZNET_MAX_SOCKETS; socket++) {
+		if (!(sockets & (1 << socket)))
+			continue;
+
+		ir = wiznetGetSocketInterrupt(socket);
+		if (wiznetSocketSetups[socket].state != WIZNET_SETUP_IDLE)
+			ir &= ~Sn_IR_TIMEOUT;
+		if (ir == 0)
+			continue;
+		wiznetSetSocketInterrupt(socket, ir);
+		wiznetIOFlush();
+
+		if ((wiznetSendPending & (1 << socket)) && (ir & (Sn_IR_SEND_OK | Sn_IR_TIMEOUT))) {
+			if (!(ir & Sn_IR_SEND_OK))
+				wiznetSocketStatInc(socket, sendTimeouts);
+			wiznetSendFinish(socket, (ir & Sn_IR_SEND_OK) ? WIZNET_SUCCESS : WIZNET_ERROR_SEND_DATA);
+			if (wiznetSendCompleteHandler != NULL)
+				wiznetSendCompleteHandler(socket, wiznetSendResult[socket]);
+		}
+
+		for (i = 0; i < WIZNET_EVENT_COUNT; i++) {
+			handler = wiznetEventHandlers[socket][i];
+			if ((ir & (1 << i)) && handler != NULL)
+				handler(socket, 1 << i);
+		}
+	}
+	return sockets;
 }
 
 /* This function sets up the IP communication layer for the wiznet device
@@ -145,6 +514,7 @@ void wiznetConfigureIPLayer(uint8_t* gip, uint8_t* snm, uint8_t* sip) {
 	wiznetSetGatewayIP(gip);
 	wiznetSetSubnetMask(snm);
 	wiznetSetSourceIP(sip);
+	wiznetIOFlush();
 }
 
 /* This function retrieves the currently set MAC address
@@ -164,20 +534,79 @@ void wiznetGetDeviceMAC(uint8_t* MAC) {
 */
 void wiznetSetDeviceMAC(uint8_t* MAC) {
 	wiznetSetSourceMAC(MAC);
+	wiznetIOFlush();
 }
 
 
 /* This function initialize the channel in a particular mode, sets the port and opens the socket.
+** It blocks until the socket is open; wiznetOpenSocketStart is the non-blocking form.
 **
 ** socket   - the socket number (0-7)
 ** protocol - the socket protocol
 ** port     - the source port for the socket
 ** flag     - the option for the socket
 ** 
-** returns 1 for sucess else 0.
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
 */
 int wiznetOpenSocket(uint8_t socket, uint8_t protocol, uint16_t port, uint8_t flags) {
-	uint8_t status;
+	int ret = wiznetOpenSocketStart(socket, protocol, port, flags);
+	while (ret == WIZNET_IN_PROGRESS) {
+		wiznetSocketStatInc(socket, waitLoops);
+		ret = wiznetSocketPoll(socket);
+	}
+	return ret;
+}
+
+/* This function connects a TCP socket to the desired DIPR and DPORT
+** It blocks until the connection is made; wiznetConnectSocketStart is the
+** non-blocking form.
+**
+** socket - the socket number (0-7)
+** destIP - the destination IP to connect to
+** destPort - the destination port to connect to
+**
+** returns - WIZNET_SUCCESS if succesful
+**           WIZNET_ERROR_SOCKET_TIMEOUT if there is a timeout on connection attempt
+**           WIZNET_ERROR_SOCKET_OPEN if the socket failed for some other reason
+*/
+int wiznetConnectSocket(uint8_t socket, uint8_t* destIP, uint16_t destPort) {
+	int ret = wiznetConnectSocketStart(socket, destIP, destPort);
+	while (ret == WIZNET_IN_PROGRESS) {
+		wiznetSocketStatInc(socket, waitLoops);
+		ret = wiznetSocketPoll(socket);
+	}
+	return ret;
+}
+
+/* This function sets a TCP socket to listen mode.
+** It blocks until the socket is listening; wiznetListenOnSocketStart is the
+** non-blocking form.
+**
+** socket - the socket number (0-7)
+*/
+int wiznetListenOnSocket(uint8_t socket) {
+	int ret = wiznetListenOnSocketStart(socket);
+	while (ret == WIZNET_IN_PROGRESS) {
+		wiznetSocketStatInc(socket, waitLoops);
+		ret = wiznetSocketPoll(socket);
+	}
+	return ret;
+}
+
+/* This function starts opening a socket in a particular mode and returns as
+** soon as the OPEN command has been issued. The socket is then driven to
+** completion with wiznetSocketPoll.
+**
+** socket   - the socket number (0-7)
+** protocol - the socket protocol
+** port     - the source port for the socket
+** flag     - the option for the socket
+**
+** returns - WIZNET_IN_PROGRESS if the socket is opening
+**         - WIZNET_ERROR_UNKNOWN_PROTOCOL if the protocol is not supported
+*/
+int wiznetOpenSocketStart(uint8_t socket, uint8_t protocol, uint16_t port, uint8_t flags) {
+	struct wiznetSocketSetup* setup = &wiznetSocketSetups[socket];
 
 	// Convert the provided socket protocol to the required flag on the wiznet
 	switch (protocol) {
@@ -191,69 +620,57 @@ int wiznetOpenSocket(uint8_t socket, uint8_t protocol, uint16_t port, uint8_t fl
 		break;
 	}
 
-	if ((protocol == Sn_MR_TCP) || (protocol == Sn_MR_UDP) || (protocol == Sn_MR_MACRAW)) {
-		// Close socket if it's open
-		if (wiznetGetSocketStatus(socket)!=Sn_SR_CLOSED)
-			wiznetCloseSocket(socket);
-
-		// Set socket mode
-		wiznetSetSocketMode(socket, protocol | flags);
+	// Check that the socket is set-up to show the correct status code, as
+	// sent over, once opened.
+	switch (protocol) {
+	case Sn_MR_UDP:
+		setup->expect = Sn_SR_UDP;
+		break;
+	case Sn_MR_TCP:
+		setup->expect = Sn_SR_INIT;
+		break;
+	case Sn_MR_MACRAW:
+		setup->expect = Sn_SR_MACRAW;
+		break;
+	default:
+		return WIZNET_ERROR_UNKNOWN_PROTOCOL;
+	}
 
-		// Set port number
-		wiznetSetSocketSourcePort(socket, port);
+	// Close socket if it's open
+	if (wiznetGetSocketStatus(socket)!=Sn_SR_CLOSED)
+		wiznetCloseSocket(socket);
+#ifdef WIZNET_ADAPTIVE_BUFFERS
+	wiznetRebalanceBuffers(socket);
+#endif
 
-		// Set-up interrupts on the socket to be opened
-		// Interrupt on: Receive new data, receive disconnection signal, TCP retransmission
-		//               timeout.
-		wiznetSetSocketInterruptMask(socket, Sn_IR_RECEIVE | Sn_IR_DISCONNECT | Sn_IR_TIMEOUT);
-		
-		//process socket initialization
-		wiznetSocketCommand(socket, Sn_CR_OPEN);
-		while(wiznetGetSocketStatus(socket)==Sn_SR_CLOSED)
-			if (wiznetGetSocketInterrupt(socket) & Sn_IR_TIMEOUT) {
-				// If a socket takes too long to open, then a timeout error occurs
-				wiznetCloseSocket(socket);
-				return WIZNET_ERROR_SOCKET_TIMEOUT;
-			}
+	// Set port number
+	wiznetSetSocketSourcePort(socket, port);
 
-		// Wait for the SOCK_SYNSENT to clear 
-		while (wiznetGetSocketStatus(socket) == Sn_SR_SYN_SENT);
+	// Set-up interrupts on the socket to be opened
+	// Interrupt on: Receive new data, receive disconnection signal, TCP retransmission
+	//               timeout, and the events wiznetDispatchEvents has handlers for.
+	wiznetSetSocketInterruptMask(socket, wiznetSocketInterruptMask(socket));
 
-		// Check that the socket was succesfully set-up and is showing the correct
-		// status code, as sent over.
-		status = wiznetGetSocketStatus(socket);
-		switch(protocol) {
-		case Sn_MR_UDP:
-			if (status != Sn_SR_UDP)
-				return WIZNET_ERROR_SOCKET_OPEN;
-			break;
-		case Sn_MR_TCP:
-			if (status != Sn_SR_INIT)
-				return WIZNET_ERROR_SOCKET_OPEN;
-			break;
-		case Sn_MR_MACRAW:
-			if (status != Sn_SR_MACRAW)
-				return WIZNET_ERROR_SOCKET_OPEN;
-		}
-#ifdef WIZNET_INTERRUPTS_ENABLED
-		wiznetSocketEnableInterrupts(socket);
-#endif
-		return WIZNET_SUCCESS;
-	} else 
-		return WIZNET_ERROR_UNKNOWN_PROTOCOL;
+	// Set socket mode and process socket initialization. Sn_MR and Sn_CR
+	// are adjacent, so both go in one write.
+	wiznetSetSocketModeAndCommand(socket, protocol | flags, Sn_CR_OPEN);
+	wiznetSocketCommandWait(socket, Sn_CR_OPEN);
+	setup->state = WIZNET_SETUP_OPENING;
+	return WIZNET_IN_PROGRESS;
 }
 
-/* This function connects a TCP socket to the desired DIPR and DPORT
+/* This function starts connecting a TCP socket to the desired DIPR and DPORT
+** and returns as soon as the CONNECT command has been issued. The connection
+** is then driven to completion with wiznetSocketPoll.
 **
 ** socket - the socket number (0-7)
 ** destIP - the destination IP to connect to
 ** destPort - the destination port to connect to
 **
-** returns - WIZNET_SUCCESS if succesful
-**           WIZNET_ERROR_SOCKET_TIMEOUT if there is a timeout on connection attempt
-**           WIZNET_ERROR_SOCKET_OPEN if the socket failed for some other reason
+** returns - WIZNET_IN_PROGRESS if the connection is under way
+**           WIZNET_ERROR_SOCKET_NOT_READY if the socket was not opened for TCP
 */
-int wiznetConnectSocket(uint8_t socket, uint8_t* destIP, uint16_t destPort) {
+int wiznetConnectSocketStart(uint8_t socket, uint8_t* destIP, uint16_t destPort) {
 	//Check that the socket is opened with TCP mode
 	if (!(wiznetGetSocketStatus(socket) & Sn_SR_INIT))
 		return WIZNET_ERROR_SOCKET_NOT_READY;
@@ -263,41 +680,22 @@ int wiznetConnectSocket(uint8_t socket, uint8_t* destIP, uint16_t destPort) {
 #endif
 	// Set the destination end-point address and issue the connect command
 	// to initialize connection to the target.
-	wiznetSetSocketDestIP(socket, destIP);
-	wiznetSetSocketDestPort(socket, destPort);
+	wiznetSetSocketDest(socket, destIP, destPort);
 	wiznetSocketCommand(socket, Sn_CR_CONNECT);
-
-	// Wait for connection to succeed. If the destination is unreachable
-	// then a timeout error is returned
-	while (wiznetGetSocketStatus(socket)==Sn_SR_INIT)
-		if (wiznetGetSocketInterrupt(socket) & Sn_IR_TIMEOUT) {
-			wiznetCloseSocket(socket);
-			return WIZNET_ERROR_SOCKET_TIMEOUT;
-		}
-
-	// Wait for the SOCK_SYNSENT to clear
-	while (wiznetGetSocketStatus(socket) == Sn_SR_SYN_SENT);
-
-	// Final check that the socket connected succesfully and a stream link
-	// is now fully established.
-	if (wiznetGetSocketStatus(socket)!=Sn_SR_ESTABLISHED) {
-			wiznetCloseSocket(socket);
-			return WIZNET_ERROR_SOCKET_OPEN;
-		}
-	
-#ifdef WIZNET_INTERRUPTS_ENABLED
-	wiznetSocketEnableInterrupts(socket);
-#endif
-	return WIZNET_SUCCESS;
+	wiznetSocketSetups[socket].state = WIZNET_SETUP_CONNECTING;
+	return WIZNET_IN_PROGRESS;
 }
 
-/* This function sets a TCP socket to listen mode.
+/* This function starts setting a TCP socket to listen mode and returns as
+** soon as the LISTEN command has been issued. The socket is then driven to
+** completion with wiznetSocketPoll.
 **
 ** socket - the socket number (0-7)
+**
+** returns - WIZNET_IN_PROGRESS if the socket is starting to listen
+**           WIZNET_ERROR_SOCKET_NOT_READY if the socket was not opened for TCP
 */
-
-int wiznetListenOnSocket(uint8_t socket) {
-
+int wiznetListenOnSocketStart(uint8_t socket) {
 	// Make sure that the socket has been opened and
 	// is waiting for further action.
 	if (wiznetGetSocketStatus(socket) != Sn_SR_INIT)
@@ -309,20 +707,96 @@ int wiznetListenOnSocket(uint8_t socket) {
 
 	// Set the socket to listen mode
 	wiznetSocketCommand(socket, Sn_CR_LISTEN);
+	wiznetSocketSetups[socket].state = WIZNET_SETUP_LISTENING;
+	return WIZNET_IN_PROGRESS;
+}
 
-	// Wait for socket to start listening
-	while (wiznetGetSocketStatus(socket) == Sn_SR_INIT);
+/* This function ends a socket set-up, recording its result
+*/
+static int wiznetSocketSetupDone(uint8_t socket, int result) {
+	struct wiznetSocketSetup* setup = &wiznetSocketSetups[socket];
+	uint8_t state = setup->state;
 
-	// Final check that the socket started listening succesfully.
-	if (wiznetGetSocketStatus(socket) != Sn_SR_LISTEN) {
+	setup->state = WIZNET_SETUP_IDLE;
+	if (result != WIZNET_SUCCESS && state != WIZNET_SETUP_OPENING)
 		wiznetCloseSocket(socket);
-		return WIZNET_ERROR_SOCKET_OPEN;
-	}
-
 #ifdef WIZNET_INTERRUPTS_ENABLED
-	wiznetSocketEnableInterrupts(socket);
+	if (result == WIZNET_SUCCESS)
+		wiznetSocketEnableInterrupts(socket);
 #endif
-	return WIZNET_SUCCESS;
+	setup->result = result;
+	return result;
+}
+
+/* This function advances the set-up of a socket started with
+** wiznetOpenSocketStart, wiznetConnectSocketStart or wiznetListenOnSocketStart
+** by one step. Each call reads the socket status once (and the interrupt
+** register with it), so one loop can drive set-up on all
+** sockets at the same time.
+**
+** socket - the socket number (0-7)
+**
+** returns - WIZNET_IN_PROGRESS until the socket reaches its target state
+**         - WIZNET_SUCCESS once the socket is open (UDP, MACRAW or TCP INIT),
+**           established or listening
+**         - WIZNET_ERROR_SOCKET_TIMEOUT if the chip reported a timeout
+**         - WIZNET_ERROR_SOCKET_OPEN if the socket ended up in the wrong state
+**         - the result of the last set-up if none is in progress, or
+**           WIZNET_ERROR_SOCKET_OPEN if it was abandoned by closing the socket
+*/
+int wiznetSocketPoll(uint8_t socket) {
+	struct wiznetSocketSetup* setup = &wiznetSocketSetups[socket];
+	uint8_t status, ir;
+
+	if (setup->state == WIZNET_SETUP_IDLE)
+		return setup->result;
+
+	// Sn_IR and Sn_SR are adjacent and read together
+	status = wiznetGetSocketInterruptAndStatus(socket, &ir);
+	switch (setup->state) {
+	case WIZNET_SETUP_OPENING:
+		if (status == Sn_SR_CLOSED) {
+			// If a socket takes too long to open, then a timeout error occurs
+			if (ir & Sn_IR_TIMEOUT) {
+				wiznetSocketSetupDone(socket, WIZNET_ERROR_SOCKET_TIMEOUT);
+				wiznetCloseSocket(socket);
+				return WIZNET_ERROR_SOCKET_TIMEOUT;
+			}
+			return WIZNET_IN_PROGRESS;
+		}
+		// Wait for the SOCK_SYNSENT to clear
+		if (status == Sn_SR_SYN_SENT)
+			return WIZNET_IN_PROGRESS;
+		if (status != setup->expect)
+			return wiznetSocketSetupDone(socket, WIZNET_ERROR_SOCKET_OPEN);
+		break;
+	case WIZNET_SETUP_CONNECTING:
+		// Wait for connection to succeed. If the destination is unreachable
+		// then a timeout error is returned
+		if (status == Sn_SR_INIT || status == Sn_SR_SYN_SENT) {
+			if (ir & Sn_IR_TIMEOUT)
+				return wiznetSocketSetupDone(socket, WIZNET_ERROR_SOCKET_TIMEOUT);
+			return WIZNET_IN_PROGRESS;
+		}
+		// Final check that the socket connected succesfully and a stream link
+		// is now fully established. A timeout during SYN_SENT leaves the
+		// socket closed.
+		if (status != Sn_SR_ESTABLISHED) {
+			if (ir & Sn_IR_TIMEOUT)
+				return wiznetSocketSetupDone(socket, WIZNET_ERROR_SOCKET_TIMEOUT);
+			return wiznetSocketSetupDone(socket, WIZNET_ERROR_SOCKET_OPEN);
+		}
+		break;
+	case WIZNET_SETUP_LISTENING:
+		// Wait for socket to start listening
+		if (status == Sn_SR_INIT)
+			return WIZNET_IN_PROGRESS;
+		// Final check that the socket started listening succesfully.
+		if (status != Sn_SR_LISTEN)
+			return wiznetSocketSetupDone(socket, WIZNET_ERROR_SOCKET_OPEN);
+		break;
+	}
+	return wiznetSocketSetupDone(socket, WIZNET_SUCCESS);
 }
 
 /* This function closes a socket. It does not check if that socket is actually open.
@@ -332,14 +806,93 @@ int wiznetListenOnSocket(uint8_t socket) {
 void wiznetCloseSocket(uint8_t socket) {
 	wiznetSocketCommand(socket, Sn_CR_CLOSE);
 
+	// A send in flight on a closed socket will never complete, and
+	// transactions open on it are dropped. Neither the outcome of an earlier
+	// send nor a set-up left unfinished carries over to the socket's next use.
+	wiznetSendPending &= ~(1 << socket);
+	wiznetStreamPending &= ~(1 << socket);
+	wiznetSendResult[socket] = WIZNET_ERROR_NOT_SENDING;
+	wiznetSendTransactions[socket].active = 0;
+	wiznetRecvTransactions[socket].active = 0;
+	if (wiznetSocketSetups[socket].state != WIZNET_SETUP_IDLE) {
+		wiznetSocketSetups[socket].state = WIZNET_SETUP_IDLE;
+		wiznetSocketSetups[socket].result = WIZNET_ERROR_SOCKET_OPEN;
+	}
+
 	// Interrupts on the closed socket will no longer be needed so shut them
-	// off.
+	// off, and acknowledge those already raised (Sn_IR bits clear when 1 is
+	// written) so that a TIMEOUT from a failed set-up does not end the next.
 	wiznetSetSocketInterruptMask(socket, 0);
-	wiznetSetSocketInterrupt(socket, 0x00);
+	wiznetSetSocketInterrupt(socket, 0x1F);
 #ifdef WIZNET_INTERRUPTS_ENABLED
 	wiznetSocketDisableInterrupts(socket);
 #endif
+	wiznetIOFlush();
+
+}
 
+/* This function waits until some of the given sockets are ready, in the
+** manner of poll(), but counting polling passes rather than time; a
+** wiznetPollIdle hook that sleeps gives the passes a duration.
+** A socket is readable when it has received data and writable when it has
+** free space in its TX buffer.
+** The first pass checks Sn_RX_RSR on every socket in readMask. After that
+** SIR is read once per pass and only the flagged sockets are checked, and
+** with interrupts enabled SIR is not read at all while INTn is de-asserted.
+** Sockets in writeMask have Sn_TX_FSR read on every pass.
+** Because later passes rely on SIR, data that arrives after the first pass
+** is only seen while its Sn_IR RECEIVE flag is set. If something else
+** acknowledges the flag in the meantime (wiznetDispatchEvents called from
+** an interrupt or from wiznetPollIdle, say) the data is not reported until
+** the next call.
+**
+** readMask  - bitmask of sockets to wait on for data, replaced by those readable
+** writeMask - bitmask of sockets to wait on for space, replaced by those writable
+** passes    - number of further passes before giving up (wiznetPollIdle is
+**             called before each), 0 to check once, WIZNET_POLL_FOREVER to block
+**
+** returns - number of sockets ready, 0 if none became ready
+*/
+int wiznetPoll(uint8_t* readMask, uint8_t* writeMask, uint16_t passes) {
+	uint8_t candidates, readable, writable, i;
+	int count;
+
+	candidates = *readMask;
+	while (1) {
+		readable = 0;
+		writable = 0;
+		for (i = 0; i < WIZNET_MAX_SOCKETS; i++) {
+			if ((candidates & (1 << i)) && wiznetGetSocketRXReceivedSize(i) > 0)
+				readable |= 1 << i;
+			if ((*writeMask & (1 << i)) && wiznetGetSocketTXFreeSize(i) > 0)
+				writable |= 1 << i;
+		}
+		if (readable | writable)
+			break;
+		if (passes == 0) {
+			*readMask = 0;
+			*writeMask = 0;
+			return 0;
+		}
+		if (passes != WIZNET_POLL_FOREVER)
+			passes--;
+		wiznetPollIdle();
+
+		candidates = 0;
+		if (*readMask) {
+#if defined(WIZNET_INTERRUPTS_ENABLED) && defined(wiznetINTAsserted)
+			if (wiznetINTAsserted())
+#endif
+				candidates = wiznetGetInterruptsOnSockets() & *readMask;
+		}
+	}
+	*readMask = readable;
+	*writeMask = writable;
+	for (count = 0; readable; readable &= readable - 1)
+		count++;
+	for (; writable; writable &= writable - 1)
+		count++;
+	return count;
 }
 
 /* This function blocks until data is present on one of the interfaces
@@ -347,11 +900,8 @@ void wiznetCloseSocket(uint8_t socket) {
 ** on an interrupt-basis. 
 */
 void wiznetWaitForData(void) {
-	int i;
-	while (1)
-		for (i=0;i<WIZNET_MAX_SOCKETS; i++)
-			if (wiznetRecvPeek(i) > 0)
-				return;
+	uint8_t readMask = 0xFF, writeMask = 0;
+	wiznetPoll(&readMask, &writeMask, WIZNET_POLL_FOREVER);
 }
 
 /* This function is used to transfer some data into the current buffer
@@ -363,12 +913,8 @@ void wiznetWaitForData(void) {
 ** TODO: Add in a boundary check for the back of the circular buffer
 */
 void wiznetSendData(const uint8_t* buf, uint16_t length) {
-	wiznetIOBegin(wiznetBufferWriteSocket, wiznetBufferWriteCur, 'w', 't');
-	while (length--) {
-		wiznetIOTransceive(*buf++);
-		wiznetBufferWriteCur++;
-	}
-	wiznetIOFinish();
+	if (wiznetBufferWriteSocket > -1)
+		wiznetTxData(&wiznetSendTransactions[wiznetBufferWriteSocket], buf, length);
 }
 
 /* This function is used to transfer some data into the current buffer
@@ -381,23 +927,51 @@ void wiznetSendData(const uint8_t* buf, uint16_t length) {
 ** TODO: Add in a boundary check for the back of the circular buffer
 */
 void wiznetSendSLIPData(const uint8_t* buf, uint16_t length) {
-	uint8_t tmp;
-	wiznetIOBegin(wiznetBufferWriteSocket, wiznetBufferWriteCur, 'w', 't');
-	while (length--) {
-		tmp = *buf++;
-		if (tmp == 0xC0) {
-			wiznetIOTransceive(0xDB);
-			wiznetBufferWriteCur++;
-			wiznetIOTransceive(0xDC);
-		} else if (tmp == 0xDB) {
-			wiznetIOTransceive(0xDB);
-			wiznetBufferWriteCur++;
-			wiznetIOTransceive(0xDD);
-		} else 
-			wiznetIOTransceive(tmp);
-		wiznetBufferWriteCur++;
-	}
-	wiznetIOFinish();
+	if (wiznetBufferWriteSocket > -1)
+		wiznetTxSLIPData(&wiznetSendTransactions[wiznetBufferWriteSocket], buf, length);
+}
+
+/* This function is used to transfer several fragments into the current
+** buffer in a single SPI transaction
+**
+** iov   - array of fragments
+** count - number of fragments
+*/
+void wiznetSendDataV(const struct wiznetIOVec* iov, uint8_t count) {
+	if (wiznetBufferWriteSocket > -1)
+		wiznetTxDataV(&wiznetSendTransactions[wiznetBufferWriteSocket], iov, count);
+}
+
+/* This function is used to transfer several fragments into the current
+** buffer, escaping them for SLIP, in a single SPI transaction
+**
+** iov   - array of fragments
+** count - number of fragments
+*/
+void wiznetSendSLIPDataV(const struct wiznetIOVec* iov, uint8_t count) {
+	if (wiznetBufferWriteSocket > -1)
+		wiznetTxSLIPDataV(&wiznetSendTransactions[wiznetBufferWriteSocket], iov, count);
+}
+
+/* This function sends a UDP datagram gathered from several fragments in one
+** call: begin, one SPI write for all fragments, and a blocking commit
+**
+** socket   - the socket number on which to send
+** destIP   - the IP address to send to
+** destPort - the destination port to send to
+** iov      - array of fragments
+** count    - number of fragments
+**
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
+*/
+int wiznetSendToV(uint8_t socket, uint8_t* destIP, uint16_t destPort, const struct wiznetIOVec* iov, uint8_t count) {
+	struct wiznetTransaction* tx;
+	int ret;
+
+	if ((ret = wiznetTxBeginTo(socket, destIP, destPort, &tx)) != WIZNET_SUCCESS)
+		return ret;
+	wiznetTxDataV(tx, iov, count);
+	return wiznetTxCommit(tx);
 }
 
 /* This function forms the first half of a transactional send, on a UDP socket
@@ -411,13 +985,14 @@ void wiznetSendSLIPData(const uint8_t* buf, uint16_t length) {
 */
 
 int wiznetSendToBegin(uint8_t socket, uint8_t* destIP, uint16_t destPort) {
+	struct wiznetTransaction* tx;
+	int ret;
+
 	//Buffer is already in use, finish the other read/write first!
 	if (wiznetBufferWriteSocket > -1)
-		return WIZNET_ERROR_SEND_COLLISION;
-	wiznetSetSocketDestIP(socket, destIP);
-	wiznetSetSocketDestPort(socket, destPort);
-
-	wiznetBufferWriteCur = wiznetGetSocketTXWritePointer(socket);
+		return wiznetCollision(socket, WIZNET_ERROR_SEND_COLLISION);
+	if ((ret = wiznetTxBeginTo(socket, destIP, destPort, &tx)) != WIZNET_SUCCESS)
+		return ret;
 	wiznetBufferWriteSocket = socket;
 	return WIZNET_SUCCESS;
 }
@@ -435,11 +1010,14 @@ int wiznetSendToBegin(uint8_t socket, uint8_t* destIP, uint16_t destPort) {
 **         - WIZNET_ERROR_SEND_COLLISION if another socket is undergoing a write
 */
 int wiznetSendBegin(uint8_t socket) {
+	struct wiznetTransaction* tx;
+	int ret;
+
 	//Buffer is already in use, finish the other read/write first!
 	if (wiznetBufferWriteSocket > -1)
-		return WIZNET_ERROR_SEND_COLLISION;
-
-	wiznetBufferWriteCur = wiznetGetSocketTXWritePointer(socket);
+		return wiznetCollision(socket, WIZNET_ERROR_SEND_COLLISION);
+	if ((ret = wiznetTxBegin(socket, &tx)) != WIZNET_SUCCESS)
+		return ret;
 	wiznetBufferWriteSocket = socket;
 	return WIZNET_SUCCESS;
 }
@@ -463,6 +1041,36 @@ int wiznetSendBeginSLIP(uint8_t socket) {
 	return WIZNET_SUCCESS;
 }	
 
+/* This function checks, with a single read of Sn_IR, whether the send in flight
+** on a socket has finished. A finished send is acknowledged and its result
+** recorded.
+**
+** socket - the socket to check
+**
+** returns - WIZNET_IN_PROGRESS if the chip is still sending
+**         - WIZNET_SUCCESS or WIZNET_ERROR_SEND_DATA once it has finished
+*/
+static int wiznetSendCheck(uint8_t socket) {
+	uint8_t ir;
+	int ret;
+
+	if (!(wiznetSendPending & (1 << socket)))
+		return wiznetSendResult[socket];
+
+	ir = wiznetGetSocketInterrupt(socket);
+	if (ir & Sn_IR_SEND_OK) {
+		wiznetSetSocketInterrupt(socket, Sn_IR_SEND_OK);
+		ret = WIZNET_SUCCESS;
+	} else if (ir & Sn_IR_TIMEOUT) {
+		wiznetSetSocketInterrupt(socket, (Sn_IR_SEND_OK | Sn_IR_TIMEOUT));
+		wiznetSocketStatInc(socket, sendTimeouts);
+		ret = WIZNET_ERROR_SEND_DATA;
+	} else
+		return WIZNET_IN_PROGRESS;
+	wiznetIOFlush();
+	return wiznetSendFinish(socket, ret);
+}
+
 /* This function is used to end the writing to a transmission buffer and send the data out
 ** it forms the second half of a SendToBegin/SendToCommit transaction pair
 ** This function re-enables interrupts
@@ -470,26 +1078,13 @@ int wiznetSendBeginSLIP(uint8_t socket) {
 ** returns - WIZNET_SUCCESS if succesful, error code otherwise
 */
 int wiznetSendToCommit(void) {
+	uint8_t socket = wiznetBufferWriteSocket;
+
 	//No transaction in progress: Failure!
 	if (wiznetBufferWriteSocket == -1)
 		return WIZNET_ERROR_NOT_SENDING;
-
-	wiznetSetSocketTXWritePointer(wiznetBufferWriteSocket, wiznetBufferWriteCur);
-	wiznetSocketCommand(wiznetBufferWriteSocket, Sn_CR_SEND);
-
-	while (!(wiznetGetSocketInterrupt(wiznetBufferWriteSocket) & Sn_IR_SEND_OK)) {
-		if (wiznetGetSocketInterrupt(wiznetBufferWriteSocket) & Sn_IR_TIMEOUT) {
-			wiznetSetSocketInterrupt(wiznetBufferWriteSocket, (Sn_IR_SEND_OK | Sn_IR_TIMEOUT));
-			goto fail;
-		}
-	}
-	wiznetSetSocketInterrupt(wiznetBufferWriteSocket, Sn_IR_SEND_OK);
-	wiznetBufferWriteSocket = -1;
-	return WIZNET_SUCCESS;
-fail:
 	wiznetBufferWriteSocket = -1;
-	return WIZNET_ERROR_SEND_DATA;
-	
+	return wiznetTxCommit(&wiznetSendTransactions[socket]);
 }
 
 /* This function is used to end the writing to a transmission buffer and send the data out
@@ -516,11 +1111,111 @@ int wiznetSendCommitSLIP(void) {
 	return wiznetSendToCommit();
 }
 
+/* This function ends the writing to a transmission buffer and starts the send
+** without waiting for it to finish. The write buffer is free again as soon as
+** this returns, so the next datagram can be written into TX memory while this
+** one is still on the wire. The outcome is collected with wiznetSendPoll,
+** wiznetSendWait or wiznetSendReap.
+** If the socket still has a send in flight, this waits for it first, as the
+** chip accepts only one SEND at a time.
+**
+** returns - WIZNET_SUCCESS if the send was started
+**         - WIZNET_ERROR_NOT_SENDING if no transaction was in progress
+*/
+int wiznetSendToCommitAsync(void) {
+	uint8_t socket = wiznetBufferWriteSocket;
+
+	//No transaction in progress: Failure!
+	if (wiznetBufferWriteSocket == -1)
+		return WIZNET_ERROR_NOT_SENDING;
+	wiznetBufferWriteSocket = -1;
+	return wiznetTxCommitAsync(&wiznetSendTransactions[socket]);
+}
+
+/* This function is the non-blocking form of wiznetSendCommit. It is identical
+** to wiznetSendToCommitAsync and is included as a convienience.
+*/
+int wiznetSendCommitAsync(void) {
+	return wiznetSendToCommitAsync();
+}
+
+/* This function is the non-blocking form of wiznetSendCommitSLIP
+*/
+int wiznetSendCommitSLIPAsync(void) {
+	uint8_t tmp = 0xC0;
+	if (wiznetBufferWriteSocket == -1)
+		return WIZNET_ERROR_NOT_SENDING;
+	wiznetSendData(&tmp, sizeof(tmp));
+	return wiznetSendToCommitAsync();
+}
+
+/* This function checks on a send started with one of the *Async commits.
+** If it has finished, the completion handler is called.
+**
+** socket - the socket to check
+**
+** returns - WIZNET_IN_PROGRESS if the chip is still sending
+**         - WIZNET_SUCCESS or WIZNET_ERROR_SEND_DATA for the last send
+**         - WIZNET_ERROR_NOT_SENDING if the socket has been closed since
+*/
+int wiznetSendPoll(uint8_t socket) {
+	int ret;
+	uint8_t pending = wiznetSendPending & (1 << socket);
+
+	ret = wiznetSendCheck(socket);
+	if (pending && ret != WIZNET_IN_PROGRESS && wiznetSendCompleteHandler != NULL)
+		wiznetSendCompleteHandler(socket, ret);
+	return ret;
+}
+
+/* This function waits for the send in flight on a socket to finish
+**
+** socket - the socket to wait on
+**
+** returns - WIZNET_SUCCESS or WIZNET_ERROR_SEND_DATA for the last send
+**         - WIZNET_ERROR_NOT_SENDING if the socket has been closed since
+*/
+int wiznetSendWait(uint8_t socket) {
+	int ret;
+	while ((ret = wiznetSendPoll(socket)) == WIZNET_IN_PROGRESS)
+		wiznetSocketStatInc(socket, waitLoops);
+	return ret;
+}
+
+/* This function collects the outcome of every finished send, calling the
+** completion handler for each. It is meant to be called from the main loop
+** or an interrupt handler.
+*/
+void wiznetSendReap(void) {
+	uint8_t i;
+	for (i = 0; i < WIZNET_MAX_SOCKETS; i++)
+		if (wiznetSendPending & (1 << i))
+			wiznetSendPoll(i);
+}
+
+/* This function sets the handler called when an asynchronous send finishes.
+** SEND_OK is unmasked in Sn_IMR of every socket while a handler is set, so
+** that wiznetDispatchEvents sees sends finish.
+**
+** handler - function called with the socket and WIZNET_SUCCESS or
+**           WIZNET_ERROR_SEND_DATA, or NULL for none
+*/
+void wiznetSetSendCompleteHandler(wiznetSendHandler handler) {
+	uint8_t i;
+
+	wiznetSendCompleteHandler = handler;
+	for (i = 0; i < WIZNET_MAX_SOCKETS; i++)
+		wiznetSetSocketInterruptMask(i, wiznetSocketInterruptMask(i));
+	wiznetIOFlush();
+}
+
 /* This function is used to abandon the writing to a transmission buffer
 ** without sending the data out
 ** This function re-enables interrupts
 */
 int wiznetSendToAbandon(void) {
+	if (wiznetBufferWriteSocket > -1)
+		wiznetTxAbandon(&wiznetSendTransactions[wiznetBufferWriteSocket]);
 	wiznetBufferWriteSocket = -1;
 	return WIZNET_SUCCESS;
 }
@@ -538,7 +1233,9 @@ int wiznetSendAbandon(void) {
 ** This function takes no arguments
 */
 uint16_t wiznetGetBufferWritePosition(void) {
-	return wiznetBufferWriteCur;
+	if (wiznetBufferWriteSocket == -1)
+		return 0;
+	return wiznetSendTransactions[wiznetBufferWriteSocket].cur;
 }
 
 /* This function sets the current position of the buffer as has been previously
@@ -547,7 +1244,8 @@ uint16_t wiznetGetBufferWritePosition(void) {
 ** pos - position from wiznetGetBufferPosition
 */
 void wiznetSetBufferWritePosition(uint16_t pos) {
-	wiznetBufferWriteCur = pos;
+	if (wiznetBufferWriteSocket > -1)
+		wiznetSendTransactions[wiznetBufferWriteSocket].cur = pos;
 }
 
 /* This function alters the current position of the buffer by a relative move
@@ -556,7 +1254,8 @@ void wiznetSetBufferWritePosition(uint16_t pos) {
 ** pos - amount by which to change the buffer position
 */
 void wiznetSetRelBufferWritePosition(int16_t change) {
-	wiznetBufferWriteCur += change;
+	if (wiznetBufferWriteSocket > -1)
+		wiznetSendTransactions[wiznetBufferWriteSocket].cur += change;
 }
 
 /* This function is used to initialize reading from the reception buffer
@@ -568,10 +1267,14 @@ void wiznetSetRelBufferWritePosition(int16_t change) {
 **         - WIZNET_ERROR_RECV_COLLISION if a recv was already in progress
 */
 int wiznetRecvBegin(uint8_t socket) {
+	struct wiznetTransaction* rx;
+	int ret;
+
 	//Buffer is already in use, finish the other read/write first!
 	if (wiznetBufferReadSocket > -1)
-		return WIZNET_ERROR_RECV_COLLISION;
-	wiznetBufferReadCur = wiznetGetSocketRXReadPointer(socket);
+		return wiznetCollision(socket, WIZNET_ERROR_RECV_COLLISION);
+	if ((ret = wiznetRxBegin(socket, &rx)) != WIZNET_SUCCESS)
+		return ret;
 	wiznetBufferReadSocket = socket;
 //	wiznetDisableInterrupts();
 	return WIZNET_SUCCESS;
@@ -587,18 +1290,15 @@ int wiznetRecvBegin(uint8_t socket) {
 **         - WIZNET_ERROR_NO_SLIP_HEADER if datagram was not start with C0
 */
 int wiznetRecvBeginSLIP(uint8_t socket) {
-	uint8_t tmp;
+	struct wiznetTransaction* rx;
+	int ret;
+
 	//Buffer is already in use, finish the other read/write first!
 	if (wiznetBufferReadSocket > -1)
-		return WIZNET_ERROR_RECV_COLLISION;
-	wiznetBufferReadCur = wiznetGetSocketRXReadPointer(socket);
+		return wiznetCollision(socket, WIZNET_ERROR_RECV_COLLISION);
+	if ((ret = wiznetRxBeginSLIP(socket, &rx)) != WIZNET_SUCCESS)
+		return ret;
 	wiznetBufferReadSocket = socket;
-	
-	wiznetRecvData(&tmp, sizeof(tmp));
-	if (tmp != 0xC0) {
-		wiznetRecvAbandon();
-		return WIZNET_ERROR_NO_SLIP_HEADER;
-	}
 //	wiznetDisableInterrupts();
 	return WIZNET_SUCCESS;
 }
@@ -614,18 +1314,23 @@ int wiznetRecvBeginSLIP(uint8_t socket) {
 ** TODO: What if the user wants to read from the transmit buffer?
 */
 void wiznetRecvData(uint8_t* buf, uint16_t length) {
-	wiznetIOBegin(wiznetBufferReadSocket, wiznetBufferReadCur, 'r', 'r');
-	if (buf == NULL)
-		while (length--) {
-			wiznetIOTransceive(0xFF);
-			wiznetBufferReadCur++;
-		}
-	else
-		while (length--) {
-			*buf++ = wiznetIOTransceive(0xFF);
-			wiznetBufferReadCur++;
-		}
-	wiznetIOFinish();
+	if (wiznetBufferReadSocket > -1)
+		wiznetRxData(&wiznetRecvTransactions[wiznetBufferReadSocket], buf, length);
+}
+
+/* This function hands data from the current buffer to a visitor in chunks,
+** see wiznetRxVisit
+**
+** length  - number of bytes to visit
+** visitor - function called with each chunk
+** ctx     - passed through to the visitor
+**
+** returns - WIZNET_SUCCESS if succesful, or the visitor's negative return value
+*/
+int wiznetRecvVisit(uint16_t length, wiznetRecvVisitor visitor, void* ctx) {
+	if (wiznetBufferReadSocket == -1)
+		return WIZNET_ERROR_NOT_RECVING;
+	return wiznetRxVisit(&wiznetRecvTransactions[wiznetBufferReadSocket], length, visitor, ctx);
 }
 
 /* This function is used to transfer some data from the current wiznet
@@ -643,27 +1348,24 @@ void wiznetRecvData(uint8_t* buf, uint16_t length) {
 ** TODO: Error detection if escape character is followed by unexpected character
 */
 int wiznetRecvSLIPData(uint8_t* buf, uint16_t length) {
-	uint8_t tmp;
-	wiznetIOBegin(wiznetBufferReadSocket, wiznetBufferReadCur, 'r', 'r');
-	while (length--) {
-		tmp = wiznetIOTransceive(0xFF);
-		if (tmp == 0xC0) {
-			wiznetIOFinish();
-			return WIZNET_ERROR_PREMATURE_SLIP_END;
-		} else if (tmp == 0xDB) {
-			wiznetBufferReadCur++;
-			tmp = wiznetIOTransceive(0xFF); 
-			if (tmp == 0xDC)
-				tmp = 0xC0;
-			else if (tmp == 0xDD)
-				tmp = 0xDB;
-		}
-		if (buf != NULL)
-			*buf++ = tmp;
-		wiznetBufferReadCur++;
-	}
-	wiznetIOFinish();
-	return WIZNET_SUCCESS;
+	if (wiznetBufferReadSocket == -1)
+		return WIZNET_ERROR_NOT_RECVING;
+	return wiznetRxSLIPData(&wiznetRecvTransactions[wiznetBufferReadSocket], buf, length);
+}
+
+/* This function reads one whole SLIP frame from the current buffer, see
+** wiznetRxSLIPFrame
+**
+** buf    - byte array for the frame, or NULL to skip it
+** size   - space in buf
+** length - set to the length of the frame
+**
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
+*/
+int wiznetRecvSLIPFrame(uint8_t* buf, uint16_t size, uint16_t* length) {
+	if (wiznetBufferReadSocket == -1)
+		return WIZNET_ERROR_NOT_RECVING;
+	return wiznetRxSLIPFrame(&wiznetRecvTransactions[wiznetBufferReadSocket], buf, size, length);
 }
 
 /* This function reads a UDP header from the currently active
@@ -675,25 +1377,9 @@ int wiznetRecvSLIPData(uint8_t* buf, uint16_t length) {
 ** returns the length of the datagram
 */
 uint16_t wiznetRecvHeaderUDP(uint8_t* sIP, uint16_t* sPort) {
-	uint8_t nul[4];
-	uint16_t len;
-
-	// If a NULL is provided for the IP or Port then 
-	// do not store that the IP or port respectively
-	if (sIP == NULL)
-		sIP = nul;
-	if (sPort == NULL)
-		sPort = (uint16_t*)nul;
-
-	// Grab the sIP and port
-	wiznetRecvData(sIP, 4);
-	wiznetRecvData(nul, 2);
-	*sPort = (((uint16_t)nul[0])<<8) + nul[1];
-
-	// Grab the length of the data in the UDP packet
-	wiznetRecvData(nul, 2);
-	len = (((uint16_t)nul[0])<<8) + nul[1];
-	return len;
+	if (wiznetBufferReadSocket == -1)
+		return 0;
+	return wiznetRxHeaderUDP(&wiznetRecvTransactions[wiznetBufferReadSocket], sIP, sPort);
 }
 
 /* This function is used to end the reading from a reception buffer
@@ -704,29 +1390,15 @@ uint16_t wiznetRecvHeaderUDP(uint8_t* sIP, uint16_t* sPort) {
 **         - WIZNET_ERROR_NOT_RECVING if no receive was in progress
 */
 int wiznetRecvCommit(uint16_t len) {
-	uint16_t tmp;
+	uint8_t socket = wiznetBufferReadSocket;
 
 	// Check to see whether a read socket is actually in
 	// the process of receiving data.
 	if (wiznetBufferReadSocket == -1)
 		return WIZNET_ERROR_NOT_RECVING;
-
-	// If len is specified as zero, then it is assumed we are reading
-	// from a stream-based socket, so set the wiznet buffer to the
-	// current position, otherwise we are using a datagram so we
-	// know the length and can skip to the end.
-	if (len == 0)
-		tmp = wiznetBufferReadCur;
-	else
-		tmp = wiznetGetSocketRXReadPointer(wiznetBufferReadSocket)+len+8;
-
-	// Set the wiznet registers to advance the read buffer and
-	// issue the receive commit command.
-	wiznetSetSocketRXReadPointer(wiznetBufferReadSocket, tmp);
-//	wiznetEnableInterrupts();
-	wiznetSocketCommand(wiznetBufferReadSocket, Sn_CR_RECEIVE);
 	wiznetBufferReadSocket = -1;
-	return WIZNET_SUCCESS;
+//	wiznetEnableInterrupts();
+	return wiznetRxCommit(&wiznetRecvTransactions[socket], len);
 }
 
 /* This function is used to end the reading from a reception buffer
@@ -737,30 +1409,20 @@ int wiznetRecvCommit(uint16_t len) {
 **         - WIZNET_ERROR_NOT_RECVING if no receive was in progress
 */
 int wiznetRecvCommitSLIP(void) {
-	uint8_t tmpByte = 0x00;
+	int ret;
 
 	// Check to see whether a read socket is actually in
 	// the process of receiving data.
 	if (wiznetBufferReadSocket == -1)
 		return WIZNET_ERROR_NOT_RECVING;
-	
-	// Advancing to the end of a SLIP datagram is slightly more complex
-	// and involves scanning over the read buffer until the end character
-	// is encountered.
-	wiznetIOBegin(wiznetBufferReadSocket, wiznetBufferReadCur, 'r', 'r');
-	while (tmpByte != 0xC0) {
-		tmpByte = wiznetIOTransceive(0xFF);
-		wiznetBufferReadCur++;
-	}
-	wiznetIOFinish();
 
-	// Set the wiznet registers to advance the read buffer and
-	// issue the receive commit command.
-	wiznetSetSocketRXReadPointer(wiznetBufferReadSocket, wiznetBufferReadCur);
+	// An incomplete frame leaves the read in progress, to be abandoned or
+	// committed once the rest has arrived
+	ret = wiznetRxCommitSLIP(&wiznetRecvTransactions[wiznetBufferReadSocket]);
+	if (ret != WIZNET_ERROR_FRAME_INCOMPLETE)
+		wiznetBufferReadSocket = -1;
 //	wiznetEnableInterrupts();
-	wiznetSocketCommand(wiznetBufferReadSocket, Sn_CR_RECEIVE);
-	wiznetBufferReadSocket = -1;
-	return WIZNET_SUCCESS;
+	return ret;
 }
 
 
@@ -769,17 +1431,23 @@ int wiznetRecvCommitSLIP(void) {
 ** This function re-enables interrupts
 */
 int wiznetRecvAbandon(void) {
+	if (wiznetBufferReadSocket > -1)
+		wiznetRxAbandon(&wiznetRecvTransactions[wiznetBufferReadSocket]);
 	wiznetBufferReadSocket = -1;
 	return WIZNET_SUCCESS;
 //	wiznetEnableInterrupts();
 }
 
-/* This function checks how much data is resident in the specified socket RX buffer
+/* This function checks how much data is resident in the specified socket RX
+** buffer. What it finds counts towards the RX high-water mark and the RX
+** peak that WIZNET_ADAPTIVE_BUFFERS sizes the buffer from.
 **
 ** socket - the socket number in which to peek
 */
 int wiznetRecvPeek(uint8_t socket) {
-	return wiznetGetSocketRXReceivedSize(socket);
+	uint16_t rsr = wiznetGetSocketRXReceivedSize(socket);
+	wiznetNoteRXUsage(socket, rsr);
+	return rsr;
 }
 
 
@@ -788,7 +1456,9 @@ int wiznetRecvPeek(uint8_t socket) {
 ** This function takes no arguments
 */
 uint16_t wiznetGetBufferReadPosition(void) {
-	return wiznetBufferReadCur;
+	if (wiznetBufferReadSocket == -1)
+		return 0;
+	return wiznetRecvTransactions[wiznetBufferReadSocket].cur;
 }
 
 /* This function sets the current position of the buffer as has been previously
@@ -797,7 +1467,8 @@ uint16_t wiznetGetBufferReadPosition(void) {
 ** pos - position from wiznetGetBufferPosition
 */
 void wiznetSetBufferReadPosition(uint16_t pos) {
-	wiznetBufferReadCur = pos;
+	if (wiznetBufferReadSocket > -1)
+		wiznetRecvTransactions[wiznetBufferReadSocket].cur = pos;
 }
 
 /* This function alters the current position of the buffer by a relative move
@@ -806,6 +1477,1657 @@ void wiznetSetBufferReadPosition(uint16_t pos) {
 ** pos - amount by which to change the buffer position
 */
 void wiznetSetRelBufferReadPosition(int16_t change) {
-	wiznetBufferReadCur += change;
+	if (wiznetBufferReadSocket > -1)
+		wiznetRecvTransactions[wiznetBufferReadSocket].cur += change;
+}
+
+/* This function begins a send transaction on a socket and hands back its
+** handle. Each socket has one send handle, so transactions on different
+** sockets can be interleaved freely.
+**
+** socket - the socket number on which to send
+** tx     - set to the handle for the transaction
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_SEND_COLLISION if a send was already in progress on the socket
+*/
+int wiznetTxBegin(uint8_t socket, struct wiznetTransaction** tx) {
+	struct wiznetTransaction* t = &wiznetSendTransactions[socket];
+
+	if (t->active)
+		return wiznetCollision(socket, WIZNET_ERROR_SEND_COLLISION);
+	t->start = wiznetGetSocketTXWritePointer(socket);
+	t->cur = t->start;
+	t->active = 1;
+	*tx = t;
+	return WIZNET_SUCCESS;
+}
+
+/* This function begins a send transaction on a UDP socket, setting the
+** destination first
+**
+** socket   - the socket number on which to send
+** destIP   - the IP address to send to
+** destPort - the destination port to send to
+** tx       - set to the handle for the transaction
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_SEND_COLLISION if a send was already in progress on the socket
+*/
+int wiznetTxBeginTo(uint8_t socket, uint8_t* destIP, uint16_t destPort, struct wiznetTransaction** tx) {
+	if (wiznetSendTransactions[socket].active)
+		return wiznetCollision(socket, WIZNET_ERROR_SEND_COLLISION);
+	wiznetSetSocketDest(socket, destIP, destPort);
+	return wiznetTxBegin(socket, tx);
+}
+
+/* This function begins a send transaction in SLIP mode by writing the
+** opening end character
+**
+** socket - the socket number on which to send
+** tx     - set to the handle for the transaction
+*/
+int wiznetTxBeginSLIP(uint8_t socket, struct wiznetTransaction** tx) {
+	int ret;
+	uint8_t tmp = 0xC0;
+	if ((ret = wiznetTxBegin(socket, tx)) != WIZNET_SUCCESS)
+		return ret;
+	wiznetTxData(*tx, &tmp, sizeof(tmp));
+	return WIZNET_SUCCESS;
+}
+
+/* This function writes data into the TX buffer of a send transaction
+**
+** tx     - the transaction handle
+** buf    - byte array containing the data to send
+** length - number of bytes to send
+*/
+void wiznetTxData(struct wiznetTransaction* tx, const uint8_t* buf, uint16_t length) {
+	wiznetIOBeginControl(tx->cur, wiznetSocketControl(tx->socket, WIZNET_BLOCK_TX, 1));
+	wiznetIOTransceiveBlock(buf, NULL, length);
+	tx->cur += length;
+	wiznetIOFinish();
+}
+
+/* This function writes several fragments into the TX buffer of a send
+** transaction in a single SPI transaction
+**
+** tx    - the transaction handle
+** iov   - array of fragments
+** count - number of fragments
+*/
+void wiznetTxDataV(struct wiznetTransaction* tx, const struct wiznetIOVec* iov, uint8_t count) {
+	wiznetIOBeginControl(tx->cur, wiznetSocketControl(tx->socket, WIZNET_BLOCK_TX, 1));
+	while (count--) {
+		wiznetIOTransceiveBlock(iov->base, NULL, iov->length);
+		tx->cur += iov->length;
+		iov++;
+	}
+	wiznetIOFinish();
+}
+
+/* This function finds how many bytes at the start of buf need no SLIP
+** escaping, in the manner of memchr for two values. On targets with words
+** wider than 16 bits the search tests a whole word at a time; on 8- and
+** 16-bit targets the byte loop is as fast.
+*/
+static uint16_t wiznetSLIPCleanRun(const uint8_t* buf, uint16_t length) {
+	uint16_t run = 0;
+#if UINTPTR_MAX > 0xFFFF
+	const uintptr_t ones = (uintptr_t)-1 / 0xFF;
+	const uintptr_t highs = ones << 7;
+	uintptr_t word, end, esc;
+
+	// Bytes up to the first word boundary
+	while (run < length && ((uintptr_t)(buf + run) & (sizeof(uintptr_t) - 1))) {
+		if (buf[run] == 0xC0 || buf[run] == 0xDB)
+			return run;
+		run++;
+	}
+	// A byte of word equals 0xC0 or 0xDB if the matching XOR has a zero byte
+	while (run + sizeof(uintptr_t) <= length) {
+		memcpy(&word, buf + run, sizeof(word));
+		end = word ^ (ones * 0xC0);
+		esc = word ^ (ones * 0xDB);
+		if ((((end - ones) & ~end) | ((esc - ones) & ~esc)) & highs)
+			break;
+		run += sizeof(uintptr_t);
+	}
+#endif
+	while (run < length && buf[run] != 0xC0 && buf[run] != 0xDB)
+		run++;
+	return run;
+}
+
+/* This function SLIP-escapes data into the SPI transaction already opened
+** at the cursor of a send transaction
+*/
+static void wiznetTxSLIPBlock(struct wiznetTransaction* tx, const uint8_t* buf, uint16_t length) {
+	uint8_t escape[2] = {0xDB, 0x00};
+	uint16_t run;
+	while (length) {
+		// Bytes that need no escaping are sent as a single block
+		run = wiznetSLIPCleanRun(buf, length);
+		wiznetIOTransceiveBlock(buf, NULL, run);
+		tx->cur += run;
+		buf += run;
+		length -= run;
+		if (length) {
+			escape[1] = (*buf++ == 0xC0) ? 0xDC : 0xDD;
+			wiznetIOTransceiveBlock(escape, NULL, sizeof(escape));
+			tx->cur += sizeof(escape);
+			length--;
+		}
+	}
+}
+
+/* This function writes data into the TX buffer of a send transaction,
+** escaping it for SLIP
+**
+** tx     - the transaction handle
+** buf    - byte array containing the unescaped data
+** length - number of bytes in buf
+*/
+void wiznetTxSLIPData(struct wiznetTransaction* tx, const uint8_t* buf, uint16_t length) {
+	wiznetIOBeginControl(tx->cur, wiznetSocketControl(tx->socket, WIZNET_BLOCK_TX, 1));
+	wiznetTxSLIPBlock(tx, buf, length);
+	wiznetIOFinish();
+}
+
+/* This function writes several fragments into the TX buffer of a send
+** transaction, escaping them for SLIP, in a single SPI transaction
+**
+** tx    - the transaction handle
+** iov   - array of fragments
+** count - number of fragments
+*/
+void wiznetTxSLIPDataV(struct wiznetTransaction* tx, const struct wiznetIOVec* iov, uint8_t count) {
+	wiznetIOBeginControl(tx->cur, wiznetSocketControl(tx->socket, WIZNET_BLOCK_TX, 1));
+	while (count--) {
+		wiznetTxSLIPBlock(tx, iov->base, iov->length);
+		iov++;
+	}
+	wiznetIOFinish();
+}
+
+/* This function ends a send transaction and starts the send without waiting
+** for it to finish. The outcome is collected as for wiznetSendToCommitAsync.
+**
+** tx - the transaction handle
+**
+** returns - WIZNET_SUCCESS if the send was started
+**         - WIZNET_ERROR_NOT_SENDING if the transaction was not in progress
+*/
+int wiznetTxCommitAsync(struct wiznetTransaction* tx) {
+	uint8_t socket = tx->socket;
+
+	if (!tx->active)
+		return WIZNET_ERROR_NOT_SENDING;
+
+	if (wiznetSendPending & (1 << socket))
+		wiznetSendWait(socket);
+
+	wiznetNoteTXUsage(socket, tx->cur - tx->start, 0);
+	wiznetSocketStatInc(socket, sends);
+	wiznetSocketStatAdd(socket, bytesSent, (uint16_t)(tx->cur - tx->start));
+	wiznetSetSocketTXWritePointer(socket, tx->cur);
+	wiznetSocketCommand(socket, Sn_CR_SEND);
+	wiznetSendPending |= 1 << socket;
+	tx->active = 0;
+	return WIZNET_SUCCESS;
+}
+
+/* This function ends a send transaction and waits for the data to go out
+**
+** tx - the transaction handle
+**
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
+*/
+int wiznetTxCommit(struct wiznetTransaction* tx) {
+	int ret;
+
+	if ((ret = wiznetTxCommitAsync(tx)) != WIZNET_SUCCESS)
+		return ret;
+	while ((ret = wiznetSendCheck(tx->socket)) == WIZNET_IN_PROGRESS)
+		wiznetSocketStatInc(tx->socket, waitLoops);
+	return ret;
+}
+
+/* This function writes the closing SLIP end character and commits
+**
+** tx - the transaction handle
+**
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
+*/
+int wiznetTxCommitSLIP(struct wiznetTransaction* tx) {
+	uint8_t tmp = 0xC0;
+	if (!tx->active)
+		return WIZNET_ERROR_NOT_SENDING;
+	wiznetTxData(tx, &tmp, sizeof(tmp));
+	return wiznetTxCommit(tx);
+}
+
+/* This function abandons a send transaction. Nothing written is sent.
+**
+** tx - the transaction handle
+*/
+int wiznetTxAbandon(struct wiznetTransaction* tx) {
+	tx->active = 0;
+	return WIZNET_SUCCESS;
 }
 
+/* This function streams data of any length out of a socket. It writes as
+** much as Sn_TX_FSR allows and issues a SEND for each part, at most half of
+** the socket's TX memory at a time, so that the chip drains one half while
+** the next is written into the other. Data written while a SEND is still in
+** flight is held to the same half and sent as soon as that SEND finishes.
+**
+** Without WIZNET_STREAM_NONBLOCK this returns once all of buf has been sent.
+** With it, this returns as soon as no more progress can be made; the caller
+** then calls again later with the rest of the data (buf + *sent), or with a
+** length of 0 to push out what is already written.
+**
+** socket - the socket number on which to send
+** buf    - byte array containing the data to send
+** length - number of bytes to send
+** sent   - set to the number of bytes taken from buf
+** flags  - WIZNET_STREAM_* flags
+**
+** returns - WIZNET_SUCCESS if all the data has been sent; when non-blocking,
+**           once the last SEND has been issued, its outcome being collected
+**           as for wiznetSendToCommitAsync
+**         - WIZNET_IN_PROGRESS if data is still waiting, non-blocking only
+**         - WIZNET_ERROR_SEND_COLLISION if a send transaction was in progress
+**         - WIZNET_ERROR_SEND_DATA if a SEND failed or the socket closed
+*/
+int wiznetSendStream(uint8_t socket, const uint8_t* buf, uint16_t length, uint16_t* sent, uint8_t flags) {
+	struct wiznetTransaction* tx = &wiznetSendTransactions[socket];
+	uint16_t room, written, chunk = wiznetTXMemSize[socket] >> 1;
+	uint8_t bit = 1 << socket;
+	int ret;
+
+	*sent = 0;
+	if (tx->active && !(wiznetStreamPending & bit))
+		return wiznetCollision(socket, WIZNET_ERROR_SEND_COLLISION);
+	while (1) {
+		// Hand what has been written to the chip once it is free
+		if (wiznetStreamPending & bit) {
+			ret = (wiznetSendPending & bit) ? wiznetSendCheck(socket) : WIZNET_SUCCESS;
+			if (ret == WIZNET_ERROR_SEND_DATA) {
+				wiznetStreamPending &= ~bit;
+				tx->active = 0;
+				return ret;
+			}
+			if (ret == WIZNET_SUCCESS) {
+				wiznetStreamPending &= ~bit;
+				wiznetTxCommitAsync(tx);
+			}
+		}
+
+		if (length == 0 && !(wiznetStreamPending & bit)) {
+			if (flags & WIZNET_STREAM_NONBLOCK)
+				return WIZNET_SUCCESS;
+			ret = wiznetSendCheck(socket);
+			if (ret != WIZNET_IN_PROGRESS && ret != WIZNET_ERROR_NOT_SENDING)
+				return ret;
+			if (wiznetGetSocketStatus(socket) == Sn_SR_CLOSED)
+				return WIZNET_ERROR_SEND_DATA;
+			if (ret == WIZNET_ERROR_NOT_SENDING)
+				return WIZNET_SUCCESS;
+			continue;
+		}
+
+		// Write as much as fits next to the data not yet sent, keeping what
+		// waits for the next SEND within the chunk
+		room = 0;
+		if (length) {
+			written = (wiznetStreamPending & bit) ? tx->cur - tx->start : 0;
+			room = wiznetGetSocketTXFreeSize(socket) - written;
+			if (chunk && room > chunk - written)
+				room = chunk - written;
+			if (room > length)
+				room = length;
+			if (room < length && room < chunk - written)
+				wiznetNoteTXUsage(socket, 0, 1);
+		}
+		if (room) {
+			if (!(wiznetStreamPending & bit)) {
+				if ((ret = wiznetTxBegin(socket, &tx)) != WIZNET_SUCCESS)
+					return ret;
+				wiznetStreamPending |= bit;
+			}
+			wiznetTxData(tx, buf, room);
+			buf += room;
+			length -= room;
+			*sent += room;
+			continue;
+		}
+
+		// No progress. A SEND that times out leaves Sn_TX_FSR where it was,
+		// and one issued on a closed socket never finishes, so look at both.
+		if ((!(wiznetStreamPending & bit) && (wiznetSendPending & bit)
+					&& wiznetSendCheck(socket) == WIZNET_ERROR_SEND_DATA)
+				|| wiznetGetSocketStatus(socket) == Sn_SR_CLOSED) {
+			wiznetStreamPending &= ~bit;
+			tx->active = 0;
+			return WIZNET_ERROR_SEND_DATA;
+		}
+		if (flags & WIZNET_STREAM_NONBLOCK)
+			return WIZNET_IN_PROGRESS;
+		wiznetSocketStatInc(socket, waitLoops);
+	}
+}
+
+/* This function opens the receive transaction of a socket. If bounded is
+** set, Sn_RX_RSR is read along with Sn_RX_RD so the end of the received
+** data is known from the start.
+*/
+static int wiznetRxStart(uint8_t socket, struct wiznetTransaction** rx, uint8_t bounded) {
+	struct wiznetTransaction* t = &wiznetRecvTransactions[socket];
+	uint16_t rsr;
+
+	if (t->active)
+		return wiznetCollision(socket, WIZNET_ERROR_RECV_COLLISION);
+	if (bounded) {
+		t->start = wiznetGetSocketRXState(socket, &rsr);
+		t->limit = t->start + rsr;
+		t->flags = WIZNET_RX_LIMIT;
+		wiznetNoteRXUsage(socket, rsr);
+	} else {
+		t->start = wiznetGetSocketRXReadPointer(socket);
+		t->flags = 0;
+	}
+	t->cur = t->start;
+	t->active = 1;
+	*rx = t;
+	return WIZNET_SUCCESS;
+}
+
+/* This function returns how many received bytes lie past the cursor of a
+** receive transaction, reading Sn_RX_RSR the first time it is needed
+*/
+static uint16_t wiznetRxAvailable(struct wiznetTransaction* rx) {
+	if (!(rx->flags & WIZNET_RX_LIMIT)) {
+		rx->limit = rx->start + wiznetGetSocketRXReceivedSize(rx->socket);
+		rx->flags |= WIZNET_RX_LIMIT;
+		wiznetNoteRXUsage(rx->socket, rx->limit - rx->start);
+	}
+	return rx->limit - rx->cur;
+}
+
+/* This function drops the known frame end once the cursor has moved past it
+** into the next frame, so that a commit does not jump back to it
+*/
+static void wiznetRxPassedEnd(struct wiznetTransaction* rx) {
+	if ((rx->flags & WIZNET_RX_END) && (int16_t)(rx->cur - rx->frameEnd) > 0)
+		rx->flags &= ~WIZNET_RX_END;
+}
+
+/* This function begins a receive transaction on a socket and hands back its
+** handle. Each socket has one receive handle.
+**
+** socket - socket whose reception buffer should be read from
+** rx     - set to the handle for the transaction
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_RECV_COLLISION if a recv was already in progress on the socket
+*/
+int wiznetRxBegin(uint8_t socket, struct wiznetTransaction** rx) {
+	return wiznetRxStart(socket, rx, 0);
+}
+
+/* This function begins a receive transaction, reading Sn_RX_RSR in the same
+** SPI transaction as Sn_RX_RD for a caller that needs the received size
+** before it reads anything
+**
+** socket   - socket whose reception buffer should be read from
+** rx       - set to the handle for the transaction
+** received - set to the number of bytes received
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_RECV_COLLISION if a recv was already in progress on the socket
+*/
+int wiznetRxBeginBounded(uint8_t socket, struct wiznetTransaction** rx, uint16_t* received) {
+	int ret;
+
+	if ((ret = wiznetRxStart(socket, rx, 1)) != WIZNET_SUCCESS)
+		return ret;
+	*received = (*rx)->limit - (*rx)->start;
+	return WIZNET_SUCCESS;
+}
+
+/* This function begins a receive transaction in SLIP mode, checking for the
+** opening end character
+**
+** socket - socket whose reception buffer should be read from
+** rx     - set to the handle for the transaction
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_RECV_COLLISION if a recv was already in progress on the socket
+**         - WIZNET_ERROR_FRAME_INCOMPLETE if no data has been received
+**         - WIZNET_ERROR_NO_SLIP_HEADER if datagram was not start with C0
+*/
+int wiznetRxBeginSLIP(uint8_t socket, struct wiznetTransaction** rx) {
+	uint8_t tmp;
+	int ret;
+
+	// The SLIP functions bound their reads by the received size
+	if ((ret = wiznetRxStart(socket, rx, 1)) != WIZNET_SUCCESS)
+		return ret;
+	if (wiznetRxAvailable(*rx) == 0) {
+		wiznetRxAbandon(*rx);
+		return WIZNET_ERROR_FRAME_INCOMPLETE;
+	}
+	wiznetRxData(*rx, &tmp, sizeof(tmp));
+	if (tmp != 0xC0) {
+		wiznetRxAbandon(*rx);
+		return WIZNET_ERROR_NO_SLIP_HEADER;
+	}
+	return WIZNET_SUCCESS;
+}
+
+/* This function reads data from the RX buffer of a receive transaction
+**
+** rx     - the transaction handle
+** buf    - byte array to which the data should be copied
+**        - if buffer is NULL, data is skipped instead
+** length - number of bytes to receive
+*/
+void wiznetRxData(struct wiznetTransaction* rx, uint8_t* buf, uint16_t length) {
+	// Skipped data never needs to cross the bus
+	if (buf == NULL) {
+		rx->cur += length;
+		wiznetRxPassedEnd(rx);
+		return;
+	}
+	wiznetIOBeginControl(rx->cur, wiznetSocketControl(rx->socket, WIZNET_BLOCK_RX, 0));
+	wiznetIOTransceiveBlock(NULL, buf, length);
+	rx->cur += length;
+	wiznetIOFinish();
+	wiznetRxPassedEnd(rx);
+}
+
+/* This function hands data from the RX buffer of a receive transaction to a
+** visitor in small chunks, holding the SPI transaction open between them, so
+** a datagram can be parsed without a buffer the size of it. The visitor may
+** return a number of bytes to skip, which moves the cursor without clocking
+** them, or a negative value to stop.
+**
+** rx      - the transaction handle
+** length  - number of bytes to visit
+** visitor - function called with each chunk
+** ctx     - passed through to the visitor
+**
+** returns - WIZNET_SUCCESS once length bytes have been visited or skipped,
+**           or WIZNET_VISIT_STOP
+**         - the visitor's own (negative) return value if it stopped
+*/
+int wiznetRxVisit(struct wiznetTransaction* rx, uint16_t length, wiznetRecvVisitor visitor, void* ctx) {
+	uint8_t chunk[WIZNET_VISIT_CHUNK];
+	uint16_t n;
+	int ret;
+
+	wiznetIOBeginControl(rx->cur, wiznetSocketControl(rx->socket, WIZNET_BLOCK_RX, 0));
+	while (length) {
+		n = (length > sizeof(chunk)) ? sizeof(chunk) : length;
+		wiznetIOTransceiveBlock(NULL, chunk, n);
+		rx->cur += n;
+		length -= n;
+		ret = visitor(ctx, chunk, n);
+		if (ret < 0) {
+			wiznetIOFinish();
+			return ret;
+		}
+		if (ret > 0) {
+			// Restart the transaction past the skipped bytes
+			wiznetIOFinish();
+			n = ((uint16_t)ret > length) ? length : (uint16_t)ret;
+			rx->cur += n;
+			length -= n;
+			if (length == 0)
+				return WIZNET_SUCCESS;
+			wiznetIOBeginControl(rx->cur, wiznetSocketControl(rx->socket, WIZNET_BLOCK_RX, 0));
+		}
+	}
+	wiznetIOFinish();
+	return WIZNET_SUCCESS;
+}
+
+/* This function reads SLIP-escaped data from the RX buffer of a receive
+** transaction, unescaping it as it goes
+**
+** rx     - the transaction handle
+** buf    - byte array to which the data should be copied
+**        - if buffer is NULL, data is skipped instead
+** length - number of unescaped bytes to receive
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_PREMATURE_SLIP_END if the datagram ended first
+**         - WIZNET_ERROR_FRAME_INCOMPLETE if the received data ran out first;
+**           the bytes read so far are consumed, and a later call carries on
+**           from there once more data has arrived
+*/
+int wiznetRxSLIPData(struct wiznetTransaction* rx, uint8_t* buf, uint16_t length) {
+	uint8_t chunk[WIZNET_SLIP_CHUNK];
+	uint8_t tmp, escaped = (rx->flags & WIZNET_RX_ESCAPE) != 0;
+	uint16_t n, i, avail;
+	int ret = WIZNET_SUCCESS;
+
+	// Raw bytes are read in chunks and unescaped in RAM. Every raw byte
+	// yields at most one output byte, so reading as many raw bytes as there
+	// are outputs still wanted never reads past the data asked for.
+	avail = wiznetRxAvailable(rx);
+	wiznetIOBeginControl(rx->cur, wiznetSocketControl(rx->socket, WIZNET_BLOCK_RX, 0));
+	while (length) {
+		n = (length > sizeof(chunk)) ? sizeof(chunk) : length;
+		if (n > avail)
+			n = avail;
+		if (n == 0) {
+			// Sn_RX_RSR is read again next time, to pick up what has arrived since
+			rx->flags &= ~WIZNET_RX_LIMIT;
+			ret = WIZNET_ERROR_FRAME_INCOMPLETE;
+			break;
+		}
+		wiznetIOTransceiveBlock(NULL, chunk, n);
+		avail -= n;
+		for (i = 0; i < n; i++) {
+			tmp = chunk[i];
+			if (escaped) {
+				if (tmp == 0xDC)
+					tmp = 0xC0;
+				else if (tmp == 0xDD)
+					tmp = 0xDB;
+				escaped = 0;
+			} else if (tmp == 0xC0) {
+				// The end of the frame is now known, so commit need not look for it
+				wiznetIOFinish();
+				rx->frameEnd = rx->cur + 1;
+				rx->flags = (rx->flags | WIZNET_RX_END) & ~WIZNET_RX_ESCAPE;
+				return WIZNET_ERROR_PREMATURE_SLIP_END;
+			} else if (tmp == 0xDB) {
+				escaped = 1;
+				rx->cur++;
+				continue;
+			}
+			if (buf != NULL)
+				*buf++ = tmp;
+			rx->cur++;
+			length--;
+		}
+	}
+	wiznetIOFinish();
+	// An ESC at the end of the data received so far applies to the next call
+	if (escaped)
+		rx->flags |= WIZNET_RX_ESCAPE;
+	else
+		rx->flags &= ~WIZNET_RX_ESCAPE;
+	wiznetRxPassedEnd(rx);
+	return ret;
+}
+
+/* This function reads one whole SLIP frame from a receive transaction,
+** unescaping it into buf, and leaves the cursor just past its closing end
+** character. Leading end characters (an opening END, or empty frames) are
+** skipped, so it can be called repeatedly to take several frames queued in
+** one TCP stream before a single commit. Nothing is read past Sn_RX_RSR.
+**
+** rx     - the transaction handle
+** buf    - byte array for the frame, or NULL to skip it
+** size   - space in buf
+** length - set to the length of the frame
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_FRAME_TOO_LONG if the frame did not fit; it is
+**           still consumed and length gives its full size
+**         - WIZNET_ERROR_FRAME_INCOMPLETE if the closing end character has
+**           not been received yet; the cursor is left where it was, so a
+**           commit releases only the frames already taken
+*/
+int wiznetRxSLIPFrame(struct wiznetTransaction* rx, uint8_t* buf, uint16_t size, uint16_t* length) {
+	uint8_t chunk[WIZNET_SLIP_CHUNK];
+	uint8_t tmp, escaped = (rx->flags & WIZNET_RX_ESCAPE) != 0, started = escaped;
+	uint16_t from = rx->cur, len = 0, avail, n, i;
+
+	avail = wiznetRxAvailable(rx);
+	wiznetIOBeginControl(rx->cur, wiznetSocketControl(rx->socket, WIZNET_BLOCK_RX, 0));
+	while (avail) {
+		n = (avail > sizeof(chunk)) ? sizeof(chunk) : avail;
+		wiznetIOTransceiveBlock(NULL, chunk, n);
+		avail -= n;
+		for (i = 0; i < n; i++) {
+			tmp = chunk[i];
+			rx->cur++;
+			if (tmp == 0xC0) {
+				if (!started)
+					continue;
+				wiznetIOFinish();
+				rx->frameEnd = rx->cur;
+				rx->flags = (rx->flags | WIZNET_RX_END) & ~WIZNET_RX_ESCAPE;
+				*length = len;
+				return (len > size) ? WIZNET_ERROR_FRAME_TOO_LONG : WIZNET_SUCCESS;
+			}
+			started = 1;
+			if (escaped) {
+				if (tmp == 0xDC)
+					tmp = 0xC0;
+				else if (tmp == 0xDD)
+					tmp = 0xDB;
+				escaped = 0;
+			} else if (tmp == 0xDB) {
+				escaped = 1;
+				continue;
+			}
+			if (buf != NULL && len < size)
+				buf[len] = tmp;
+			len++;
+		}
+	}
+	wiznetIOFinish();
+	rx->cur = from;
+	return WIZNET_ERROR_FRAME_INCOMPLETE;
+}
+
+/* This function reads a UDP header from a receive transaction
+**
+** rx    - the transaction handle
+** sIP   - an array to which the source IP will be stored (NULL to discard)
+** sPort - variable to which the source port will be stored (NULL to discard)
+**
+** returns - the length of the data in the datagram
+*/
+uint16_t wiznetRxHeaderUDP(struct wiznetTransaction* rx, uint8_t* sIP, uint16_t* sPort) {
+	uint8_t header[8];
+
+	wiznetRxData(rx, header, sizeof(header));
+	wiznetSocketStatInc(rx->socket, datagrams);
+	if (sIP != NULL) {
+		sIP[0] = header[0];
+		sIP[1] = header[1];
+		sIP[2] = header[2];
+		sIP[3] = header[3];
+	}
+	if (sPort != NULL)
+		*sPort = (((uint16_t)header[4])<<8) + header[5];
+	return (((uint16_t)header[6])<<8) + header[7];
+}
+
+/* This function ends a receive transaction, releasing the data read to the chip
+**
+** rx  - the transaction handle
+** len - length of the UDP datagram to skip past, or zero to release up to the
+**       current position of a stream socket
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_NOT_RECVING if the transaction was not in progress
+*/
+int wiznetRxCommit(struct wiznetTransaction* rx, uint16_t len) {
+	if (!rx->active)
+		return WIZNET_ERROR_NOT_RECVING;
+
+	// The read pointer at the start of the transaction is kept, so skipping
+	// to the end of a datagram needs no register read.
+	if (len != 0)
+		rx->cur = rx->start + len + 8;
+	wiznetSocketStatAdd(rx->socket, bytesReceived, (uint16_t)(rx->cur - rx->start));
+
+	wiznetSetSocketRXReadPointer(rx->socket, rx->cur);
+	wiznetSocketCommand(rx->socket, Sn_CR_RECEIVE);
+	rx->active = 0;
+	return WIZNET_SUCCESS;
+}
+
+/* This function ends a receive transaction past all the data received,
+** whether it has been read or not
+**
+** rx - the transaction handle
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_NOT_RECVING if the transaction was not in progress
+*/
+int wiznetRxCommitAll(struct wiznetTransaction* rx) {
+	if (!rx->active)
+		return WIZNET_ERROR_NOT_RECVING;
+	wiznetRxAvailable(rx);
+	rx->cur = rx->limit;
+	return wiznetRxCommit(rx, 0);
+}
+
+/* This function commits a receive transaction just past the end of the
+** current frame: straight there if it is known, otherwise past the next
+** delimiter found before the end of the received data.
+*/
+static int wiznetRxCommitPast(struct wiznetTransaction* rx, uint8_t delimiter) {
+	uint8_t chunk[WIZNET_SLIP_CHUNK];
+	uint16_t from = rx->cur, avail, n, i;
+
+	if (rx->flags & WIZNET_RX_END) {
+		rx->cur = rx->frameEnd;
+		return wiznetRxCommit(rx, 0);
+	}
+
+	avail = wiznetRxAvailable(rx);
+	wiznetIOBeginControl(rx->cur, wiznetSocketControl(rx->socket, WIZNET_BLOCK_RX, 0));
+	while (avail) {
+		n = (avail > sizeof(chunk)) ? sizeof(chunk) : avail;
+		wiznetIOTransceiveBlock(NULL, chunk, n);
+		avail -= n;
+		for (i = 0; i < n; i++)
+			if (chunk[i] == delimiter) {
+				wiznetIOFinish();
+				rx->cur += i + 1;
+				return wiznetRxCommit(rx, 0);
+			}
+		rx->cur += n;
+	}
+	wiznetIOFinish();
+	rx->cur = from;
+	rx->flags &= ~WIZNET_RX_LIMIT;
+	return WIZNET_ERROR_FRAME_INCOMPLETE;
+}
+
+/* This function ends a SLIP receive transaction just past the closing end
+** character. If it has already been seen the commit jumps straight there,
+** otherwise the rest of the frame is scanned, no further than Sn_RX_RSR.
+**
+** rx - the transaction handle
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_NOT_RECVING if the transaction was not in progress
+**         - WIZNET_ERROR_FRAME_INCOMPLETE if the end has not been received
+**           yet; the transaction is left open
+*/
+int wiznetRxCommitSLIP(struct wiznetTransaction* rx) {
+	if (!rx->active)
+		return WIZNET_ERROR_NOT_RECVING;
+
+	return wiznetRxCommitPast(rx, 0xC0);
+}
+
+/* This function abandons a receive transaction without moving to the next packet
+**
+** rx - the transaction handle
+*/
+int wiznetRxAbandon(struct wiznetTransaction* rx) {
+	rx->active = 0;
+	return WIZNET_SUCCESS;
+}
+
+/* This function receives as many whole UDP datagrams as are waiting, up to
+** count, with one read of Sn_RX_RSR and a single RECEIVE for the lot. Each
+** payload is read in the same SPI transaction as the header that follows
+** it. A payload longer than its descriptor's buffer is truncated; length
+** still reports its full size.
+**
+** socket - the UDP socket to read from
+** dgrams - array of descriptors; data and size must be filled in
+** count  - number of descriptors
+**
+** returns - number of datagrams received
+**         - WIZNET_ERROR_RECV_COLLISION if a recv was already in progress on the socket
+*/
+int wiznetRecvBatch(uint8_t socket, struct wiznetDatagram* dgrams, uint8_t count) {
+	struct wiznetTransaction* rx;
+	struct wiznetDatagram* d;
+	uint8_t header[8];
+	uint16_t remaining, copy;
+	uint8_t n = 0, open;
+
+	rx = &wiznetRecvTransactions[socket];
+	if (rx->active)
+		return wiznetCollision(socket, WIZNET_ERROR_RECV_COLLISION);
+
+	// Sn_RX_RSR and Sn_RX_RD are adjacent and read together
+	rx->start = wiznetGetSocketRXState(socket, &remaining);
+	wiznetNoteRXUsage(socket, remaining);
+	if (remaining < sizeof(header) || count == 0)
+		return 0;
+	rx->cur = rx->start;
+	rx->active = 1;
+
+	wiznetIOBeginControl(rx->cur, wiznetSocketControl(socket, WIZNET_BLOCK_RX, 0));
+	wiznetIOTransceiveBlock(NULL, header, sizeof(header));
+	open = 1;
+	while (1) {
+		d = &dgrams[n];
+		d->ip[0] = header[0];
+		d->ip[1] = header[1];
+		d->ip[2] = header[2];
+		d->ip[3] = header[3];
+		d->port = (((uint16_t)header[4])<<8) + header[5];
+		d->length = (((uint16_t)header[6])<<8) + header[7];
+		if ((uint32_t)d->length + sizeof(header) > remaining)
+			break;
+		rx->cur += sizeof(header);
+
+		copy = (d->length > d->size) ? d->size : d->length;
+		if (!open) {
+			wiznetIOBeginControl(rx->cur, wiznetSocketControl(socket, WIZNET_BLOCK_RX, 0));
+			open = 1;
+		}
+		wiznetIOTransceiveBlock(NULL, d->data, copy);
+		rx->cur += copy;
+		if (copy < d->length) {
+			// The rest of the payload is skipped by restarting past it
+			wiznetIOFinish();
+			open = 0;
+			rx->cur += d->length - copy;
+		}
+		remaining -= sizeof(header) + d->length;
+		if (++n == count || remaining < sizeof(header))
+			break;
+
+		if (!open) {
+			wiznetIOBeginControl(rx->cur, wiznetSocketControl(socket, WIZNET_BLOCK_RX, 0));
+			open = 1;
+		}
+		wiznetIOTransceiveBlock(NULL, header, sizeof(header));
+	}
+	if (open)
+		wiznetIOFinish();
+
+	if (n == 0) {
+		wiznetRxAbandon(rx);
+		return 0;
+	}
+	wiznetSocketStatAdd(socket, datagrams, n);
+	wiznetRxCommit(rx, 0);
+	return n;
+}
+
+/* This function reads the 2-byte header the chip stores in front of each
+** frame received on a MACRAW socket. The frame is not counted in the
+** socket's stats, as it may turn out not to have arrived whole; the caller
+** counts the frames it commits.
+**
+** rx - the transaction handle
+**
+** returns - the length of the Ethernet frame that follows. A length that
+**           fails wiznetMACRAWValid means the buffer has lost its place
+**           among the frames, and all the data waiting should be dropped
+**           with wiznetRxCommitAll.
+*/
+uint16_t wiznetRxHeaderMACRAW(struct wiznetTransaction* rx) {
+	uint8_t header[2];
+
+	wiznetRxData(rx, header, sizeof(header));
+	return wiznetMACRAWLength(header);
+}
+
+/* This function receives as many whole Ethernet frames as are waiting on a
+** MACRAW socket, up to count, with one read of Sn_RX_RSR and a single
+** RECEIVE for the lot. Each frame is read in the same SPI transaction as
+** the header that follows it. A frame longer than its descriptor's buffer
+** is truncated; length still reports its full size.
+**
+** A header giving a length no Ethernet frame can have means the RX buffer
+** has lost its place among the frames. The frames before it are returned,
+** and the next call drops all the data waiting. The chip only ever writes
+** whole frames, so the frame after that is found where it should be.
+**
+** socket - the MACRAW socket to read from
+** frames - array of descriptors; data and size must be filled in
+** count  - number of descriptors
+**
+** returns - number of frames received
+**         - WIZNET_ERROR_RECV_COLLISION if a recv was already in progress on the socket
+**         - WIZNET_ERROR_FRAME_CORRUPT if the data waiting was dropped
+*/
+int wiznetRecvMACRAWBatch(uint8_t socket, struct wiznetRawFrame* frames, uint8_t count) {
+	struct wiznetTransaction* rx;
+	struct wiznetRawFrame* f;
+	uint8_t header[2];
+	uint16_t remaining, copy;
+	uint8_t n = 0, open, corrupt = 0;
+	int ret;
+
+	if ((ret = wiznetRxBeginBounded(socket, &rx, &remaining)) != WIZNET_SUCCESS)
+		return ret;
+	if (remaining < sizeof(header) || count == 0) {
+		wiznetRxAbandon(rx);
+		return 0;
+	}
+
+	wiznetIOBeginControl(rx->cur, wiznetSocketControl(socket, WIZNET_BLOCK_RX, 0));
+	wiznetIOTransceiveBlock(NULL, header, sizeof(header));
+	open = 1;
+	while (1) {
+		f = &frames[n];
+		f->length = wiznetMACRAWLength(header);
+		if (!wiznetMACRAWValid(f->length)) {
+			corrupt = 1;
+			break;
+		}
+		if ((uint32_t)f->length + sizeof(header) > remaining)
+			break;
+		rx->cur += sizeof(header);
+
+		copy = (f->length > f->size) ? f->size : f->length;
+		if (!open) {
+			wiznetIOBeginControl(rx->cur, wiznetSocketControl(socket, WIZNET_BLOCK_RX, 0));
+			open = 1;
+		}
+		wiznetIOTransceiveBlock(NULL, f->data, copy);
+		rx->cur += copy;
+		if (copy < f->length) {
+			// The rest of the frame is skipped by restarting past it
+			wiznetIOFinish();
+			open = 0;
+			rx->cur += f->length - copy;
+		}
+		remaining -= sizeof(header) + f->length;
+		if (++n == count || remaining < sizeof(header))
+			break;
+
+		if (!open) {
+			wiznetIOBeginControl(rx->cur, wiznetSocketControl(socket, WIZNET_BLOCK_RX, 0));
+			open = 1;
+		}
+		wiznetIOTransceiveBlock(NULL, header, sizeof(header));
+	}
+	if (open)
+		wiznetIOFinish();
+
+	if (n == 0 && corrupt) {
+		wiznetRxCommitAll(rx);
+		return WIZNET_ERROR_FRAME_CORRUPT;
+	}
+	if (n == 0) {
+		wiznetRxAbandon(rx);
+		return 0;
+	}
+	wiznetSocketStatAdd(socket, datagrams, n);
+	wiznetRxCommit(rx, 0);
+	return n;
+}
+
+/* This function hands the Ethernet frames waiting on a MACRAW socket, up to
+** count, to a visitor without copying them out, with a single RECEIVE for
+** the lot. Each frame is passed in pieces as for wiznetRxVisit, followed by
+** a call with data NULL and length 0 to mark its end. A visitor returning a
+** negative value stops the walk after the current frame. A header that
+** fails wiznetMACRAWValid is handled as by wiznetRecvMACRAWBatch.
+**
+** socket  - the MACRAW socket to read from
+** visitor - function called with each piece of each frame
+** ctx     - passed to the visitor
+** count   - most frames to visit
+**
+** returns - number of frames visited
+**         - WIZNET_ERROR_RECV_COLLISION if a recv was already in progress on the socket
+**         - WIZNET_ERROR_FRAME_CORRUPT if the data waiting was dropped
+*/
+int wiznetRecvMACRAWVisit(uint8_t socket, wiznetRecvVisitor visitor, void* ctx, uint8_t count) {
+	struct wiznetTransaction* rx;
+	uint16_t remaining, length, end;
+	uint8_t n = 0, corrupt = 0;
+	int ret;
+
+	if ((ret = wiznetRxBeginBounded(socket, &rx, &remaining)) != WIZNET_SUCCESS)
+		return ret;
+
+	while (n < count && remaining >= 2) {
+		length = wiznetRxHeaderMACRAW(rx);
+		corrupt = !wiznetMACRAWValid(length);
+		if (corrupt || (uint32_t)length + 2 > remaining) {
+			rx->cur -= 2;
+			break;
+		}
+		end = rx->cur + length;
+		ret = wiznetRxVisit(rx, length, visitor, ctx);
+		if (ret == WIZNET_SUCCESS)
+			ret = visitor(ctx, NULL, 0);
+		rx->cur = end;
+		remaining -= length + 2;
+		n++;
+		if (ret < 0)
+			break;
+	}
+
+	if (n == 0 && corrupt) {
+		wiznetRxCommitAll(rx);
+		return WIZNET_ERROR_FRAME_CORRUPT;
+	}
+	if (n == 0) {
+		wiznetRxAbandon(rx);
+		return 0;
+	}
+	wiznetSocketStatAdd(socket, datagrams, n);
+	wiznetRxCommit(rx, 0);
+	return n;
+}
+
+/* This function sends an Ethernet frame gathered from several fragments on
+** a MACRAW socket without waiting for it to go out, so the next frame can
+** be written while this one is on the wire. The frame is written behind the
+** one still in flight unless Sn_TX_FSR is too small for it, in which case
+** that one is waited for first. The outcome is collected as for
+** wiznetSendToCommitAsync.
+**
+** socket - the MACRAW socket to send on
+** iov    - array of fragments, from the destination MAC address on
+** count  - number of fragments
+**
+** returns - WIZNET_SUCCESS if the send was started
+**         - WIZNET_IN_PROGRESS if Sn_TX_FSR is still too small with no send in
+**           flight; nothing was written
+**         - WIZNET_ERROR_SEND_COLLISION if a send was already in progress on the socket
+**         - WIZNET_ERROR_FRAME_TOO_LONG if the frame is larger than the TX memory
+*/
+int wiznetSendMACRAWV(uint8_t socket, const struct wiznetIOVec* iov, uint8_t count) {
+	struct wiznetTransaction* tx = &wiznetSendTransactions[socket];
+	uint32_t length = 0;
+	uint8_t i;
+	int ret;
+
+	if (tx->active)
+		return wiznetCollision(socket, WIZNET_ERROR_SEND_COLLISION);
+	for (i = 0; i < count; i++)
+		length += iov[i].length;
+	if (length > wiznetTXMemSize[socket])
+		return WIZNET_ERROR_FRAME_TOO_LONG;
+	if (wiznetGetSocketTXFreeSize(socket) < length) {
+		if (wiznetSendPending & (1 << socket))
+			wiznetSendWait(socket);
+		if (wiznetGetSocketTXFreeSize(socket) < length)
+			return WIZNET_IN_PROGRESS;
+	}
+	if ((ret = wiznetTxBegin(socket, &tx)) != WIZNET_SUCCESS)
+		return ret;
+	wiznetTxDataV(tx, iov, count);
+	return wiznetTxCommitAsync(tx);
+}
+
+/* This function sends an Ethernet frame on a MACRAW socket without waiting
+** for it to go out, see wiznetSendMACRAWV
+**
+** socket - the MACRAW socket to send on
+** frame  - the whole frame, from the destination MAC address on
+** length - length of the frame
+**
+** returns - WIZNET_SUCCESS if the send was started
+**         - WIZNET_IN_PROGRESS if Sn_TX_FSR is still too small with no send in
+**           flight; nothing was written
+**         - WIZNET_ERROR_SEND_COLLISION if a send was already in progress on the socket
+**         - WIZNET_ERROR_FRAME_TOO_LONG if the frame is larger than the TX memory
+*/
+int wiznetSendMACRAW(uint8_t socket, const uint8_t* frame, uint16_t length) {
+	struct wiznetIOVec iov;
+
+	iov.base = frame;
+	iov.length = length;
+	return wiznetSendMACRAWV(socket, &iov, 1);
+}
+
+/* This function copies data from a receive transaction straight into a send
+** transaction, for relaying between sockets. Data passes through a small
+** buffer on the stack rather than one sized for the whole packet.
+**
+** rx     - the transaction to read from
+** tx     - the transaction to write to
+** length - number of bytes to copy
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_NOT_RECVING or WIZNET_ERROR_NOT_SENDING if either
+**           transaction was not in progress
+*/
+int wiznetForward(struct wiznetTransaction* rx, struct wiznetTransaction* tx, uint16_t length) {
+	uint8_t chunk[WIZNET_FORWARD_CHUNK];
+	uint16_t n;
+
+	if (!rx->active)
+		return WIZNET_ERROR_NOT_RECVING;
+	if (!tx->active)
+		return WIZNET_ERROR_NOT_SENDING;
+	while (length) {
+		n = (length > sizeof(chunk)) ? sizeof(chunk) : length;
+		wiznetRxData(rx, chunk, n);
+		wiznetTxData(tx, chunk, n);
+		length -= n;
+	}
+	return WIZNET_SUCCESS;
+}
+
+/* This function chooses the framing used on a socket by the wiznet*Frame
+** functions
+**
+** socket  - socket number
+** framing - WIZNET_FRAMING_NONE, _SLIP, _COBS or _LEN16
+*/
+void wiznetSetSocketFraming(uint8_t socket, uint8_t framing) {
+	wiznetSocketFraming[socket] = framing;
+}
+
+/* This function counts the bytes at the start of buf, up to max, before the
+** first zero
+*/
+static uint16_t wiznetCOBSRun(const uint8_t* buf, uint16_t length, uint16_t max) {
+	uint16_t run = 0;
+	if (length > max)
+		length = max;
+	while (run < length && buf[run] != 0x00)
+		run++;
+	return run;
+}
+
+/* This function begins a send transaction in COBS mode. The first code byte
+** is left to be written once its group is known.
+**
+** socket - the socket number on which to send
+** tx     - set to the handle for the transaction
+*/
+int wiznetTxBeginCOBS(uint8_t socket, struct wiznetTransaction** tx) {
+	int ret;
+	if ((ret = wiznetTxBegin(socket, tx)) != WIZNET_SUCCESS)
+		return ret;
+	(*tx)->mark = (*tx)->cur++;
+	(*tx)->code = 1;
+	return WIZNET_SUCCESS;
+}
+
+/* This function COBS-encodes data into the TX buffer of a send transaction.
+** Groups that begin and end within buf are written code byte first, as
+** their length is known, so only the group left open by the last call needs
+** its code byte patched: at most one extra write per call.
+**
+** tx     - the transaction handle
+** buf    - byte array containing the data
+** length - number of bytes in buf
+*/
+void wiznetTxCOBSData(struct wiznetTransaction* tx, const uint8_t* buf, uint16_t length) {
+	uint16_t run, patchPos;
+	uint8_t code, patchCode;
+
+	if (length == 0)
+		return;
+	wiznetIOBeginControl(tx->cur, wiznetSocketControl(tx->socket, WIZNET_BLOCK_TX, 1));
+
+	// Carry on with the group left open by the last call
+	run = wiznetCOBSRun(buf, length, 0xFF - tx->code);
+	wiznetIOTransceiveBlock(buf, NULL, run);
+	tx->cur += run;
+	tx->code += run;
+	buf += run;
+	length -= run;
+	if (length == 0 && tx->code < 0xFF) {
+		wiznetIOFinish();
+		return;
+	}
+	patchPos = tx->mark;
+	patchCode = tx->code;
+	if (tx->code < 0xFF) {
+		buf++;
+		length--;
+	}
+
+	// Whole groups, then the one that stays open for the next call
+	while (1) {
+		run = wiznetCOBSRun(buf, length, 0xFE);
+		code = run + 1;
+		if (run == length && code < 0xFF) {
+			tx->mark = tx->cur;
+			tx->code = code;
+		}
+		wiznetIOTransceiveBlock(&code, NULL, 1);
+		wiznetIOTransceiveBlock(buf, NULL, run);
+		tx->cur += 1 + run;
+		if (run == length && code < 0xFF)
+			break;
+		buf += run;
+		length -= run;
+		if (code < 0xFF) {
+			buf++;
+			length--;
+		}
+	}
+	wiznetIOFinish();
+
+	wiznetIOBeginControl(patchPos, wiznetSocketControl(tx->socket, WIZNET_BLOCK_TX, 1));
+	wiznetIOTransceiveBlock(&patchCode, NULL, 1);
+	wiznetIOFinish();
+}
+
+/* This function writes the last code byte and the zero delimiter, then commits
+**
+** tx - the transaction handle
+**
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
+*/
+int wiznetTxCommitCOBS(struct wiznetTransaction* tx) {
+	uint8_t delimiter = 0x00;
+	if (!tx->active)
+		return WIZNET_ERROR_NOT_SENDING;
+	wiznetIOBeginControl(tx->mark, wiznetSocketControl(tx->socket, WIZNET_BLOCK_TX, 1));
+	wiznetIOTransceiveBlock(&tx->code, NULL, 1);
+	wiznetIOFinish();
+	wiznetTxData(tx, &delimiter, sizeof(delimiter));
+	return wiznetTxCommit(tx);
+}
+
+/* This function reads one whole COBS frame from a receive transaction. Each
+** group's run is read straight into buf, so decoding needs no staging
+** buffer. Leading zero delimiters are skipped, so it can be called
+** repeatedly to take several queued frames before a single commit.
+**
+** rx     - the transaction handle
+** buf    - byte array for the frame, or NULL to skip it
+** size   - space in buf
+** length - set to the length of the frame
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_FRAME_TOO_LONG if the frame did not fit; it is
+**           still consumed and length gives its full size
+**         - WIZNET_ERROR_FRAME_INCOMPLETE if the delimiter has not been
+**           received yet; the cursor is left where it was
+*/
+int wiznetRxCOBSFrame(struct wiznetTransaction* rx, uint8_t* buf, uint16_t size, uint16_t* length) {
+	uint16_t from = rx->cur, len = 0, avail, n, room;
+	uint8_t code = 0x00, zero = 0;
+
+	avail = wiznetRxAvailable(rx);
+	wiznetIOBeginControl(rx->cur, wiznetSocketControl(rx->socket, WIZNET_BLOCK_RX, 0));
+	while (code == 0x00) {
+		if (avail == 0)
+			goto incomplete;
+		wiznetIOTransceiveBlock(NULL, &code, 1);
+		rx->cur++;
+		avail--;
+	}
+	while (1) {
+		if (zero) {
+			if (buf != NULL && len < size)
+				buf[len] = 0x00;
+			len++;
+		}
+		n = code - 1;
+		if (n >= avail)
+			goto incomplete;
+		room = (buf != NULL && len < size) ? size - len : 0;
+		if (room > n)
+			room = n;
+		wiznetIOTransceiveBlock(NULL, buf != NULL ? buf + len : NULL, room);
+		wiznetIOTransceiveBlock(NULL, NULL, n - room);
+		rx->cur += n + 1;
+		avail -= n + 1;
+		len += n;
+		zero = (code < 0xFF);
+
+		wiznetIOTransceiveBlock(NULL, &code, 1);
+		if (code == 0x00)
+			break;
+	}
+	wiznetIOFinish();
+	rx->frameEnd = rx->cur;
+	rx->flags |= WIZNET_RX_END;
+	*length = len;
+	return (len > size) ? WIZNET_ERROR_FRAME_TOO_LONG : WIZNET_SUCCESS;
+
+incomplete:
+	wiznetIOFinish();
+	rx->cur = from;
+	return WIZNET_ERROR_FRAME_INCOMPLETE;
+}
+
+/* This function ends a COBS receive transaction just past the zero delimiter
+**
+** rx - the transaction handle
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_NOT_RECVING if the transaction was not in progress
+**         - WIZNET_ERROR_FRAME_INCOMPLETE if the end has not been received
+**           yet; the transaction is left open
+*/
+int wiznetRxCommitCOBS(struct wiznetTransaction* rx) {
+	if (!rx->active)
+		return WIZNET_ERROR_NOT_RECVING;
+	return wiznetRxCommitPast(rx, 0x00);
+}
+
+/* This function begins a send transaction in length-prefixed mode. Room is
+** left for the 16-bit big-endian length, which is filled in on commit.
+**
+** socket - the socket number on which to send
+** tx     - set to the handle for the transaction
+*/
+int wiznetTxBeginLen16(uint8_t socket, struct wiznetTransaction** tx) {
+	int ret;
+	if ((ret = wiznetTxBegin(socket, tx)) != WIZNET_SUCCESS)
+		return ret;
+	(*tx)->mark = (*tx)->cur;
+	(*tx)->cur += 2;
+	return WIZNET_SUCCESS;
+}
+
+/* This function writes the length prefix and commits
+**
+** tx - the transaction handle
+**
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
+*/
+int wiznetTxCommitLen16(struct wiznetTransaction* tx) {
+	uint16_t length = tx->cur - tx->mark - 2;
+	uint8_t prefix[2] = {BYTE1(length), BYTE0(length)};
+	if (!tx->active)
+		return WIZNET_ERROR_NOT_SENDING;
+	wiznetIOBeginControl(tx->mark, wiznetSocketControl(tx->socket, WIZNET_BLOCK_TX, 1));
+	wiznetIOTransceiveBlock(prefix, NULL, sizeof(prefix));
+	wiznetIOFinish();
+	return wiznetTxCommit(tx);
+}
+
+/* This function reads the length prefix of the next frame at the cursor of
+** a receive transaction and checks the whole frame has arrived. The cursor
+** is left at the payload and the end of the frame is recorded.
+*/
+static int wiznetRxLen16Header(struct wiznetTransaction* rx, uint16_t* length) {
+	uint8_t prefix[2];
+	uint16_t avail = wiznetRxAvailable(rx);
+
+	if (avail < sizeof(prefix))
+		return WIZNET_ERROR_FRAME_INCOMPLETE;
+	wiznetIOBeginControl(rx->cur, wiznetSocketControl(rx->socket, WIZNET_BLOCK_RX, 0));
+	wiznetIOTransceiveBlock(NULL, prefix, sizeof(prefix));
+	wiznetIOFinish();
+	*length = (((uint16_t)prefix[0]) << 8) + prefix[1];
+	if (avail - sizeof(prefix) < *length)
+		return WIZNET_ERROR_FRAME_INCOMPLETE;
+	rx->cur += sizeof(prefix);
+	rx->frameEnd = rx->cur + *length;
+	rx->flags |= WIZNET_RX_END;
+	return WIZNET_SUCCESS;
+}
+
+/* This function begins a receive transaction in length-prefixed mode. The
+** payload is then read with wiznetRxData, which may stop short, as commit
+** goes straight to the end of the frame.
+**
+** socket - socket whose reception buffer should be read from
+** rx     - set to the handle for the transaction
+** length - set to the length of the payload
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_RECV_COLLISION if a recv was already in progress on the socket
+**         - WIZNET_ERROR_FRAME_INCOMPLETE if the whole frame has not arrived yet
+*/
+int wiznetRxBeginLen16(uint8_t socket, struct wiznetTransaction** rx, uint16_t* length) {
+	int ret;
+
+	if ((ret = wiznetRxStart(socket, rx, 1)) != WIZNET_SUCCESS)
+		return ret;
+	if ((ret = wiznetRxLen16Header(*rx, length)) != WIZNET_SUCCESS)
+		wiznetRxAbandon(*rx);
+	return ret;
+}
+
+/* This function reads one whole length-prefixed frame from a receive
+** transaction, so several queued frames can be taken before a single commit
+**
+** rx     - the transaction handle
+** buf    - byte array for the frame, or NULL to skip it
+** size   - space in buf
+** length - set to the length of the frame
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_FRAME_TOO_LONG if the frame did not fit; it is
+**           still consumed and length gives its full size
+**         - WIZNET_ERROR_FRAME_INCOMPLETE if the whole frame has not arrived
+**           yet; the cursor is left where it was
+*/
+int wiznetRxLen16Frame(struct wiznetTransaction* rx, uint8_t* buf, uint16_t size, uint16_t* length) {
+	int ret;
+
+	if ((ret = wiznetRxLen16Header(rx, length)) != WIZNET_SUCCESS)
+		return ret;
+	wiznetRxData(rx, buf, (*length > size) ? size : *length);
+	rx->cur = rx->frameEnd;
+	return (*length > size) ? WIZNET_ERROR_FRAME_TOO_LONG : WIZNET_SUCCESS;
+}
+
+/* This function ends a length-prefixed receive transaction at the end of
+** the frame, without reading anything
+**
+** rx - the transaction handle
+*/
+int wiznetRxCommitLen16(struct wiznetTransaction* rx) {
+	return wiznetRxCommitFrame(rx);
+}
+
+/* This function begins a send transaction with the socket's framing
+**
+** socket - the socket number on which to send
+** tx     - set to the handle for the transaction
+*/
+int wiznetTxBeginFrame(uint8_t socket, struct wiznetTransaction** tx) {
+	switch (wiznetSocketFraming[socket]) {
+	case WIZNET_FRAMING_SLIP:
+		return wiznetTxBeginSLIP(socket, tx);
+	case WIZNET_FRAMING_COBS:
+		return wiznetTxBeginCOBS(socket, tx);
+	case WIZNET_FRAMING_LEN16:
+		return wiznetTxBeginLen16(socket, tx);
+	default:
+		return wiznetTxBegin(socket, tx);
+	}
+}
+
+/* This function writes data with the socket's framing
+**
+** tx     - the transaction handle
+** buf    - byte array containing the data
+** length - number of bytes in buf
+*/
+void wiznetTxFrameData(struct wiznetTransaction* tx, const uint8_t* buf, uint16_t length) {
+	switch (wiznetSocketFraming[tx->socket]) {
+	case WIZNET_FRAMING_SLIP:
+		wiznetTxSLIPData(tx, buf, length);
+		break;
+	case WIZNET_FRAMING_COBS:
+		wiznetTxCOBSData(tx, buf, length);
+		break;
+	default:
+		wiznetTxData(tx, buf, length);
+		break;
+	}
+}
+
+/* This function ends the frame with the socket's framing and commits
+**
+** tx - the transaction handle
+**
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
+*/
+int wiznetTxCommitFrame(struct wiznetTransaction* tx) {
+	switch (wiznetSocketFraming[tx->socket]) {
+	case WIZNET_FRAMING_SLIP:
+		return wiznetTxCommitSLIP(tx);
+	case WIZNET_FRAMING_COBS:
+		return wiznetTxCommitCOBS(tx);
+	case WIZNET_FRAMING_LEN16:
+		return wiznetTxCommitLen16(tx);
+	default:
+		return wiznetTxCommit(tx);
+	}
+}
+
+/* This function reads one whole frame with the socket's framing, from a
+** transaction begun with wiznetRxBegin. Without framing, everything received
+** (up to size) is one frame.
+**
+** rx     - the transaction handle
+** buf    - byte array for the frame, or NULL to skip it
+** size   - space in buf
+** length - set to the length of the frame
+**
+** returns - as for wiznetRxSLIPFrame
+*/
+int wiznetRxFrame(struct wiznetTransaction* rx, uint8_t* buf, uint16_t size, uint16_t* length) {
+	switch (wiznetSocketFraming[rx->socket]) {
+	case WIZNET_FRAMING_SLIP:
+		return wiznetRxSLIPFrame(rx, buf, size, length);
+	case WIZNET_FRAMING_COBS:
+		return wiznetRxCOBSFrame(rx, buf, size, length);
+	case WIZNET_FRAMING_LEN16:
+		return wiznetRxLen16Frame(rx, buf, size, length);
+	default:
+		*length = wiznetRxAvailable(rx);
+		if (*length > size)
+			*length = size;
+		wiznetRxData(rx, buf, *length);
+		return WIZNET_SUCCESS;
+	}
+}
+
+/* This function ends a receive transaction past the frames read with
+** wiznetRxFrame
+**
+** rx - the transaction handle
+*/
+int wiznetRxCommitFrame(struct wiznetTransaction* rx) {
+	if (!rx->active)
+		return WIZNET_ERROR_NOT_RECVING;
+	if (rx->flags & WIZNET_RX_END)
+		rx->cur = rx->frameEnd;
+	return wiznetRxCommit(rx, 0);
+}
+
+/* This function forms the first half of a transactional send in COBS mode.
+** Otherwise, it is identical to wiznetSendBegin.
+**
+** socket - the socket number on which to send
+*/
+int wiznetSendBeginCOBS(uint8_t socket) {
+	struct wiznetTransaction* tx;
+	int ret;
+
+	//Buffer is already in use, finish the other read/write first!
+	if (wiznetBufferWriteSocket > -1)
+		return wiznetCollision(socket, WIZNET_ERROR_SEND_COLLISION);
+	if ((ret = wiznetTxBeginCOBS(socket, &tx)) != WIZNET_SUCCESS)
+		return ret;
+	wiznetBufferWriteSocket = socket;
+	return WIZNET_SUCCESS;
+}
+
+/* This function is used to transfer some data into the current buffer,
+** COBS-encoding it
+**
+** buf    - byte array containing the data to send
+** length - number of bytes to send
+*/
+void wiznetSendCOBSData(const uint8_t* buf, uint16_t length) {
+	if (wiznetBufferWriteSocket > -1)
+		wiznetTxCOBSData(&wiznetSendTransactions[wiznetBufferWriteSocket], buf, length);
+}
+
+/* This function ends a COBS frame and sends it, it forms the second half of
+** a SendBeginCOBS/SendCommitCOBS transaction pair
+**
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
+*/
+int wiznetSendCommitCOBS(void) {
+	uint8_t socket = wiznetBufferWriteSocket;
+
+	if (wiznetBufferWriteSocket == -1)
+		return WIZNET_ERROR_NOT_SENDING;
+	wiznetBufferWriteSocket = -1;
+	return wiznetTxCommitCOBS(&wiznetSendTransactions[socket]);
+}
+
+/* This function forms the first half of a transactional send in
+** length-prefixed mode. Data is written with wiznetSendData.
+**
+** socket - the socket number on which to send
+*/
+int wiznetSendBeginLen16(uint8_t socket) {
+	struct wiznetTransaction* tx;
+	int ret;
+
+	//Buffer is already in use, finish the other read/write first!
+	if (wiznetBufferWriteSocket > -1)
+		return wiznetCollision(socket, WIZNET_ERROR_SEND_COLLISION);
+	if ((ret = wiznetTxBeginLen16(socket, &tx)) != WIZNET_SUCCESS)
+		return ret;
+	wiznetBufferWriteSocket = socket;
+	return WIZNET_SUCCESS;
+}
+
+/* This function fills in the length prefix and sends the frame, it forms
+** the second half of a SendBeginLen16/SendCommitLen16 transaction pair
+**
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
+*/
+int wiznetSendCommitLen16(void) {
+	uint8_t socket = wiznetBufferWriteSocket;
+
+	if (wiznetBufferWriteSocket == -1)
+		return WIZNET_ERROR_NOT_SENDING;
+	wiznetBufferWriteSocket = -1;
+	return wiznetTxCommitLen16(&wiznetSendTransactions[socket]);
+}
+
+/* This function reads one whole COBS frame from the current buffer, see
+** wiznetRxCOBSFrame
+**
+** buf    - byte array for the frame, or NULL to skip it
+** size   - space in buf
+** length - set to the length of the frame
+**
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
+*/
+int wiznetRecvCOBSFrame(uint8_t* buf, uint16_t size, uint16_t* length) {
+	if (wiznetBufferReadSocket == -1)
+		return WIZNET_ERROR_NOT_RECVING;
+	return wiznetRxCOBSFrame(&wiznetRecvTransactions[wiznetBufferReadSocket], buf, size, length);
+}
+
+/* This function is used to end the reading from a reception buffer in COBS
+** mode, just past the frame's delimiter
+**
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
+*/
+int wiznetRecvCommitCOBS(void) {
+	int ret;
+
+	if (wiznetBufferReadSocket == -1)
+		return WIZNET_ERROR_NOT_RECVING;
+	ret = wiznetRxCommitCOBS(&wiznetRecvTransactions[wiznetBufferReadSocket]);
+	if (ret != WIZNET_ERROR_FRAME_INCOMPLETE)
+		wiznetBufferReadSocket = -1;
+	return ret;
+}
+
+/* This function is used to initialize reading a length-prefixed frame from
+** the reception buffer
+**
+** socket - socket whose reception buffer should be read from
+** length - set to the length of the payload
+**
+** returns - WIZNET_SUCCESS if succesful
+**         - WIZNET_ERROR_RECV_COLLISION if a recv was already in progress
+**         - WIZNET_ERROR_FRAME_INCOMPLETE if the whole frame has not arrived yet
+*/
+int wiznetRecvBeginLen16(uint8_t socket, uint16_t* length) {
+	struct wiznetTransaction* rx;
+	int ret;
+
+	//Buffer is already in use, finish the other read/write first!
+	if (wiznetBufferReadSocket > -1)
+		return wiznetCollision(socket, WIZNET_ERROR_RECV_COLLISION);
+	if ((ret = wiznetRxBeginLen16(socket, &rx, length)) != WIZNET_SUCCESS)
+		return ret;
+	wiznetBufferReadSocket = socket;
+	return WIZNET_SUCCESS;
+}
+
+/* This function is used to end the reading of a length-prefixed frame. The
+** end of the frame is known, so nothing is read.
+**
+** returns - WIZNET_SUCCESS if succesful, error code otherwise
+*/
+int wiznetRecvCommitLen16(void) {
+	uint8_t socket = wiznetBufferReadSocket;
+
+	if (wiznetBufferReadSocket == -1)
+		return WIZNET_ERROR_NOT_RECVING;
+	wiznetBufferReadSocket = -1;
+	return wiznetRxCommitLen16(&wiznetRecvTransactions[socket]);
+}
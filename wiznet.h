@@ -1,9 +1,21 @@
+#ifndef WIZNET_H
+#define WIZNET_H
 #include <stdint.h>
 #define WIZNET_MAX_SOCKETS 8
 #define WIZNET_MAX_BUFFER_SIZE 0x4000
+#ifndef WIZNET_FORWARD_CHUNK
+#define WIZNET_FORWARD_CHUNK 32    //Stack buffer used by wiznetForward
+#endif
+#ifndef WIZNET_SLIP_CHUNK
+#define WIZNET_SLIP_CHUNK 16       //Stack buffer used to unescape SLIP data
+#endif
+#ifndef WIZNET_VISIT_CHUNK
+#define WIZNET_VISIT_CHUNK 16      //Stack buffer used by wiznetRxVisit
+#endif
 
 enum {
 	WIZNET_SUCCESS = 0,
+	WIZNET_IN_PROGRESS = 1,
 	WIZNET_ERROR_SOCKET_OPEN = -1,
 	WIZNET_ERROR_UNKNOWN_PROTOCOL = -2,
 	WIZNET_ERROR_SOCKET_NOT_READY = -3,
@@ -15,30 +27,166 @@ enum {
 	WIZNET_ERROR_RECV_DATA = -9,
 	WIZNET_ERROR_RECV_COLLISION = -10,
 	WIZNET_ERROR_NO_SLIP_HEADER = -11,
-	WIZNET_ERROR_PREMATURE_SLIP_END = -12
+	WIZNET_ERROR_PREMATURE_SLIP_END = -12,
+	WIZNET_VISIT_STOP = -13,             //Returned by a visitor to stop early
+	WIZNET_ERROR_FRAME_INCOMPLETE = -14,
+	WIZNET_ERROR_FRAME_TOO_LONG = -15,
+	WIZNET_ERROR_BUFFER_SIZE = -16,
+	WIZNET_ERROR_FRAME_CORRUPT = -17
+};
+
+typedef void (*wiznetSendHandler)(uint8_t socket, int result);
+typedef void (*wiznetEventHandler)(uint8_t socket, uint8_t event);
+typedef int (*wiznetRecvVisitor)(void* ctx, const uint8_t* data, uint16_t length);
+#define WIZNET_POLL_FOREVER 0xFFFF    //wiznetPoll passes that never run out
+#define WIZNET_EVENT_COUNT 5    //Sn_IR flags handled by wiznetDispatchEvents
+
+/* One fragment of a gathered send
+*/
+struct wiznetIOVec {
+	const uint8_t* base;
+	uint16_t length;
+};
+
+/* One datagram received by wiznetRecvBatch. data and size are supplied by
+** the caller, the rest is filled in.
+*/
+struct wiznetDatagram {
+	uint8_t* data;
+	uint16_t size;      //Space at data
+	uint16_t length;    //Length of the datagram
+	uint8_t ip[4];
+	uint16_t port;
+};
+
+/* Use of a socket's buffers since it was last opened, kept with
+** WIZNET_ADAPTIVE_BUFFERS to size them the next time it is opened
+*/
+struct wiznetBufferStats {
+	uint16_t rxOverruns;    //Times the RX buffer was found full
+	uint16_t rxPeak;        //Most received data found waiting
+	uint16_t txStalls;      //Times wiznetSendStream ran short of TX space
+	uint16_t txPeak;        //Most data queued for one SEND
+};
+
+/* One Ethernet frame received by wiznetRecvMACRAWBatch. data and size are
+** supplied by the caller, length is filled in.
+*/
+struct wiznetRawFrame {
+	uint8_t* data;
+	uint16_t size;      //Space at data
+	uint16_t length;    //Length of the frame
+};
+
+// The MACRAW header gives the length of the header and frame together
+#define wiznetMACRAWLength(header) ((uint16_t)((((uint16_t)(header)[0])<<8) + (header)[1] - 2))
+
+// Ethernet frame lengths, without the FCS. A MACRAW header giving any other
+// length means the RX buffer has lost its place among the frames.
+#define WIZNET_MACRAW_MIN 14
+#define WIZNET_MACRAW_MAX 1514
+#define wiznetMACRAWValid(length) ((length) >= WIZNET_MACRAW_MIN && (length) <= WIZNET_MACRAW_MAX)
+
+/* Counters kept per socket with WIZNET_STATS
+*/
+struct wiznetSocketStats {
+	uint32_t bytesSent;        //Payload handed to the chip by SEND
+	uint32_t bytesReceived;    //Payload released to the chip by RECEIVE
+	uint32_t spiTransactions;  //SPI transactions on the socket's blocks
+	uint32_t spiBytes;         //Bytes clocked in those transactions
+	uint32_t waitLoops;        //Busy-wait iterations on a command, send or set-up
+	uint16_t sends;            //SEND commands issued
+	uint16_t datagrams;        //UDP datagrams or MACRAW frames received
+	uint16_t sendTimeouts;     //SENDs that ended in Sn_IR_TIMEOUT
+	uint16_t collisions;       //WIZNET_ERROR_SEND_COLLISION or RECV_COLLISION returned
+	uint16_t rxHighWater;      //Most received data found waiting
+};
+
+/* Counters kept for the chip with WIZNET_STATS
+*/
+struct wiznetStats {
+	uint32_t spiTransactions;  //Every SPI transaction, common registers included
+	uint32_t spiBytes;         //Every byte clocked
+	uint32_t chipSelects;      //Chip-select cycles
+	struct wiznetSocketStats sockets[WIZNET_MAX_SOCKETS];
+};
+
+/* A send or receive transaction in progress on one socket. Each socket has
+** one of each, handed out by wiznetTxBegin/wiznetRxBegin.
+*/
+struct wiznetTransaction {
+	uint8_t socket;
+	uint8_t active;
+	uint16_t start;    //Buffer pointer when the transaction began
+	uint16_t cur;      //Current position in the buffer
+	uint8_t flags;     //WIZNET_RX_* flags, receive only
+	uint16_t limit;    //End of the received data, if WIZNET_RX_LIMIT
+	uint16_t frameEnd; //Position just past the current frame, if WIZNET_RX_END
+	uint16_t mark;     //Pending COBS code byte or length prefix, send only
+	uint8_t code;      //Value of the pending COBS code byte
+};
+
+enum {
+	WIZNET_RX_LIMIT  = 0x01,
+	WIZNET_RX_END    = 0x02,
+	WIZNET_RX_ESCAPE = 0x04    //SLIP data stopped just after an ESC byte
+};
+
+// Flags for wiznetSendStream
+enum {
+	WIZNET_STREAM_NONBLOCK = 0x01    //Return instead of waiting for TX space
+};
+
+// Framing used on a socket by the wiznet*Frame functions
+enum {
+	WIZNET_FRAMING_NONE = 0,
+	WIZNET_FRAMING_SLIP,
+	WIZNET_FRAMING_COBS,     //Zero-delimited, one byte overhead per 254
+	WIZNET_FRAMING_LEN16     //16-bit big-endian length prefix
 };
 
 enum {
 	SOCK_UDP = 0,
-	SOCK_TCP = 1
+	SOCK_TCP = 1,
+	SOCK_MACRAW = 4    //Same value as Sn_MR_MACRAW; socket 0 only
 };
 
 void wiznetReset(void);
-void wiznetInit(uint8_t bufSize[]);
-void wiznetInitBufferSizes(uint8_t* rx, uint8_t* tx);
+#ifdef WIZNET_SHADOW_REGISTERS
+void wiznetShadowResync(void);
+#endif
+int wiznetInit(uint8_t bufSize[]);
+int wiznetInitBufferSizes(uint8_t* rx, uint8_t* tx);
+#ifdef WIZNET_ADAPTIVE_BUFFERS
+void wiznetGetBufferStats(uint8_t socket, struct wiznetBufferStats* stats);
+#endif
+#ifdef WIZNET_STATS
+void wiznetGetStats(struct wiznetStats* stats);
+void wiznetResetStats(void);
+#endif
+#ifdef WIZNET_TRACE
+#include "wiznet_trace.h"
+#endif
 
 int wiznetOpenSocket(uint8_t socket, uint8_t protocol, uint16_t port, uint8_t flags);
 void wiznetCloseSocket(uint8_t socket);
 int wiznetConnectSocket(uint8_t socket, uint8_t* destIP, uint16_t destPort);
 int wiznetListenOnSocket(uint8_t socket);
+int wiznetOpenSocketStart(uint8_t socket, uint8_t protocol, uint16_t port, uint8_t flags);
+int wiznetConnectSocketStart(uint8_t socket, uint8_t* destIP, uint16_t destPort);
+int wiznetListenOnSocketStart(uint8_t socket);
+int wiznetSocketPoll(uint8_t socket);
 
 void wiznetWaitForData(void);
+int wiznetPoll(uint8_t* readMask, uint8_t* writeMask, uint16_t passes);
 uint16_t wiznetRecvHeaderUDP(uint8_t* sIP, uint16_t* sPort);
 
 uint8_t wiznetGetSocketInts(void);
 uint8_t wiznetGetDeviceInts(void);
 void wiznetClearDeviceInts(void);
 void wiznetClearSocketRecvInt(uint8_t socket);
+void wiznetSetEventHandler(uint8_t socket, uint8_t events, wiznetEventHandler handler);
+uint8_t wiznetDispatchEvents(void);
 void wiznetGetDeviceMAC(uint8_t* MAC);
 void wiznetSetDeviceMAC(uint8_t* MAC);
 void wiznetConfigureIPLayer(uint8_t* gip, uint8_t* snm, uint8_t* sip);
@@ -49,8 +197,15 @@ int wiznetRecvCommit(uint16_t len);
 int wiznetRecvCommitSLIP(void);
 int wiznetRecvAbandon(void);
 int wiznetRecvPeek(uint8_t socket);
+int wiznetRecvBatch(uint8_t socket, struct wiznetDatagram* dgrams, uint8_t count);
+int wiznetRecvMACRAWBatch(uint8_t socket, struct wiznetRawFrame* frames, uint8_t count);
+int wiznetRecvMACRAWVisit(uint8_t socket, wiznetRecvVisitor visitor, void* ctx, uint8_t count);
+int wiznetSendMACRAW(uint8_t socket, const uint8_t* frame, uint16_t length);
+int wiznetSendMACRAWV(uint8_t socket, const struct wiznetIOVec* iov, uint8_t count);
 void wiznetRecvData(uint8_t* buf, uint16_t length);
 int wiznetRecvSLIPData(uint8_t* buf, uint16_t length);
+int wiznetRecvSLIPFrame(uint8_t* buf, uint16_t size, uint16_t* length);
+int wiznetRecvVisit(uint16_t length, wiznetRecvVisitor visitor, void* ctx);
 uint16_t wiznetGetBufferReadPosition(void);
 void wiznetSetBufferReadPosition(uint16_t pos);
 void wiznetSetRelBufferReadPosition(int16_t change);
@@ -61,9 +216,78 @@ int wiznetSendBeginSLIP(uint8_t socket);
 int wiznetSendToCommit(void);
 int wiznetSendCommit(void);
 int wiznetSendCommitSLIP(void);
+int wiznetSendToCommitAsync(void);
+int wiznetSendCommitAsync(void);
+int wiznetSendCommitSLIPAsync(void);
+int wiznetSendPoll(uint8_t socket);
+int wiznetSendWait(uint8_t socket);
+void wiznetSendReap(void);
+void wiznetSetSendCompleteHandler(wiznetSendHandler handler);
 int wiznetSendToAbandon(void);
 int wiznetSendAbandon(void);
 void wiznetSendData(const uint8_t* buf, uint16_t length);
 void wiznetSendSLIPData(const uint8_t* buf, uint16_t length);
+void wiznetSendDataV(const struct wiznetIOVec* iov, uint8_t count);
+void wiznetSendSLIPDataV(const struct wiznetIOVec* iov, uint8_t count);
+int wiznetSendToV(uint8_t socket, uint8_t* destIP, uint16_t destPort, const struct wiznetIOVec* iov, uint8_t count);
 uint16_t wiznetGetBufferWritePosition(void);
 void wiznetSetBufferWritePosition(uint16_t pos);
+
+int wiznetTxBegin(uint8_t socket, struct wiznetTransaction** tx);
+int wiznetTxBeginTo(uint8_t socket, uint8_t* destIP, uint16_t destPort, struct wiznetTransaction** tx);
+int wiznetTxBeginSLIP(uint8_t socket, struct wiznetTransaction** tx);
+void wiznetTxData(struct wiznetTransaction* tx, const uint8_t* buf, uint16_t length);
+void wiznetTxSLIPData(struct wiznetTransaction* tx, const uint8_t* buf, uint16_t length);
+void wiznetTxDataV(struct wiznetTransaction* tx, const struct wiznetIOVec* iov, uint8_t count);
+void wiznetTxSLIPDataV(struct wiznetTransaction* tx, const struct wiznetIOVec* iov, uint8_t count);
+int wiznetTxCommit(struct wiznetTransaction* tx);
+int wiznetTxCommitAsync(struct wiznetTransaction* tx);
+int wiznetTxCommitSLIP(struct wiznetTransaction* tx);
+int wiznetTxAbandon(struct wiznetTransaction* tx);
+
+int wiznetSendStream(uint8_t socket, const uint8_t* buf, uint16_t length, uint16_t* sent, uint8_t flags);
+int wiznetRxBegin(uint8_t socket, struct wiznetTransaction** rx);
+int wiznetRxBeginBounded(uint8_t socket, struct wiznetTransaction** rx, uint16_t* received);
+int wiznetRxBeginSLIP(uint8_t socket, struct wiznetTransaction** rx);
+void wiznetRxData(struct wiznetTransaction* rx, uint8_t* buf, uint16_t length);
+int wiznetRxSLIPData(struct wiznetTransaction* rx, uint8_t* buf, uint16_t length);
+int wiznetRxSLIPFrame(struct wiznetTransaction* rx, uint8_t* buf, uint16_t size, uint16_t* length);
+int wiznetRxVisit(struct wiznetTransaction* rx, uint16_t length, wiznetRecvVisitor visitor, void* ctx);
+uint16_t wiznetRxHeaderUDP(struct wiznetTransaction* rx, uint8_t* sIP, uint16_t* sPort);
+uint16_t wiznetRxHeaderMACRAW(struct wiznetTransaction* rx);
+int wiznetRxCommit(struct wiznetTransaction* rx, uint16_t len);
+int wiznetRxCommitAll(struct wiznetTransaction* rx);
+int wiznetRxCommitSLIP(struct wiznetTransaction* rx);
+int wiznetRxAbandon(struct wiznetTransaction* rx);
+
+int wiznetForward(struct wiznetTransaction* rx, struct wiznetTransaction* tx, uint16_t length);
+
+void wiznetSetSocketFraming(uint8_t socket, uint8_t framing);
+int wiznetTxBeginFrame(uint8_t socket, struct wiznetTransaction** tx);
+void wiznetTxFrameData(struct wiznetTransaction* tx, const uint8_t* buf, uint16_t length);
+int wiznetTxCommitFrame(struct wiznetTransaction* tx);
+int wiznetRxFrame(struct wiznetTransaction* rx, uint8_t* buf, uint16_t size, uint16_t* length);
+int wiznetRxCommitFrame(struct wiznetTransaction* rx);
+
+int wiznetTxBeginCOBS(uint8_t socket, struct wiznetTransaction** tx);
+void wiznetTxCOBSData(struct wiznetTransaction* tx, const uint8_t* buf, uint16_t length);
+int wiznetTxCommitCOBS(struct wiznetTransaction* tx);
+int wiznetRxCOBSFrame(struct wiznetTransaction* rx, uint8_t* buf, uint16_t size, uint16_t* length);
+int wiznetRxCommitCOBS(struct wiznetTransaction* rx);
+int wiznetSendBeginCOBS(uint8_t socket);
+void wiznetSendCOBSData(const uint8_t* buf, uint16_t length);
+int wiznetSendCommitCOBS(void);
+int wiznetRecvCOBSFrame(uint8_t* buf, uint16_t size, uint16_t* length);
+int wiznetRecvCommitCOBS(void);
+
+int wiznetTxBeginLen16(uint8_t socket, struct wiznetTransaction** tx);
+int wiznetTxCommitLen16(struct wiznetTransaction* tx);
+int wiznetRxBeginLen16(uint8_t socket, struct wiznetTransaction** rx, uint16_t* length);
+int wiznetRxLen16Frame(struct wiznetTransaction* rx, uint8_t* buf, uint16_t size, uint16_t* length);
+int wiznetRxCommitLen16(struct wiznetTransaction* rx);
+int wiznetSendBeginLen16(uint8_t socket);
+int wiznetSendCommitLen16(void);
+int wiznetRecvBeginLen16(uint8_t socket, uint16_t* length);
+int wiznetRecvCommitLen16(void);
+
+#endif
@@ -0,0 +1,389 @@
+#ifndef WIZNET_HPP
+#define WIZNET_HPP
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#if __has_include(<version>)
+#include <version>
+#endif
+#ifdef __cpp_lib_span
+#include <span>
+#endif
+
+extern "C" {
+#include "util.h"
+#include "io_assignment.h"
+#include "wiznet_arch.h"
+#include "wiznet.h"
+#include "wiznet_io.h"
+#include "wiznet_regs.h"
+}
+
+/*
+** C++17 interface
+**
+** A header-only layer over the transaction API in wiznet.h. Socket<N> bakes
+** the socket number into every call, so register accesses made through it
+** compile to a fixed control byte. SendTx and RecvTx own an open transaction
+** and abandon it when they go out of scope without being committed, so an
+** early return cannot leave a socket's handle busy. Nothing here adds SPI
+** traffic to the C calls it wraps.
+**
+**   auto tx = wiznet::Socket<1>::sendTo(ip, 5000);
+**   if (!tx)
+**       return tx.error();
+**   tx.write(header);
+**   tx.write(payload);
+**   return tx.commit();
+**
+************************************/
+
+namespace wiznet {
+
+#ifdef __cpp_lib_span
+template <typename T>
+using Span = std::span<T>;
+#else
+/* Minimal stand-in for std::span before C++20: a pointer and a length,
+** built from an array, a container with data() and size(), or another span
+** of a convertible element type.
+*/
+template <typename T>
+class Span {
+public:
+	constexpr Span() noexcept : data_(nullptr), size_(0) {}
+	constexpr Span(T* data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+	template <std::size_t N>
+	constexpr Span(T (&array)[N]) noexcept : data_(array), size_(N) {}
+
+	template <typename C, typename = std::enable_if_t<
+			!std::is_array_v<std::remove_reference_t<C>>
+			&& std::is_convertible_v<decltype(std::data(std::declval<C&>())), T*>>>
+	constexpr Span(C&& container) noexcept : data_(std::data(container)), size_(std::size(container)) {}
+
+	template <typename U, typename = std::enable_if_t<std::is_convertible_v<U (*)[], T (*)[]>>>
+	constexpr Span(const Span<U>& other) noexcept : data_(other.data()), size_(other.size()) {}
+
+	constexpr T* data() const noexcept { return data_; }
+	constexpr std::size_t size() const noexcept { return size_; }
+	constexpr bool empty() const noexcept { return size_ == 0; }
+	constexpr T* begin() const noexcept { return data_; }
+	constexpr T* end() const noexcept { return data_ + size_; }
+	constexpr T& operator[](std::size_t i) const noexcept { return data_[i]; }
+	constexpr Span subspan(std::size_t offset, std::size_t count) const noexcept { return Span(data_ + offset, count); }
+
+private:
+	T* data_;
+	std::size_t size_;
+};
+#endif
+
+template <uint8_t N>
+class Socket;
+
+/* An open send transaction. Data written is sent by commit; a transaction
+** that is destroyed, or assigned over, while still open is abandoned.
+*/
+class SendTx {
+public:
+	SendTx() noexcept = default;
+	SendTx(const SendTx&) = delete;
+	SendTx& operator=(const SendTx&) = delete;
+
+	SendTx(SendTx&& other) noexcept
+		: tx_(std::exchange(other.tx_, nullptr)), error_(other.error_), framed_(other.framed_) {}
+
+	SendTx& operator=(SendTx&& other) noexcept {
+		if (this != &other) {
+			abandon();
+			tx_ = std::exchange(other.tx_, nullptr);
+			error_ = other.error_;
+			framed_ = other.framed_;
+		}
+		return *this;
+	}
+
+	~SendTx() { abandon(); }
+
+	/* True while the transaction is open
+	*/
+	explicit operator bool() const noexcept { return tx_ != nullptr; }
+
+	/* The code returned when the transaction was begun
+	*/
+	int error() const noexcept { return error_; }
+
+	struct wiznetTransaction* handle() const noexcept { return tx_; }
+
+	/* This function writes data, with the socket's framing if the transaction
+	** was begun with sendFrame
+	*/
+	void write(Span<const uint8_t> data) noexcept {
+		if (tx_ == nullptr)
+			return;
+		if (framed_)
+			wiznetTxFrameData(tx_, data.data(), static_cast<uint16_t>(data.size()));
+		else
+			wiznetTxData(tx_, data.data(), static_cast<uint16_t>(data.size()));
+	}
+
+	/* This function writes a list of buffers, gathered into one SPI write.
+	** Not for framed transactions.
+	*/
+	void writev(Span<const struct wiznetIOVec> iov) noexcept {
+		if (tx_ != nullptr)
+			wiznetTxDataV(tx_, iov.data(), static_cast<uint8_t>(iov.size()));
+	}
+
+	/* This function sends the data written and waits for it to go out
+	**
+	** returns - as for wiznetTxCommit, or wiznetTxCommitFrame
+	*/
+	int commit() noexcept {
+		if (tx_ == nullptr)
+			return WIZNET_ERROR_NOT_SENDING;
+		int ret = framed_ ? wiznetTxCommitFrame(tx_) : wiznetTxCommit(tx_);
+		release();
+		return ret;
+	}
+
+	/* This function starts sending the data written without waiting, see
+	** wiznetTxCommitAsync. Not for framed transactions.
+	*/
+	int commitAsync() noexcept {
+		if (tx_ == nullptr)
+			return WIZNET_ERROR_NOT_SENDING;
+		int ret = wiznetTxCommitAsync(tx_);
+		release();
+		return ret;
+	}
+
+	/* This function drops the data written. Nothing is sent.
+	*/
+	void abandon() noexcept {
+		if (tx_ != nullptr)
+			wiznetTxAbandon(std::exchange(tx_, nullptr));
+	}
+
+private:
+	template <uint8_t>
+	friend class Socket;
+
+	SendTx(int error, struct wiznetTransaction* tx, bool framed) noexcept
+		: tx_(error == WIZNET_SUCCESS ? tx : nullptr), error_(error), framed_(framed) {}
+
+	void release() noexcept {
+		if (tx_ != nullptr && !tx_->active)
+			tx_ = nullptr;
+	}
+
+	struct wiznetTransaction* tx_ = nullptr;
+	int error_ = WIZNET_ERROR_NOT_SENDING;
+	bool framed_ = false;
+};
+
+/* An open receive transaction. Data read is released to the chip by commit;
+** a transaction that is destroyed, or assigned over, while still open is
+** abandoned and its data is read again next time.
+*/
+class RecvTx {
+public:
+	RecvTx() noexcept = default;
+	RecvTx(const RecvTx&) = delete;
+	RecvTx& operator=(const RecvTx&) = delete;
+
+	RecvTx(RecvTx&& other) noexcept : rx_(std::exchange(other.rx_, nullptr)), error_(other.error_) {}
+
+	RecvTx& operator=(RecvTx&& other) noexcept {
+		if (this != &other) {
+			abandon();
+			rx_ = std::exchange(other.rx_, nullptr);
+			error_ = other.error_;
+		}
+		return *this;
+	}
+
+	~RecvTx() { abandon(); }
+
+	/* True while the transaction is open
+	*/
+	explicit operator bool() const noexcept { return rx_ != nullptr; }
+
+	/* The code returned when the transaction was begun
+	*/
+	int error() const noexcept { return error_; }
+
+	struct wiznetTransaction* handle() const noexcept { return rx_; }
+
+	/* This function reads enough data to fill buf
+	*/
+	void read(Span<uint8_t> buf) noexcept {
+		if (rx_ != nullptr)
+			wiznetRxData(rx_, buf.data(), static_cast<uint16_t>(buf.size()));
+	}
+
+	/* This function moves past data without reading it over the bus
+	*/
+	void skip(uint16_t length) noexcept {
+		if (rx_ != nullptr)
+			wiznetRxData(rx_, nullptr, length);
+	}
+
+	/* This function reads the header in front of a UDP datagram
+	**
+	** ip   - set to the sender's address, or nullptr
+	** port - set to the sender's port, or nullptr
+	**
+	** returns - the length of the datagram
+	*/
+	uint16_t headerUDP(uint8_t* ip = nullptr, uint16_t* port = nullptr) noexcept {
+		if (rx_ == nullptr)
+			return 0;
+		return wiznetRxHeaderUDP(rx_, ip, port);
+	}
+
+	/* This function reads one whole frame with the socket's framing
+	**
+	** buf    - space for the frame
+	** length - set to the length of the frame
+	**
+	** returns - as for wiznetRxFrame
+	*/
+	int readFrame(Span<uint8_t> buf, uint16_t& length) noexcept {
+		if (rx_ == nullptr)
+			return WIZNET_ERROR_NOT_RECVING;
+		return wiznetRxFrame(rx_, buf.data(), static_cast<uint16_t>(buf.size()), &length);
+	}
+
+	/* This function passes data to a visitor in place, see wiznetRxVisit
+	*/
+	int visit(uint16_t length, wiznetRecvVisitor visitor, void* ctx) noexcept {
+		if (rx_ == nullptr)
+			return WIZNET_ERROR_NOT_RECVING;
+		return wiznetRxVisit(rx_, length, visitor, ctx);
+	}
+
+	/* This function releases the data read to the chip
+	**
+	** len - length of the UDP datagram to skip past, or zero to release up
+	**       to the current position of a stream socket
+	**
+	** returns - as for wiznetRxCommit
+	*/
+	int commit(uint16_t len = 0) noexcept {
+		if (rx_ == nullptr)
+			return WIZNET_ERROR_NOT_RECVING;
+		int ret = wiznetRxCommit(rx_, len);
+		release();
+		return ret;
+	}
+
+	/* This function releases the data past the frames read with readFrame.
+	** If the end of a frame has not arrived the transaction stays open.
+	**
+	** returns - as for wiznetRxCommitFrame
+	*/
+	int commitFrame() noexcept {
+		if (rx_ == nullptr)
+			return WIZNET_ERROR_NOT_RECVING;
+		int ret = wiznetRxCommitFrame(rx_);
+		release();
+		return ret;
+	}
+
+	/* This function ends the transaction without releasing anything
+	*/
+	void abandon() noexcept {
+		if (rx_ != nullptr)
+			wiznetRxAbandon(std::exchange(rx_, nullptr));
+	}
+
+private:
+	template <uint8_t>
+	friend class Socket;
+
+	RecvTx(int error, struct wiznetTransaction* rx) noexcept
+		: rx_(error == WIZNET_SUCCESS ? rx : nullptr), error_(error) {}
+
+	void release() noexcept {
+		if (rx_ != nullptr && !rx_->active)
+			rx_ = nullptr;
+	}
+
+	struct wiznetTransaction* rx_ = nullptr;
+	int error_ = WIZNET_ERROR_NOT_RECVING;
+};
+
+/* Socket N of the chip. All members are static; the type only carries the
+** socket number.
+*/
+template <uint8_t N>
+class Socket {
+	static_assert(N < WIZNET_MAX_SOCKETS, "the W5500 has 8 sockets");
+
+public:
+	static constexpr uint8_t number = N;
+
+	static int open(uint8_t protocol, uint16_t port, uint8_t flags = 0) noexcept {
+		return wiznetOpenSocket(N, protocol, port, flags);
+	}
+
+	static int connect(const uint8_t (&ip)[4], uint16_t port) noexcept {
+		return wiznetConnectSocket(N, const_cast<uint8_t*>(ip), port);
+	}
+
+	static int listen() noexcept { return wiznetListenOnSocket(N); }
+	static void close() noexcept { wiznetCloseSocket(N); }
+	static int poll() noexcept { return wiznetSocketPoll(N); }
+
+	static uint8_t status() noexcept { return wiznetGetSocketStatus(N); }
+	static uint8_t interrupts() noexcept { return wiznetGetSocketInterrupt(N); }
+	static void clearInterrupts(uint8_t interrupts) noexcept { wiznetSetSocketInterrupt(N, interrupts); }
+	static uint16_t freeSize() noexcept { return wiznetGetSocketTXFreeSize(N); }
+	static uint16_t receivedSize() noexcept { return wiznetGetSocketRXReceivedSize(N); }
+	static void setFraming(uint8_t framing) noexcept { wiznetSetSocketFraming(N, framing); }
+
+	static SendTx send() noexcept {
+		struct wiznetTransaction* tx = nullptr;
+		int ret = wiznetTxBegin(N, &tx);
+		return SendTx(ret, tx, false);
+	}
+
+	static SendTx sendTo(const uint8_t (&ip)[4], uint16_t port) noexcept {
+		struct wiznetTransaction* tx = nullptr;
+		int ret = wiznetTxBeginTo(N, const_cast<uint8_t*>(ip), port, &tx);
+		return SendTx(ret, tx, false);
+	}
+
+	/* This function begins a send with the framing set by setFraming
+	*/
+	static SendTx sendFrame() noexcept {
+		struct wiznetTransaction* tx = nullptr;
+		int ret = wiznetTxBeginFrame(N, &tx);
+		return SendTx(ret, tx, true);
+	}
+
+	static int sendWait() noexcept { return wiznetSendWait(N); }
+	static int sendPoll() noexcept { return wiznetSendPoll(N); }
+
+	/* This function streams data of any length, see wiznetSendStream
+	*/
+	static int sendStream(Span<const uint8_t> data, uint16_t& sent, uint8_t flags = 0) noexcept {
+		return wiznetSendStream(N, data.data(), static_cast<uint16_t>(data.size()), &sent, flags);
+	}
+
+	static RecvTx recv() noexcept {
+		struct wiznetTransaction* rx = nullptr;
+		int ret = wiznetRxBegin(N, &rx);
+		return RecvTx(ret, rx);
+	}
+
+	static int peek() noexcept { return wiznetRecvPeek(N); }
+};
+
+} // namespace wiznet
+
+#endif
@@ -21,3 +21,34 @@ inline uint8_t SPITransceiveByte(uint8_t data) {
 
 #endif
 
+#ifdef ARCH_HOST
+// Software model of the chip, for measuring and testing the driver on a build host
+#include "wiznet_host.h"
+static inline void wiznetEnableInterrupts(void){}
+static inline void wiznetDisableInterrupts(void){}
+
+#define wiznetSPITransceiveByte wiznetHostTransceiveByte
+#define wiznetSPIChipEnable() wiznetHostChipEnable()
+#define wiznetSPIChipDisable() wiznetHostChipDisable()
+#define wiznetSPITransceiveBlock wiznetHostTransceiveBlock
+#define wiznetINTAsserted() wiznetHostInterruptAsserted()
+#define wiznetPollIdle() wiznetHostPollIdle()
+#define wiznetTraceClock() wiznetHostClock()
+#define WIZNET_TRACE_TICK_NS 1
+
+#endif
+
+#ifdef ARCH_LINUX_SPIDEV
+// User-space driver on /dev/spidevX.Y, see wiznet_spidev.h
+#include "wiznet_spidev.h"
+static inline void wiznetEnableInterrupts(void){}
+static inline void wiznetDisableInterrupts(void){}
+
+#define wiznetSPITransceiveByte wiznetSpidevTransceiveByte
+#define wiznetSPIChipEnable() wiznetSpidevChipEnable()
+#define wiznetSPIChipDisable() wiznetSpidevChipDisable()
+#define wiznetSPITransceiveBlock wiznetSpidevTransceiveBlock
+#define wiznetSPIFlush() wiznetSpidevFlush()
+
+#endif
+
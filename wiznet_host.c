@@ -0,0 +1,930 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "wiznet_host.h"
+#include "wiznet_regs_defs.h"
+
+#define HOST_MAX_SOCKETS 8
+#define HOST_MEM_SIZE 0x4000
+#define HOST_COMMON_SIZE 0x40
+#define HOST_SOCKET_REGS_SIZE 0x30
+#define HOST_TRACE_MAX_SITES 256
+#define HOST_TRACE_MAX_READS 256
+
+/* Chip state
+*/
+static uint8_t hostCommon[HOST_COMMON_SIZE];
+static uint8_t hostSocketRegs[HOST_MAX_SOCKETS][HOST_SOCKET_REGS_SIZE];
+static uint8_t hostTXMem[HOST_MEM_SIZE];
+static uint8_t hostRXMem[HOST_MEM_SIZE];
+
+/* Asynchronous socket events (connection set-up, send completion) are held
+** back for a configurable number of transactions so that the driver's
+** polling loops are exercised.
+*/
+struct hostPendingEvent {
+	uint16_t countdown;
+	uint8_t active;
+	uint8_t status;
+	uint8_t interrupt;
+};
+static struct hostPendingEvent hostPending[HOST_MAX_SOCKETS];
+static uint16_t hostLatency;
+static uint8_t hostPeerUnreachable;
+static uint8_t hostSendFail;
+static wiznetHostSendHook hostSendHook;
+static wiznetHostIdleHook hostIdleHook;
+
+/* SPI frame decoding state
+*/
+static uint8_t hostSelected;
+static uint16_t hostPhase;
+static uint16_t hostAddr;
+static uint8_t hostCtrl;
+
+static struct wiznetHostStats hostStats;
+
+static uint16_t hostGetWord(const uint8_t* reg) {
+	return (((uint16_t)reg[0]) << 8) + reg[1];
+}
+
+static void hostSetWord(uint8_t* reg, uint16_t word) {
+	reg[0] = (uint8_t)(word >> 8);
+	reg[1] = (uint8_t)word;
+}
+
+/* This function returns the size, in bytes, of a socket's TX or RX buffer
+*/
+static uint16_t hostBufferSize(uint8_t socket, uint8_t tx) {
+	uint16_t kb = hostSocketRegs[socket][tx ? REG_Sn_TXBUF_SIZE : REG_Sn_RXBUF_SIZE];
+	return (kb > 16) ? 0 : kb * 1024;
+}
+
+/* This function returns the physical location of a socket's buffer within
+** the 16KB TX or RX memory. Buffers are allocated in socket order.
+*/
+static uint16_t hostBufferBase(uint8_t socket, uint8_t tx) {
+	uint16_t base = 0;
+	uint8_t i;
+	for (i = 0; i < socket; i++)
+		base += hostBufferSize(i, tx);
+	return base;
+}
+
+/* This function maps a socket buffer offset onto the physical memory,
+** wrapping at the end of the socket buffer as the chip does.
+*/
+static uint8_t* hostBufferByte(uint8_t socket, uint8_t tx, uint16_t offset) {
+	uint16_t size = hostBufferSize(socket, tx);
+	uint8_t* mem = tx ? hostTXMem : hostRXMem;
+	if (size == 0)
+		return NULL;
+	return &mem[(hostBufferBase(socket, tx) + (offset & (size - 1))) & (HOST_MEM_SIZE - 1)];
+}
+
+static void hostResetSocket(uint8_t socket) {
+	uint8_t* regs = hostSocketRegs[socket];
+	memset(regs, 0, HOST_SOCKET_REGS_SIZE);
+	memset(&regs[REG_Sn_DHAR], 0xFF, 6);
+	regs[REG_Sn_TTL] = 0x80;
+	regs[REG_Sn_RXBUF_SIZE] = 2;
+	regs[REG_Sn_TXBUF_SIZE] = 2;
+	hostSetWord(&regs[REG_Sn_TX_FSR], 0x0800);
+	regs[REG_Sn_IMR] = 0xFF;
+	hostSetWord(&regs[REG_Sn_FRAG], 0x4000);
+	memset(&hostPending[socket], 0, sizeof(hostPending[socket]));
+}
+
+/* This function puts the chip model into its reset state
+*/
+static void hostReset(void) {
+	uint8_t i;
+	memset(hostCommon, 0, sizeof(hostCommon));
+	hostSetWord(&hostCommon[REG_RTR], 0x07D0);
+	hostCommon[REG_RCR] = 0x08;
+	hostCommon[REG_PHYCFGR] = 0xBF;
+	hostCommon[REG_VERSIONR] = 0x04;
+	for (i = 0; i < HOST_MAX_SOCKETS; i++)
+		hostResetSocket(i);
+}
+
+/* This function recomputes the registers that the chip derives from its
+** internal state: Sn_TX_FSR, Sn_RX_RSR and SIR.
+*/
+static void hostRefreshDerived(void) {
+	uint8_t i, sir = 0;
+	for (i = 0; i < HOST_MAX_SOCKETS; i++) {
+		uint8_t* regs = hostSocketRegs[i];
+		uint16_t used = hostGetWord(&regs[REG_Sn_TX_WR]) - hostGetWord(&regs[REG_Sn_TX_RD]);
+		uint16_t size = hostBufferSize(i, 1);
+		hostSetWord(&regs[REG_Sn_TX_FSR], used > size ? 0 : size - used);
+		hostSetWord(&regs[REG_Sn_RX_RSR], hostGetWord(&regs[REG_Sn_RX_WR]) - hostGetWord(&regs[REG_Sn_RX_RD]));
+		if (regs[REG_Sn_IR] & regs[REG_Sn_IMR])
+			sir |= 1 << i;
+	}
+	hostCommon[REG_SIR] = sir;
+}
+
+/* This function schedules a status change and interrupt on a socket, honouring
+** the configured latency.
+*/
+static void hostSchedule(uint8_t socket, uint8_t status, uint8_t interrupt) {
+	struct hostPendingEvent* ev = &hostPending[socket];
+	if (hostLatency == 0) {
+		hostSocketRegs[socket][REG_Sn_SR] = status;
+		hostSocketRegs[socket][REG_Sn_IR] |= interrupt;
+		return;
+	}
+	ev->countdown = hostLatency;
+	ev->status = status;
+	ev->interrupt = interrupt;
+	ev->active = 1;
+}
+
+/* This function advances the pending socket events by one transaction
+*/
+static void hostTick(void) {
+	uint8_t i;
+	for (i = 0; i < HOST_MAX_SOCKETS; i++) {
+		struct hostPendingEvent* ev = &hostPending[i];
+		if (ev->active && --ev->countdown == 0) {
+			ev->active = 0;
+			hostSocketRegs[i][REG_Sn_SR] = ev->status;
+			hostSocketRegs[i][REG_Sn_IR] |= ev->interrupt;
+		}
+	}
+}
+
+/* This function hands the data between Sn_TX_RD and Sn_TX_WR to the send
+** hook and advances Sn_TX_RD.
+*/
+static void hostSend(uint8_t socket) {
+	static uint8_t frame[HOST_MEM_SIZE];
+	uint8_t* regs = hostSocketRegs[socket];
+	uint16_t rd = hostGetWord(&regs[REG_Sn_TX_RD]);
+	uint16_t wr = hostGetWord(&regs[REG_Sn_TX_WR]);
+	uint16_t len = wr - rd, i;
+	uint8_t* byte;
+
+	if (len > hostBufferSize(socket, 1))
+		len = hostBufferSize(socket, 1);
+	for (i = 0; i < len; i++) {
+		byte = hostBufferByte(socket, 1, rd + i);
+		frame[i] = byte ? *byte : 0;
+	}
+	// A send that times out is never acknowledged, so its data keeps its place in Sn_TX_FSR
+	if (hostSendFail & (1 << socket)) {
+		hostSendFail &= ~(1 << socket);
+		hostSchedule(socket, regs[REG_Sn_SR], Sn_IR_TIMEOUT);
+		return;
+	}
+	hostSetWord(&regs[REG_Sn_TX_RD], wr);
+	if (hostSendHook != NULL)
+		hostSendHook(socket, frame, len);
+	hostSchedule(socket, regs[REG_Sn_SR], Sn_IR_SEND_OK);
+}
+
+/* This function executes a command written to Sn_CR
+*/
+static void hostCommand(uint8_t socket, uint8_t command) {
+	uint8_t* regs = hostSocketRegs[socket];
+	uint8_t status = regs[REG_Sn_SR];
+
+	switch (command) {
+	case Sn_CR_OPEN:
+		hostPending[socket].active = 0;
+		hostSetWord(&regs[REG_Sn_TX_RD], 0);
+		hostSetWord(&regs[REG_Sn_TX_WR], 0);
+		hostSetWord(&regs[REG_Sn_RX_RD], 0);
+		hostSetWord(&regs[REG_Sn_RX_WR], 0);
+		switch (regs[REG_Sn_MR] & 0x0F) {
+		case Sn_MR_TCP:
+			regs[REG_Sn_SR] = Sn_SR_INIT;
+			break;
+		case Sn_MR_UDP:
+			regs[REG_Sn_SR] = Sn_SR_UDP;
+			break;
+		case Sn_MR_MACRAW:
+			regs[REG_Sn_SR] = (socket == 0) ? Sn_SR_MACRAW : Sn_SR_CLOSED;
+			break;
+		default:
+			regs[REG_Sn_SR] = Sn_SR_CLOSED;
+		}
+		break;
+	case Sn_CR_LISTEN:
+		if (status == Sn_SR_INIT)
+			regs[REG_Sn_SR] = Sn_SR_LISTEN;
+		break;
+	case Sn_CR_CONNECT:
+		if (status != Sn_SR_INIT)
+			break;
+		regs[REG_Sn_SR] = Sn_SR_SYN_SENT;
+		if (hostPeerUnreachable & (1 << socket))
+			hostSchedule(socket, Sn_SR_CLOSED, Sn_IR_TIMEOUT);
+		else
+			hostSchedule(socket, Sn_SR_ESTABLISHED, Sn_IR_CONNECT);
+		break;
+	case Sn_CR_DISCONNECT:
+		regs[REG_Sn_SR] = Sn_SR_CLOSED;
+		regs[REG_Sn_IR] |= Sn_IR_DISCONNECT;
+		break;
+	case Sn_CR_CLOSE:
+		hostPending[socket].active = 0;
+		regs[REG_Sn_SR] = Sn_SR_CLOSED;
+		break;
+	case Sn_CR_SEND:
+	case Sn_CR_SEND_MAC:
+		if (status == Sn_SR_UDP || status == Sn_SR_ESTABLISHED || status == Sn_SR_CLOSE_WAIT
+				|| status == Sn_SR_MACRAW)
+			hostSend(socket);
+		break;
+	case Sn_CR_RECEIVE:
+		if (hostGetWord(&regs[REG_Sn_RX_WR]) != hostGetWord(&regs[REG_Sn_RX_RD]))
+			regs[REG_Sn_IR] |= Sn_IR_RECEIVE;
+		break;
+	default:
+		break;
+	}
+	regs[REG_Sn_CR] = 0;
+}
+
+/* This function handles a data-phase write into the common register block
+*/
+static void hostWriteCommon(uint16_t addr, uint8_t data) {
+	if (addr >= HOST_COMMON_SIZE)
+		return;
+	switch (addr) {
+	case REG_MR:
+		if (data & MR_RESET) {
+			hostReset();
+			return;
+		}
+		break;
+	case REG_IR:
+		hostCommon[REG_IR] &= ~data;
+		return;
+	case REG_SIR:
+	case REG_VERSIONR:
+		return;
+	}
+	hostCommon[addr] = data;
+}
+
+/* This function handles a data-phase write into a socket register block
+*/
+static void hostWriteSocket(uint8_t socket, uint16_t addr, uint8_t data) {
+	uint8_t* regs = hostSocketRegs[socket];
+	if (addr >= HOST_SOCKET_REGS_SIZE)
+		return;
+	switch (addr) {
+	case REG_Sn_CR:
+		hostCommand(socket, data);
+		return;
+	case REG_Sn_IR:
+		regs[REG_Sn_IR] &= ~data;
+		return;
+	case REG_Sn_SR:
+	case REG_Sn_TX_FSR:
+	case REG_Sn_TX_FSR + 1:
+	case REG_Sn_TX_RD:
+	case REG_Sn_TX_RD + 1:
+	case REG_Sn_RX_RSR:
+	case REG_Sn_RX_RSR + 1:
+	case REG_Sn_RX_WR:
+	case REG_Sn_RX_WR + 1:
+		return;
+	}
+	regs[addr] = data;
+}
+
+/* This function performs one data-phase byte exchange at the current
+** decoded address.
+*/
+static uint8_t hostDataPhase(uint8_t data) {
+	uint8_t block = hostCtrl >> 3;
+	uint8_t write = hostCtrl & 0x04;
+	uint8_t socket = block >> 2;
+	uint8_t ret = 0x00;
+	uint8_t* byte;
+
+	if (block == 0) {
+		if (write)
+			hostWriteCommon(hostAddr, data);
+		else if (hostAddr < HOST_COMMON_SIZE)
+			ret = hostCommon[hostAddr];
+	} else {
+		switch (block & 0x03) {
+		case 1:
+			if (write)
+				hostWriteSocket(socket, hostAddr, data);
+			else if (hostAddr < HOST_SOCKET_REGS_SIZE)
+				ret = hostSocketRegs[socket][hostAddr];
+			break;
+		case 2:
+		case 3:
+			byte = hostBufferByte(socket, (block & 0x03) == 2, hostAddr);
+			if (byte == NULL)
+				break;
+			if (write)
+				*byte = data;
+			else
+				ret = *byte;
+			break;
+		}
+	}
+	if (write)
+		hostStats.writeBytes++;
+	else
+		hostStats.readBytes++;
+	hostAddr++;
+	return ret;
+}
+
+/* This function clocks one byte across the simulated SPI bus
+*/
+uint8_t wiznetHostTransceiveByte(uint8_t data) {
+	if (!hostSelected)
+		return 0xFF;
+	hostStats.bytes++;
+	switch (hostPhase++) {
+	case 0:
+		hostAddr = ((uint16_t)data) << 8;
+		return 0x00;
+	case 1:
+		hostAddr |= data;
+		return 0x01;
+	case 2:
+		hostCtrl = data;
+		hostStats.transactions++;
+		hostTick();
+		hostRefreshDerived();
+		return 0x02;
+	default:
+		return hostDataPhase(data);
+	}
+}
+
+/* This function clocks a block of bytes across the simulated SPI bus.
+** The data phase is modelled directly rather than through the per-byte
+** path, as a DMA or FIFO backend would.
+*/
+void wiznetHostTransceiveBlock(const uint8_t* tx, uint8_t* rx, uint16_t len) {
+	uint8_t in;
+	while (hostPhase < 3 && len) {
+		in = wiznetHostTransceiveByte(tx ? *tx++ : 0xFF);
+		if (rx != NULL)
+			*rx++ = in;
+		len--;
+	}
+	if (!hostSelected)
+		return;
+	hostStats.bytes += len;
+	hostPhase += len;
+	while (len--) {
+		in = hostDataPhase(tx ? *tx++ : 0xFF);
+		if (rx != NULL)
+			*rx++ = in;
+	}
+}
+
+/* This function asserts the simulated chip-select line
+*/
+void wiznetHostChipEnable(void) {
+	hostSelected = 1;
+	hostPhase = 0;
+}
+
+/* This function de-asserts the simulated chip-select line
+*/
+void wiznetHostChipDisable(void) {
+	if (hostSelected)
+		hostStats.chipSelects++;
+	hostSelected = 0;
+}
+
+/* This function powers up the chip model and clears the bus statistics.
+** The same state is reached by the driver through MR_RESET.
+*/
+void wiznetHostInit(void) {
+	hostReset();
+	hostSelected = 0;
+	hostLatency = 0;
+	hostPeerUnreachable = 0;
+	hostSendFail = 0;
+	hostSendHook = NULL;
+	hostIdleHook = NULL;
+	memset(hostTXMem, 0, sizeof(hostTXMem));
+	memset(hostRXMem, 0, sizeof(hostRXMem));
+	wiznetHostResetStats();
+}
+
+/* This function sets how many transactions pass between a command and its
+** asynchronous outcome (SEND_OK, CONNECT, TIMEOUT). Zero completes at once.
+*/
+void wiznetHostSetLatency(uint16_t transactions) {
+	hostLatency = transactions;
+}
+
+/* This function registers a hook that receives all data sent by the chip
+*/
+void wiznetHostSetSendHook(wiznetHostSendHook hook) {
+	hostSendHook = hook;
+}
+
+/* This function registers a hook called each time the driver idles between
+** polling passes, e.g. to have data arrive while wiznetPoll waits
+*/
+void wiznetHostSetIdleHook(wiznetHostIdleHook hook) {
+	hostIdleHook = hook;
+}
+
+/* This function sets whether a CONNECT on the socket will succeed or time out
+*/
+void wiznetHostSetPeerReachable(uint8_t socket, uint8_t reachable) {
+	if (reachable)
+		hostPeerUnreachable &= ~(1 << socket);
+	else
+		hostPeerUnreachable |= 1 << socket;
+}
+
+/* This function makes the next SEND on a socket end in Sn_IR_TIMEOUT, with
+** Sn_TX_RD left where it was
+*/
+void wiznetHostFailNextSend(uint8_t socket) {
+	hostSendFail |= 1 << socket;
+}
+
+/* This function simulates a remote peer connecting to a listening socket
+**
+** returns - 0 if the connection was accepted, -1 if the socket is not listening
+*/
+int wiznetHostAcceptConnection(uint8_t socket, const uint8_t* ip, uint16_t port) {
+	uint8_t* regs = hostSocketRegs[socket];
+	if (regs[REG_Sn_SR] != Sn_SR_LISTEN)
+		return -1;
+	memcpy(&regs[REG_Sn_DIPR], ip, 4);
+	hostSetWord(&regs[REG_Sn_DPORT], port);
+	regs[REG_Sn_SR] = Sn_SR_ESTABLISHED;
+	regs[REG_Sn_IR] |= Sn_IR_CONNECT;
+	return 0;
+}
+
+/* This function places bytes into a socket's RX buffer at Sn_RX_WR, as if
+** they had arrived from the network, and raises Sn_IR_RECEIVE.
+**
+** returns - 0 if the data was queued, -1 if there is no room
+*/
+int wiznetHostInjectRaw(uint8_t socket, const uint8_t* data, uint16_t len) {
+	uint8_t* regs = hostSocketRegs[socket];
+	uint16_t wr = hostGetWord(&regs[REG_Sn_RX_WR]);
+	uint16_t used = wr - hostGetWord(&regs[REG_Sn_RX_RD]);
+	uint16_t i;
+
+	if ((uint32_t)used + len > hostBufferSize(socket, 0))
+		return -1;
+	for (i = 0; i < len; i++)
+		*hostBufferByte(socket, 0, wr + i) = data[i];
+	hostSetWord(&regs[REG_Sn_RX_WR], wr + len);
+	regs[REG_Sn_IR] |= Sn_IR_RECEIVE;
+	return 0;
+}
+
+/* This function queues a UDP datagram, prefixed with the 8-byte header the
+** chip stores in front of each datagram (source IP, port and length).
+**
+** returns - 0 if the datagram was queued, -1 if there is no room
+*/
+int wiznetHostInjectUDP(uint8_t socket, const uint8_t* ip, uint16_t port, const uint8_t* data, uint16_t len) {
+	uint8_t* regs = hostSocketRegs[socket];
+	uint8_t header[8];
+
+	if ((uint32_t)(uint16_t)(hostGetWord(&regs[REG_Sn_RX_WR]) - hostGetWord(&regs[REG_Sn_RX_RD]))
+			+ len + sizeof(header) > hostBufferSize(socket, 0))
+		return -1;
+	memcpy(header, ip, 4);
+	hostSetWord(&header[4], port);
+	hostSetWord(&header[6], len);
+	wiznetHostInjectRaw(socket, header, sizeof(header));
+	return wiznetHostInjectRaw(socket, data, len);
+}
+
+/* This function queues an Ethernet frame on a MACRAW socket, prefixed with
+** the 2-byte header the chip stores in front of each frame. The length in
+** the header counts the header itself.
+**
+** returns - 0 if the frame was queued, -1 if there is no room
+*/
+int wiznetHostInjectMACRAW(uint8_t socket, const uint8_t* data, uint16_t len) {
+	uint8_t* regs = hostSocketRegs[socket];
+	uint8_t header[2];
+
+	if ((uint32_t)(uint16_t)(hostGetWord(&regs[REG_Sn_RX_WR]) - hostGetWord(&regs[REG_Sn_RX_RD]))
+			+ len + sizeof(header) > hostBufferSize(socket, 0))
+		return -1;
+	hostSetWord(header, len + sizeof(header));
+	wiznetHostInjectRaw(socket, header, sizeof(header));
+	return wiznetHostInjectRaw(socket, data, len);
+}
+
+/* This function reports the state of the INTn line (1 = asserted)
+*/
+uint8_t wiznetHostInterruptAsserted(void) {
+	hostRefreshDerived();
+	return ((hostCommon[REG_SIR] & hostCommon[REG_SIMR]) != 0)
+		|| ((hostCommon[REG_IR] & hostCommon[REG_IMR]) != 0);
+}
+
+/* This function is the driver's wiznetPollIdle hook
+*/
+void wiznetHostPollIdle(void) {
+	if (hostIdleHook != NULL)
+		hostIdleHook();
+}
+
+/* This function returns a free-running clock in nanoseconds. It is the
+** time base of WIZNET_TRACE on the host.
+*/
+uint32_t wiznetHostClock(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec);
+}
+
+/* This function copies out the bus statistics gathered since the last reset
+*/
+void wiznetHostGetStats(struct wiznetHostStats* stats) {
+	*stats = hostStats;
+}
+
+/* This function clears the bus statistics
+*/
+void wiznetHostResetStats(void) {
+	memset(&hostStats, 0, sizeof(hostStats));
+}
+
+/* This function fills a buffer with pseudo-random payload in which about
+** escapePercent bytes in every hundred are SLIP special characters (0xC0 or
+** 0xDB), so the SLIP paths can be measured at a chosen escape density.
+**
+** buf           - buffer to fill
+** len           - number of bytes
+** escapePercent - share of bytes that need escaping, 0-100
+** seed          - generator state, carried between calls
+*/
+void wiznetHostFillPayload(uint8_t* buf, uint16_t len, uint8_t escapePercent, uint32_t* seed) {
+	uint16_t i;
+	uint8_t byte;
+	for (i = 0; i < len; i++) {
+		*seed = *seed * 1103515245 + 12345;
+		if ((*seed >> 16) % 100 < escapePercent)
+			byte = (*seed & 0x100) ? 0xC0 : 0xDB;
+		else {
+			byte = (uint8_t)(*seed >> 24);
+			if (byte == 0xC0 || byte == 0xDB)
+				byte ^= 0x01;
+		}
+		buf[i] = byte;
+	}
+}
+
+/* This function returns the host CPU time used so far, in nanoseconds
+*/
+static uint64_t hostCPUTime(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* This function starts a measured run. The bus statistics are not reset, so
+** runs can be taken in the middle of other measurements.
+**
+** bench - the run
+** name  - label reported with the run and used to find its baseline
+*/
+void wiznetHostBenchBegin(struct wiznetHostBench* bench, const char* name) {
+	bench->name = name;
+	bench->payload = 0;
+	bench->datagrams = 0;
+	bench->bus = hostStats;
+	bench->ns = hostCPUTime();
+}
+
+/* This function ends a measured run
+**
+** bench     - the run
+** payload   - payload bytes moved during the run
+** datagrams - datagrams, frames or calls in the run
+*/
+void wiznetHostBenchEnd(struct wiznetHostBench* bench, uint32_t payload, uint32_t datagrams) {
+	bench->ns = hostCPUTime() - bench->ns;
+	bench->bus.bytes = hostStats.bytes - bench->bus.bytes;
+	bench->bus.chipSelects = hostStats.chipSelects - bench->bus.chipSelects;
+	bench->bus.transactions = hostStats.transactions - bench->bus.transactions;
+	bench->bus.readBytes = hostStats.readBytes - bench->bus.readBytes;
+	bench->bus.writeBytes = hostStats.writeBytes - bench->bus.writeBytes;
+	bench->payload = payload;
+	bench->datagrams = datagrams;
+}
+
+/* This function works out the efficiency figures of a run
+*/
+static void hostBenchRatios(const struct wiznetHostBench* bench, double* bytesPerByte, double* transactionsPerDatagram) {
+	*bytesPerByte = bench->payload ? (double)bench->bus.bytes / bench->payload : 0.0;
+	*transactionsPerDatagram = bench->datagrams ? (double)bench->bus.transactions / bench->datagrams : 0.0;
+}
+
+/* This function writes a run as a single JSON line
+**
+** bench  - the run
+** out    - stream to write to
+** timing - 1 to include the host CPU time per byte, 0 to leave it out. It
+**          varies from run to run and machine to machine, so it is left out
+**          of lines taken as baselines.
+*/
+void wiznetHostBenchReport(const struct wiznetHostBench* bench, FILE* out, uint8_t timing) {
+	double bytesPerByte, transactionsPerDatagram;
+	hostBenchRatios(bench, &bytesPerByte, &transactionsPerDatagram);
+	fprintf(out, "{\"name\":\"%s\",\"payload\":%lu,\"datagrams\":%lu,\"bytes\":%lu,"
+			"\"transactions\":%lu,\"chipSelects\":%lu,\"bytesPerByte\":%.4f,"
+			"\"transactionsPerDatagram\":%.4f",
+			bench->name, (unsigned long)bench->payload, (unsigned long)bench->datagrams,
+			(unsigned long)bench->bus.bytes, (unsigned long)bench->bus.transactions,
+			(unsigned long)bench->bus.chipSelects, bytesPerByte, transactionsPerDatagram);
+	if (timing)
+		fprintf(out, ",\"nsPerByte\":%.2f", bench->payload ? (double)bench->ns / bench->payload : 0.0);
+	fprintf(out, "}\n");
+}
+
+/* This function reads baselines back from lines written by
+** wiznetHostBenchReport. Lines without a name are skipped.
+**
+** in        - stream to read from
+** baselines - array to fill
+** count     - size of the array
+**
+** returns - number of baselines read
+*/
+int wiznetHostBenchLoadBaselines(FILE* in, struct wiznetHostBaseline* baselines, uint8_t count) {
+	char line[512];
+	const char *name, *field;
+	size_t len;
+	int n = 0;
+
+	while (n < count && fgets(line, sizeof(line), in) != NULL) {
+		if ((name = strstr(line, "\"name\":\"")) == NULL)
+			continue;
+		name += sizeof("\"name\":\"") - 1;
+		len = strcspn(name, "\"");
+		if (len >= sizeof(baselines[n].name))
+			len = sizeof(baselines[n].name) - 1;
+		memcpy(baselines[n].name, name, len);
+		baselines[n].name[len] = '\0';
+		field = strstr(line, "\"bytesPerByte\":");
+		baselines[n].bytesPerByte = field ? strtod(field + sizeof("\"bytesPerByte\":") - 1, NULL) : 0.0;
+		field = strstr(line, "\"transactionsPerDatagram\":");
+		baselines[n].transactionsPerDatagram = field ? strtod(field + sizeof("\"transactionsPerDatagram\":") - 1, NULL) : 0.0;
+		n++;
+	}
+	return n;
+}
+
+/* This function checks a run against the baseline of the same name
+**
+** bench     - the run
+** baselines - stored baselines
+** count     - number of baselines
+** tolerance - allowed worsening, as a fraction (0.02 for 2%)
+**
+** returns - 0 if the run is within tolerance or has no baseline
+**         - -1 if its bus bytes per payload byte or transactions per
+**           datagram have regressed
+*/
+int wiznetHostBenchCheck(const struct wiznetHostBench* bench, const struct wiznetHostBaseline* baselines,
+		uint8_t count, double tolerance) {
+	double bytesPerByte, transactionsPerDatagram;
+	uint8_t i;
+
+	hostBenchRatios(bench, &bytesPerByte, &transactionsPerDatagram);
+	for (i = 0; i < count; i++) {
+		if (strcmp(baselines[i].name, bench->name) != 0)
+			continue;
+		if (bytesPerByte > baselines[i].bytesPerByte * (1.0 + tolerance) + 1e-9
+				|| transactionsPerDatagram > baselines[i].transactionsPerDatagram * (1.0 + tolerance) + 1e-9)
+			return -1;
+		return 0;
+	}
+	return 0;
+}
+
+/* This function reads a trace written by wiznetTraceExport
+**
+** in      - stream to read from
+** header  - filled with the trace header
+** records - array to fill
+** size    - size of the array
+**
+** returns - number of records read
+**         - -1 if the stream does not hold a trace this model can read; a
+**           trace from a target of the other byte order is rejected
+*/
+int wiznetHostTraceLoad(FILE* in, struct wiznetTraceHeader* header, struct wiznetTraceRecord* records, uint32_t size) {
+	uint32_t count;
+	if (fread(header, sizeof(*header), 1, in) != 1
+			|| header->magic != WIZNET_TRACE_MAGIC
+			|| header->version != WIZNET_TRACE_VERSION
+			|| header->recordSize != sizeof(struct wiznetTraceRecord))
+		return -1;
+	count = header->count < size ? header->count : size;
+	return (int)fread(records, sizeof(struct wiznetTraceRecord), count, in);
+}
+
+/* This function tells whether a control byte addresses a register block
+** (the common registers or a socket's) rather than a buffer
+*/
+static uint8_t hostTraceIsRegister(uint8_t control) {
+	return ((control >> 3) & 0x03) <= 1;
+}
+
+/* This function replays a trace against the model, transaction for
+** transaction. Writes carry the recorded data bytes, which cover every
+** register access, followed by filler; reads are compared with the trace.
+** The model is not reset first, so it can be prepared to match the state
+** of the chip when the trace began.
+**
+** records - the trace
+** count   - number of records
+**
+** returns - number of register reads whose data differed from the trace
+*/
+uint32_t wiznetHostTraceReplay(const struct wiznetTraceRecord* records, uint32_t count) {
+	const struct wiznetTraceRecord* rec;
+	uint8_t rx[WIZNET_TRACE_DATA];
+	uint32_t i, mismatches = 0;
+	uint16_t n;
+
+	for (i = 0; i < count; i++) {
+		rec = &records[i];
+		n = rec->length < WIZNET_TRACE_DATA ? rec->length : WIZNET_TRACE_DATA;
+		wiznetHostChipEnable();
+		wiznetHostTransceiveByte((uint8_t)(rec->address >> 8));
+		wiznetHostTransceiveByte((uint8_t)rec->address);
+		wiznetHostTransceiveByte(rec->control);
+		if (rec->control & 0x04)
+			wiznetHostTransceiveBlock(rec->data, NULL, n);
+		else
+			wiznetHostTransceiveBlock(NULL, rx, n);
+		wiznetHostTransceiveBlock(NULL, NULL, rec->length - n);
+		wiznetHostChipDisable();
+
+		if (!(rec->control & 0x04) && hostTraceIsRegister(rec->control) && memcmp(rx, rec->data, n) != 0)
+			mismatches++;
+	}
+	return mismatches;
+}
+
+/* This function orders call sites by transactions, most first
+*/
+static int hostTraceSiteCompare(const void* a, const void* b) {
+	const struct wiznetHostTraceSite* sa = (const struct wiznetHostTraceSite*)a;
+	const struct wiznetHostTraceSite* sb = (const struct wiznetHostTraceSite*)b;
+	if (sa->transactions != sb->transactions)
+		return sa->transactions < sb->transactions ? 1 : -1;
+	return sa->site < sb->site ? -1 : sa->site > sb->site;
+}
+
+/* This function tells whether a register read repeats the last read of the
+** same registers, and remembers it as the last read. A write to any of the
+** registers makes the next read of them count as new.
+*/
+static uint8_t hostTraceRepeatedRead(const struct wiznetTraceRecord** reads, uint16_t* readCount,
+		const struct wiznetTraceRecord* rec, uint8_t hashed) {
+	const struct wiznetTraceRecord* last;
+	uint16_t i, n;
+
+	for (i = 0; i < *readCount; i++) {
+		last = reads[i];
+		if (last->control != rec->control || last->address != rec->address || last->length != rec->length)
+			continue;
+		reads[i] = rec;
+		n = rec->length < WIZNET_TRACE_DATA ? rec->length : WIZNET_TRACE_DATA;
+		return memcmp(last->data, rec->data, n) == 0 && (!hashed || last->hash == rec->hash);
+	}
+	if (*readCount < HOST_TRACE_MAX_READS)
+		reads[(*readCount)++] = rec;
+	return 0;
+}
+
+/* This function forgets the reads of registers covered by a write
+*/
+static void hostTraceForgetReads(const struct wiznetTraceRecord** reads, uint16_t* readCount,
+		const struct wiznetTraceRecord* rec) {
+	const struct wiznetTraceRecord* last;
+	uint16_t i = 0;
+
+	while (i < *readCount) {
+		last = reads[i];
+		if ((last->control >> 3) == (rec->control >> 3)
+				&& last->address < rec->address + rec->length
+				&& rec->address < last->address + last->length)
+			reads[i] = reads[--(*readCount)];
+		else
+			i++;
+	}
+}
+
+/* This function analyses a trace
+**
+** header  - the trace header
+** records - the trace
+** count   - number of records
+** report  - filled with the analysis
+*/
+void wiznetHostTraceAnalyse(const struct wiznetTraceHeader* header, const struct wiznetTraceRecord* records,
+		uint32_t count, struct wiznetHostTraceReport* report) {
+	struct wiznetHostTraceSite sites[HOST_TRACE_MAX_SITES];
+	const struct wiznetTraceRecord* reads[HOST_TRACE_MAX_READS];
+	const struct wiznetTraceRecord* rec;
+	struct wiznetHostTraceSite* site;
+	uint16_t siteCount = 0, readCount = 0, s;
+	uint32_t i;
+	int32_t gap;
+	uint8_t repeated;
+
+	memset(report, 0, sizeof(*report));
+	for (i = 0; i < count; i++) {
+		rec = &records[i];
+		report->transactions++;
+		report->bytes += 3 + rec->length;
+
+		repeated = 0;
+		if (rec->control & 0x04) {
+			report->writeTransactions++;
+			if (hostTraceIsRegister(rec->control))
+				hostTraceForgetReads(reads, &readCount, rec);
+		} else {
+			report->readTransactions++;
+			if (hostTraceIsRegister(rec->control))
+				repeated = hostTraceRepeatedRead(reads, &readCount, rec, header->flags & WIZNET_TRACE_FLAG_HASH);
+		}
+		report->redundantReads += repeated;
+
+		for (s = 0; s < siteCount && sites[s].site != rec->site; s++)
+			;
+		if (s == siteCount && siteCount < HOST_TRACE_MAX_SITES) {
+			memset(&sites[s], 0, sizeof(sites[s]));
+			sites[s].site = rec->site;
+			siteCount++;
+		}
+		if (s < siteCount) {
+			site = &sites[s];
+			site->transactions++;
+			site->bytes += 3 + rec->length;
+			site->redundantReads += repeated;
+		}
+
+		if (header->tickNs != 0) {
+			report->busyNs += (uint64_t)rec->duration * header->tickNs;
+			if (i != 0) {
+				gap = (int32_t)(rec->time - (records[i - 1].time + records[i - 1].duration));
+				if (gap > 0) {
+					report->idleNs += (uint64_t)gap * header->tickNs;
+					if ((uint64_t)gap * header->tickNs > report->maxIdleNs)
+						report->maxIdleNs = (uint64_t)gap * header->tickNs;
+				}
+			}
+		}
+	}
+
+	qsort(sites, siteCount, sizeof(sites[0]), hostTraceSiteCompare);
+	report->siteCount = siteCount;
+	memcpy(report->sites, sites, (siteCount < WIZNET_HOST_TRACE_SITES ? siteCount : WIZNET_HOST_TRACE_SITES) * sizeof(sites[0]));
+}
+
+/* This function prints an analysis. Call sites are given as absolute
+** addresses, ready for addr2line against the image that made the trace.
+**
+** header - the trace header
+** report - the analysis
+** out    - stream to write to
+*/
+void wiznetHostTracePrint(const struct wiznetTraceHeader* header, const struct wiznetHostTraceReport* report, FILE* out) {
+	uint16_t i, n;
+
+	fprintf(out, "transactions %lu (%lu read, %lu write), %lu bus bytes, %lu dropped\n",
+			(unsigned long)report->transactions, (unsigned long)report->readTransactions,
+			(unsigned long)report->writeTransactions, (unsigned long)report->bytes, (unsigned long)header->dropped);
+	fprintf(out, "redundant register reads %lu\n", (unsigned long)report->redundantReads);
+	if (header->tickNs != 0)
+		fprintf(out, "bus busy %llu ns, idle %llu ns, longest idle %llu ns\n",
+				(unsigned long long)report->busyNs, (unsigned long long)report->idleNs,
+				(unsigned long long)report->maxIdleNs);
+	fprintf(out, "%-18s %12s %12s %12s\n", "site", "transactions", "bytes", "redundant");
+	n = report->siteCount < WIZNET_HOST_TRACE_SITES ? report->siteCount : WIZNET_HOST_TRACE_SITES;
+	for (i = 0; i < n; i++)
+		fprintf(out, "0x%016llx %12lu %12lu %12lu\n",
+				(unsigned long long)(header->siteBase + (int64_t)report->sites[i].site),
+				(unsigned long)report->sites[i].transactions, (unsigned long)report->sites[i].bytes,
+				(unsigned long)report->sites[i].redundantReads);
+}
@@ -0,0 +1,129 @@
+#ifndef WIZNET_HOST_H
+#define WIZNET_HOST_H
+#include <stdint.h>
+#include <stdio.h>
+#include "wiznet_trace.h"
+
+/*
+** Host-side software model of the W5500
+**
+** This is the ARCH_HOST backend for wiznet_arch.h. It models the common
+** register block, the 8 socket register blocks and the 16KB TX and RX
+** memories and decodes the address/control phases exactly as wiznetIOBegin
+** produces them. All bus activity is counted so that the SPI cost of any
+** driver call can be measured by taking a snapshot of the statistics before
+** and after it.
+**
+** The wiznetHostBench* helpers wrap that for benchmarking: a run records the
+** bus traffic and host CPU time between Begin and End, is reported as one
+** JSON line, and can be checked against baselines loaded back from such
+** lines, so that a harness fails when bus efficiency regresses.
+**
+** The wiznetHostTrace* helpers take a trace exported by a WIZNET_TRACE build
+** of the driver, on the host or on a target, replay it against the model and
+** analyse it: the busiest call sites, register reads that returned the same
+** value as the last read of that register, and the time the bus sat idle.
+**
+************************************/
+
+/* Bus accounting for the simulated SPI link
+*/
+struct wiznetHostStats {
+	uint32_t bytes;          //Every byte clocked while the chip is selected
+	uint32_t chipSelects;    //Chip-select assert/de-assert cycles
+	uint32_t transactions;   //Address/control phases decoded
+	uint32_t readBytes;      //Data-phase bytes read from the chip
+	uint32_t writeBytes;     //Data-phase bytes written to the chip
+};
+
+/* One measured run over the simulated bus
+*/
+struct wiznetHostBench {
+	const char* name;
+	uint32_t payload;               //Payload bytes moved
+	uint32_t datagrams;             //Datagrams, frames or calls in the run
+	struct wiznetHostStats bus;     //Bus traffic during the run
+	uint64_t ns;                    //Host CPU time during the run
+};
+
+/* Expected efficiency of a run, as stored from an earlier report
+*/
+struct wiznetHostBaseline {
+	char name[48];
+	double bytesPerByte;            //Bus bytes per payload byte
+	double transactionsPerDatagram;
+};
+
+#ifndef WIZNET_HOST_TRACE_SITES
+#define WIZNET_HOST_TRACE_SITES 16    //Call sites listed in a trace report
+#endif
+
+/* Transactions issued from one call site in a trace
+*/
+struct wiznetHostTraceSite {
+	int32_t site;                   //Offset from the trace's siteBase
+	uint32_t transactions;
+	uint32_t bytes;                 //Bus bytes, address and control phases included
+	uint32_t redundantReads;
+};
+
+/* Analysis of a trace
+*/
+struct wiznetHostTraceReport {
+	uint32_t transactions;
+	uint32_t bytes;
+	uint32_t readTransactions;
+	uint32_t writeTransactions;
+	uint32_t redundantReads;        //Register reads returning what the last read of them did
+	uint64_t busyNs;                //Time the chip was selected, 0 without a trace clock
+	uint64_t idleNs;                //Time between transactions, 0 without a trace clock
+	uint64_t maxIdleNs;
+	uint16_t siteCount;             //Distinct call sites
+	struct wiznetHostTraceSite sites[WIZNET_HOST_TRACE_SITES];    //Busiest first
+};
+
+typedef void (*wiznetHostSendHook)(uint8_t socket, const uint8_t* data, uint16_t len);
+typedef void (*wiznetHostIdleHook)(void);
+
+// SPI backend hooks, used by wiznet_arch.h
+uint8_t wiznetHostTransceiveByte(uint8_t data);
+void wiznetHostTransceiveBlock(const uint8_t* tx, uint8_t* rx, uint16_t len);
+void wiznetHostChipEnable(void);
+void wiznetHostChipDisable(void);
+void wiznetHostPollIdle(void);
+
+// Model control
+void wiznetHostInit(void);
+void wiznetHostSetLatency(uint16_t transactions);
+void wiznetHostSetSendHook(wiznetHostSendHook hook);
+void wiznetHostSetIdleHook(wiznetHostIdleHook hook);
+void wiznetHostSetPeerReachable(uint8_t socket, uint8_t reachable);
+void wiznetHostFailNextSend(uint8_t socket);
+int wiznetHostAcceptConnection(uint8_t socket, const uint8_t* ip, uint16_t port);
+int wiznetHostInjectRaw(uint8_t socket, const uint8_t* data, uint16_t len);
+int wiznetHostInjectUDP(uint8_t socket, const uint8_t* ip, uint16_t port, const uint8_t* data, uint16_t len);
+int wiznetHostInjectMACRAW(uint8_t socket, const uint8_t* data, uint16_t len);
+uint8_t wiznetHostInterruptAsserted(void);
+uint32_t wiznetHostClock(void);
+
+// Bus accounting
+void wiznetHostGetStats(struct wiznetHostStats* stats);
+void wiznetHostResetStats(void);
+
+// Benchmarking
+void wiznetHostFillPayload(uint8_t* buf, uint16_t len, uint8_t escapePercent, uint32_t* seed);
+void wiznetHostBenchBegin(struct wiznetHostBench* bench, const char* name);
+void wiznetHostBenchEnd(struct wiznetHostBench* bench, uint32_t payload, uint32_t datagrams);
+void wiznetHostBenchReport(const struct wiznetHostBench* bench, FILE* out, uint8_t timing);
+int wiznetHostBenchLoadBaselines(FILE* in, struct wiznetHostBaseline* baselines, uint8_t count);
+int wiznetHostBenchCheck(const struct wiznetHostBench* bench, const struct wiznetHostBaseline* baselines,
+		uint8_t count, double tolerance);
+
+// Trace replay and analysis
+int wiznetHostTraceLoad(FILE* in, struct wiznetTraceHeader* header, struct wiznetTraceRecord* records, uint32_t size);
+uint32_t wiznetHostTraceReplay(const struct wiznetTraceRecord* records, uint32_t count);
+void wiznetHostTraceAnalyse(const struct wiznetTraceHeader* header, const struct wiznetTraceRecord* records,
+		uint32_t count, struct wiznetHostTraceReport* report);
+void wiznetHostTracePrint(const struct wiznetTraceHeader* header, const struct wiznetHostTraceReport* report, FILE* out);
+
+#endif
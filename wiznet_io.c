@@ -6,120 +6,315 @@
 #include "wiznet_io.h"
 #include "wiznet_regs.h"
 
+#ifndef NULL
 #define NULL ((void*)0)
+#endif
+
+#ifdef WIZNET_SHADOW_REGISTERS
+/* Shadow copies of the driver-owned registers
+*/
+uint8_t wiznetShadowSIMR;
+struct wiznetShadowSocket wiznetShadowSockets[WIZNET_MAX_SOCKETS];
+#endif
+
+#ifdef WIZNET_STATS
+/* Driver counters, and the socket whose block the open transaction is on
+*/
+struct wiznetStats wiznetStatCounters;
+static int wiznetStatSocket = -1;
+
+/* This function counts bytes clocked in the open transaction
+*/
+void wiznetStatBytes(uint16_t length) {
+	wiznetStatCounters.spiBytes += length;
+	if (wiznetStatSocket != -1)
+		wiznetStatCounters.sockets[wiznetStatSocket].spiBytes += length;
+}
+#endif
+
+#ifdef WIZNET_TRACE
+#ifdef wiznetTraceClock
+#ifndef WIZNET_TRACE_TICK_NS
+#error "WIZNET_TRACE_TICK_NS was not defined"
+#endif
+#else
+static uint32_t wiznetTraceSequence;
+#define wiznetTraceClock() (wiznetTraceSequence++)
+#undef WIZNET_TRACE_TICK_NS
+#define WIZNET_TRACE_TICK_NS 0
+#endif
+
+/* Trace ring, the record of the open transaction, and the call site left by
+** a register helper for the next transaction
+*/
+static struct wiznetTraceRecord wiznetTraceRing[WIZNET_TRACE_DEPTH];
+static struct wiznetTraceRecord* wiznetTraceOpen;
+static uint16_t wiznetTraceHead;
+static uint32_t wiznetTraceTotal;
+static uint8_t wiznetTracePaused;
+void* wiznetTraceCaller;
+
+/* This function starts the record of a transaction in the next ring slot
+*/
+static void wiznetTraceBegin(uint16_t address, uint8_t control, void* site) {
+	struct wiznetTraceRecord* rec;
+	uint8_t i;
+	if (wiznetTracePaused)
+		return;
+	rec = &wiznetTraceRing[wiznetTraceHead];
+	if (++wiznetTraceHead == WIZNET_TRACE_DEPTH)
+		wiznetTraceHead = 0;
+	wiznetTraceTotal++;
+
+	rec->time = wiznetTraceClock();
+	rec->site = (int32_t)((uintptr_t)site - (uintptr_t)&wiznetIOBegin);
+	rec->address = address;
+	rec->length = 0;
+	rec->duration = 0;
+	rec->control = control;
+	rec->hash = 0;
+	for (i = 0; i < WIZNET_TRACE_DATA; i++)
+		rec->data[i] = 0;
+	wiznetTraceOpen = rec;
+}
+
+/* This function adds data-phase bytes to the open record. The bytes written
+** are kept for a write, the bytes read for a read.
+**
+** tx     - bytes sent, or NULL if filler bytes were sent
+** rx     - bytes received, or NULL if they were discarded
+** length - number of bytes clocked
+*/
+void wiznetTraceData(const uint8_t* tx, const uint8_t* rx, uint16_t length) {
+	struct wiznetTraceRecord* rec = wiznetTraceOpen;
+	const uint8_t* data;
+	uint16_t i, n = length;
+	uint8_t byte;
+	if (rec == NULL)
+		return;
+	data = (rec->control & 0x04) ? tx : rx;
+	if (data == NULL && !(rec->control & 0x04))
+		n = 0;    //Discarded reads leave nothing to record
+#ifndef WIZNET_TRACE_HASH
+	if (rec->length >= WIZNET_TRACE_DATA)
+		n = 0;
+	else if (n > WIZNET_TRACE_DATA - rec->length)
+		n = WIZNET_TRACE_DATA - rec->length;
+#endif
+	for (i = 0; i < n; i++) {
+		byte = data != NULL ? data[i] : 0xFF;
+		if (rec->length + i < WIZNET_TRACE_DATA)
+			rec->data[rec->length + i] = byte;
+#ifdef WIZNET_TRACE_HASH
+		rec->hash = (uint8_t)((rec->hash << 1) | (rec->hash >> 7)) ^ byte;
+#endif
+	}
+	rec->length += length;
+}
+
+/* This function closes the open record when the chip is de-selected
+*/
+void wiznetTraceEnd(void) {
+	struct wiznetTraceRecord* rec = wiznetTraceOpen;
+	uint32_t duration;
+	if (rec == NULL)
+		return;
+#if WIZNET_TRACE_TICK_NS
+	duration = wiznetTraceClock() - rec->time;
+	rec->duration = duration > 0xFFFF ? 0xFFFF : (uint16_t)duration;
+#endif
+	(void)duration;
+	wiznetTraceOpen = NULL;
+}
+
+/* This function empties the trace
+*/
+void wiznetTraceReset(void) {
+	wiznetTraceOpen = NULL;
+	wiznetTraceHead = 0;
+	wiznetTraceTotal = 0;
+}
+
+/* This function writes out the trace: a wiznetTraceHeader and then the
+** records, oldest first. Transactions made by the writer itself, e.g. to
+** send the trace over a socket, are not traced. The trace is left as it is.
+**
+** writer - called with each piece of the trace in turn
+** ctx    - passed through to the writer
+**
+** returns - number of records written
+*/
+uint16_t wiznetTraceExport(wiznetTraceWriter writer, void* ctx) {
+	struct wiznetTraceHeader header;
+	uint16_t count, index, i;
+
+	count = wiznetTraceTotal < WIZNET_TRACE_DEPTH ? (uint16_t)wiznetTraceTotal : WIZNET_TRACE_DEPTH;
+	header.magic = WIZNET_TRACE_MAGIC;
+	header.version = WIZNET_TRACE_VERSION;
+	header.recordSize = sizeof(struct wiznetTraceRecord);
+#ifdef WIZNET_TRACE_HASH
+	header.flags = WIZNET_TRACE_FLAG_HASH;
+#else
+	header.flags = 0;
+#endif
+	header.reserved = 0;
+	header.siteBase = (uintptr_t)&wiznetIOBegin;
+	header.tickNs = WIZNET_TRACE_TICK_NS;
+	header.count = count;
+	header.dropped = wiznetTraceTotal - count;
+
+	wiznetTracePaused = 1;
+	writer(ctx, (const uint8_t*)&header, sizeof(header));
+	index = wiznetTraceHead >= count ? wiznetTraceHead - count : wiznetTraceHead + WIZNET_TRACE_DEPTH - count;
+	for (i = 0; i < count; i++) {
+		writer(ctx, (const uint8_t*)&wiznetTraceRing[index], sizeof(struct wiznetTraceRecord));
+		if (++index == WIZNET_TRACE_DEPTH)
+			index = 0;
+	}
+	wiznetTracePaused = 0;
+	return count;
+}
+#endif
+
+/* This function opens a transaction from a socket, direction and block
+** given as characters. The driver itself builds the control byte with
+** wiznetSocketControl and calls wiznetIOBeginControl.
+**
+** socket    - the socket number (0-7) or -1 for the common registers
+** address   - offset within the block
+** readWrite - 'r' or 'w'
+** type      - 'x' for the socket registers, 't' for its TX buffer or 'r' for
+**             its RX buffer; ignored for the common registers
+**
+** returns - 0 if succesful, -1 if type is not recognised
+*/
 int wiznetIOBegin(int socket, uint16_t address, char readWrite, char type) {
-	uint8_t bm = (readWrite == 'w' ? 1 : 0) << 2;	   //WARNING: readWrite is not checked to be 'r' or 'w' only
-	if (socket != -1) {
-		bm |= (socket << 5);
+	uint8_t control, block;
+	if (socket == -1)
+		control = wiznetCommonControl(readWrite == 'w');
+	else {
 		switch (type) {
 		case 'x':
-			bm |= 1 << 3;
+			block = WIZNET_BLOCK_REGS;
 			break;
 		case 't':
-			bm |= 2 << 3;
-			break;	
+			block = WIZNET_BLOCK_TX;
+			break;
 		case 'r':
-			bm |= 3 << 3;
+			block = WIZNET_BLOCK_RX;
 			break;
 		default:
 			return -1;
 		}
+		control = wiznetSocketControl(socket, block, readWrite == 'w');
 	}
-	wiznetSPIChipEnable();
-	wiznetSPITransceiveByte(BYTE1(address));   // address phase H
-	wiznetSPITransceiveByte(BYTE0(address));   // address phase L
-	wiznetSPITransceiveByte(bm);               // control phase
+	wiznetTraceCallSite();
+	wiznetIOBeginControl(address, control);
 	return 0;
 }
 
-/* This function writes a single byte (8-bit) to the wiznet.
-*/
-void wiznetRegWriteByte(int socket, uint16_t addr, uint8_t byte) {
-	wiznetIOBegin(socket, addr, 'w', 'x');
-	wiznetSPITransceiveByte(byte);
-	wiznetIOFinish();
-}
-
-uint8_t wiznetRegReadByte(int socket, uint16_t addr) {
-	uint8_t ret;
-	wiznetIOBegin(socket, addr, 'r', 'x');
-	ret = wiznetSPITransceiveByte(0xBF);
-	wiznetIOFinish();
-	return ret;
-}
-
-/* This function writes a single word (16-bit) to the wiznet.
-** The wiznet uses big-endian format for words.
-*/
-void wiznetRegWriteWord(int socket, uint16_t addr, uint16_t word) {
-	wiznetIOBegin(socket, addr, 'w', 'x');
-	wiznetSPITransceiveByte(BYTE1(word));
-	wiznetSPITransceiveByte(BYTE0(word));
-	wiznetIOFinish();
-}
-
-/* This function reads a single word (16-bit) from the wiznet.
-** The wiznet uses big-endian format for words.
+/* This function selects the chip and clocks out the address and control
+** phases of a transaction.
+**
+** address - offset within the block
+** control - the control phase byte
 */
-uint16_t wiznetRegReadWord(int socket, uint16_t addr) {
-	uint16_t ret;
-	wiznetIOBegin(socket, addr, 'r', 'x');
-	ret = (uint16_t)wiznetSPITransceiveByte(0xBE);
-	ret = (ret << 8) + (uint16_t)wiznetSPITransceiveByte(0xEF);
-	wiznetIOFinish();
-	return ret;
+void wiznetIOBeginControl(uint16_t address, uint8_t control) {
+#ifdef WIZNET_STATS
+	wiznetStatSocket = (control >> 3) != 0 ? control >> 5 : -1;
+	wiznetStatCounters.spiTransactions++;
+	if (wiznetStatSocket != -1)
+		wiznetStatCounters.sockets[wiznetStatSocket].spiTransactions++;
+	wiznetStatBytes(3);
+#endif
+#ifdef WIZNET_TRACE
+	wiznetTraceBegin(address, control, wiznetTraceCaller != NULL ? wiznetTraceCaller : __builtin_return_address(0));
+	wiznetTraceCaller = NULL;
+#endif
+	wiznetSPIChipEnable();
+	wiznetSPITransceiveByte(BYTE1(address));   // address phase H
+	wiznetSPITransceiveByte(BYTE0(address));   // address phase L
+	wiznetSPITransceiveByte(control);          // control phase
 }
 
-/* This function is used for all IP-related writes
-** reg  - wiznet register to write to
-** addr - buffer the read the IP address from
+/* This function clocks a block of bytes through the transaction opened by
+** wiznetIOBegin. The architecture's block primitive is used if it has one.
+**
+** tx     - bytes to send, or NULL to send filler bytes
+** rx     - destination for the bytes received, or NULL to discard them
+** length - number of bytes to clock
 */
-void wiznetRegWriteIP(int socket, uint16_t addr, uint8_t* ip) {
-	wiznetIOBegin(socket, addr, 'w', 'x');
-	wiznetSPITransceiveByte(ip[0]);
-	wiznetSPITransceiveByte(ip[1]);
-	wiznetSPITransceiveByte(ip[2]);
-	wiznetSPITransceiveByte(ip[3]);
-	wiznetIOFinish();
+void wiznetIOTransceiveBlock(const uint8_t* tx, uint8_t* rx, uint16_t length) {
+	wiznetStatBytes(length);
+#ifdef wiznetSPITransceiveBlock
+	wiznetSPITransceiveBlock(tx, rx, length);
+#else
+	uint16_t i;
+	uint8_t in;
+	for (i = 0; i < length; i++) {
+		in = wiznetSPITransceiveByte(tx != NULL ? tx[i] : 0xFF);
+		if (rx != NULL)
+			rx[i] = in;
+	}
+#endif
+	wiznetTraceData(tx, rx, length);
 }
 
-/* This function is used for all IP-related reads
-** reg  - wiznet register address to read from
-** addr - buffer to store the IP address
+/* This function reads registers in a single transaction
+**
+** control - control phase byte, see wiznetRegControl
+** addr    - first register
+** buf     - destination
+** length  - number of bytes
 */
-void wiznetRegReadIP(int socket, uint16_t addr, uint8_t* ip) {
-	wiznetIOBegin(socket, addr, 'r', 'x');
-	ip[0] = wiznetSPITransceiveByte(0xDE);
-	ip[1] = wiznetSPITransceiveByte(0xAD);
-	ip[2] = wiznetSPITransceiveByte(0xBE);
-	ip[3] = wiznetSPITransceiveByte(0xEF);
+void wiznetRegRead(uint8_t control, uint16_t addr, uint8_t* buf, uint8_t length) {
+	wiznetTraceCallSite();
+	wiznetIOBeginControl(addr, control);
+	wiznetIOTransceiveBlock(NULL, buf, length);
 	wiznetIOFinish();
 }
 
-/* This function writes an ethernet MAC address.
+/* This function writes registers in a single transaction
+**
+** control - control phase byte, see wiznetRegControl
+** addr    - first register
+** buf     - bytes to write
+** length  - number of bytes
 */
-void wiznetRegWriteMAC(int socket, uint16_t addr, uint8_t* mac) {
-	wiznetIOBegin(socket, addr, 'w', 'x');
-	wiznetSPITransceiveByte(mac[0]);
-	wiznetSPITransceiveByte(mac[1]);
-	wiznetSPITransceiveByte(mac[2]);
-	wiznetSPITransceiveByte(mac[3]);
-	wiznetSPITransceiveByte(mac[4]);
-	wiznetSPITransceiveByte(mac[5]);
+void wiznetRegWrite(uint8_t control, uint16_t addr, const uint8_t* buf, uint8_t length) {
+	wiznetTraceCallSite();
+	wiznetIOBeginControl(addr, control);
+	wiznetIOTransceiveBlock(buf, NULL, length);
 	wiznetIOFinish();
 }
 
-/* This function reads an ethernet MAC address into a buffer.
+/* This function runs a list of register accesses within one block (the
+** common registers, or a socket's), starting a new SPI transaction only when
+** an access does not carry on from the one before it. With variable-length
+** data mode the address auto-increments, so e.g. Sn_DIPR and Sn_DPORT, or
+** Sn_RX_RSR and Sn_RX_RD, cost a single transaction.
+**
+** socket - the socket number (0-7) or -1 for the common registers
+** ops    - the accesses, in order
+** count  - number of accesses
 */
-void wiznetRegReadMAC(int socket, uint16_t addr, uint8_t* mac) {
-	wiznetIOBegin(socket, addr, 'r', 'x');
-	mac[0] = wiznetSPITransceiveByte(0xC0);
-	mac[1] = wiznetSPITransceiveByte(0xFF);
-	mac[2] = wiznetSPITransceiveByte(0xEE);
-	mac[3] = wiznetSPITransceiveByte(0xBA);
-	mac[4] = wiznetSPITransceiveByte(0xBE);
-	mac[5] = wiznetSPITransceiveByte(0x69);
-	wiznetIOFinish();
+void wiznetRegBurst(int socket, const struct wiznetRegOp* ops, uint8_t count) {
+	uint8_t i;
+	for (i = 0; i < count; i++) {
+		if (i == 0 || ops[i].write != ops[i - 1].write
+				|| ops[i].addr != ops[i - 1].addr + ops[i - 1].length) {
+			if (i != 0)
+				wiznetIOFinish();
+			wiznetTraceCallSite();
+			wiznetIOBeginControl(ops[i].addr, wiznetRegControl(socket, ops[i].write));
+		}
+		if (ops[i].write)
+			wiznetIOTransceiveBlock(ops[i].data, NULL, ops[i].length);
+		else
+			wiznetIOTransceiveBlock(NULL, ops[i].data, ops[i].length);
+	}
+	if (count != 0)
+		wiznetIOFinish();
 }
 
 /* Run a socket command on a particular socket and waits for completion.
@@ -129,6 +324,51 @@ void wiznetRegReadMAC(int socket, uint16_t addr, uint8_t* mac) {
 */
 void wiznetSocketCommand(int socket, uint8_t command) {
 	wiznetSetSocketCommand(socket, command);
-	while(wiznetGetSocketCommand(socket));
+	wiznetSocketCommandWait(socket, command);
+}
+
+/* Wait for a socket command that has already been written to finish.
+**
+** socket  - the socket number (0-7)
+** command - the command
+*/
+void wiznetSocketCommandWait(int socket, uint8_t command) {
+	while(wiznetGetSocketCommand(socket))
+		wiznetSocketStatInc(socket, waitLoops);
+#ifdef WIZNET_SHADOW_REGISTERS
+	// Opening a socket moves the buffer pointers and a listening socket
+	// has its destination filled in by the chip.
+	if (command == Sn_CR_OPEN) {
+		wiznetShadowSockets[socket].txWrite = wiznetRegReadWord(socket, REG_Sn_TX_WR);
+		wiznetShadowSockets[socket].rxRead = wiznetRegReadWord(socket, REG_Sn_RX_RD);
+	} else if (command == Sn_CR_LISTEN)
+		wiznetShadowSockets[socket].destValid = 0;
+#else
+	(void)command;
+#endif
+}
+
+#ifdef WIZNET_SHADOW_REGISTERS
+/* This function rebuilds the shadow registers from the chip. It must be
+** called whenever the chip has been reset behind the driver's back;
+** wiznetReset calls it itself.
+*/
+void wiznetShadowResync(void) {
+	int i;
+	struct wiznetShadowSocket* shadow;
+
+	wiznetShadowSIMR = wiznetRegReadByte(-1, REG_SIMR);
+	for (i = 0; i < WIZNET_MAX_SOCKETS; i++) {
+		shadow = &wiznetShadowSockets[i];
+		shadow->mode = wiznetRegReadByte(i, REG_Sn_MR);
+		shadow->interruptMask = wiznetRegReadByte(i, REG_Sn_IMR);
+		shadow->rxBufSize = wiznetRegReadByte(i, REG_Sn_RXBUF_SIZE);
+		shadow->txBufSize = wiznetRegReadByte(i, REG_Sn_TXBUF_SIZE);
+		shadow->port = wiznetRegReadWord(i, REG_Sn_PORT);
+		shadow->txWrite = wiznetRegReadWord(i, REG_Sn_TX_WR);
+		shadow->rxRead = wiznetRegReadWord(i, REG_Sn_RX_RD);
+		shadow->destValid = 0;
+	}
 }
+#endif
 
@@ -1,3 +1,5 @@
+#ifndef WIZNET_IO_H
+#define WIZNET_IO_H
 #ifndef wiznetSPITransceiveByte
 	#error "wiznetSPITransceiveByte was not defined"
 #endif
@@ -7,23 +9,176 @@
 #ifndef wiznetSPIChipDisable
 	#error "wiznetSPIChipDisable was not defined"
 #endif
+// wiznetSPITransceiveBlock(tx, rx, len) is optional. A backend that can move
+// whole buffers (DMA, FIFO, memcpy) should define it; tx may be NULL to clock
+// out filler bytes and rx may be NULL to discard the bytes clocked in.
+// Without it the driver falls back to wiznetSPITransceiveByte.
+// wiznetSPIFlush() is also optional, for backends that hold back writes.
+#ifdef wiznetSPIFlush
+#define wiznetIOFlush() wiznetSPIFlush()
+#else
+#define wiznetIOFlush()
+#endif
+// wiznetINTAsserted() is optional and reports the level of the INTn line, so
+// that wiznetPoll can skip reading SIR while the chip has nothing to report.
+// wiznetTraceClock() is optional and returns a free-running 32-bit timestamp
+// in units of WIZNET_TRACE_TICK_NS nanoseconds, used by WIZNET_TRACE. Without
+// it transactions are stamped with a sequence number and take no time.
+// wiznetPollIdle() is optional and is called by wiznetPoll between passes;
+// it can sleep, or wait for an INTn edge, to give the passes a duration.
+#ifndef wiznetPollIdle
+#define wiznetPollIdle()
+#endif
+
+/* Control phase byte: block select (BSB), read/write (RWB) and operation mode
+** (OM, always variable-length data mode). With constant arguments these fold
+** to a constant, so an access compiles to a fixed header sequence.
+*/
+enum {
+	WIZNET_BLOCK_REGS = 1,
+	WIZNET_BLOCK_TX = 2,
+	WIZNET_BLOCK_RX = 3
+};
+#define WIZNET_CONTROL_WRITE 0x04
+#define wiznetCommonControl(write) ((uint8_t)((write) ? WIZNET_CONTROL_WRITE : 0))
+#define wiznetSocketControl(socket, block, write) \
+	((uint8_t)(((socket) << 5) | ((block) << 3) | ((write) ? WIZNET_CONTROL_WRITE : 0)))
+#define wiznetRegControl(socket, write) \
+	((socket) < 0 ? wiznetCommonControl(write) : wiznetSocketControl(socket, WIZNET_BLOCK_REGS, write))
 
-void wiznetRegWriteByte(int socket, uint16_t addr, uint8_t byte);
-uint8_t wiznetRegReadByte(int socket, uint16_t addr);
-void wiznetRegWriteWord(int socket, uint16_t addr, uint16_t word);
-uint16_t wiznetRegReadWord(int socket, uint16_t addr);
-void wiznetRegWriteIP(int socket, uint16_t addr, uint8_t* ip);
-void wiznetRegReadIP(int socket, uint16_t addr, uint8_t* ip);
-void wiznetRegWriteMAC(int socket, uint16_t addr, uint8_t* mac);
-void wiznetRegReadMAC(int socket, uint16_t addr, uint8_t* mac);
 void wiznetSocketCommand(int socket, uint8_t command);
+void wiznetSocketCommandWait(int socket, uint8_t command);
+
+/* One register access in a list run by wiznetRegBurst. Accesses that follow
+** on from the one before, in the same direction, share its SPI transaction.
+*/
+struct wiznetRegOp {
+	uint16_t addr;
+	uint8_t length;
+	uint8_t write;     //1 to write data to the register, 0 to read into it
+	uint8_t* data;
+};
+
+void wiznetRegBurst(int socket, const struct wiznetRegOp* ops, uint8_t count);
+
+#ifdef WIZNET_SHADOW_REGISTERS
+/* RAM copy of the registers that only the driver writes. Setters write
+** through and skip the SPI access if the value is unchanged, getters never
+** touch the chip. The destination address is the exception: the chip fills
+** it in when a peer connects to a listening socket, so it is only trusted
+** after the driver has written it.
+*/
+enum {
+	WIZNET_SHADOW_DEST_IP   = 0x01,
+	WIZNET_SHADOW_DEST_PORT = 0x02
+};
+
+struct wiznetShadowSocket {
+	uint8_t mode;
+	uint8_t interruptMask;
+	uint8_t rxBufSize;
+	uint8_t txBufSize;
+	uint16_t port;
+	uint16_t destPort;
+	uint8_t destIP[4];
+	uint8_t destValid;
+	uint16_t txWrite;
+	uint16_t rxRead;
+};
+
+extern uint8_t wiznetShadowSIMR;
+extern struct wiznetShadowSocket wiznetShadowSockets[WIZNET_MAX_SOCKETS];
+#endif
+
+#ifdef WIZNET_STATS
+extern struct wiznetStats wiznetStatCounters;
+void wiznetStatBytes(uint16_t length);
+#define wiznetStatInc(field) (wiznetStatCounters.field++)
+#define wiznetSocketStatInc(socket, field) (wiznetStatCounters.sockets[socket].field++)
+#define wiznetSocketStatAdd(socket, field, n) (wiznetStatCounters.sockets[socket].field += (n))
+#else
+#define wiznetStatBytes(length) ((void)0)
+#define wiznetStatInc(field) ((void)0)
+#define wiznetSocketStatInc(socket, field) ((void)0)
+#define wiznetSocketStatAdd(socket, field, n) ((void)0)
+#endif
+
+#ifdef WIZNET_TRACE
+extern void* wiznetTraceCaller;
+void wiznetTraceData(const uint8_t* tx, const uint8_t* rx, uint16_t length);
+void wiznetTraceEnd(void);
+// Used by the register helpers so that the access is charged to their caller
+#define wiznetTraceCallSite() (wiznetTraceCaller = __builtin_return_address(0))
+#else
+#define wiznetTraceData(tx, rx, length) ((void)0)
+#define wiznetTraceEnd() ((void)0)
+#define wiznetTraceCallSite() ((void)0)
+#endif
 
 int wiznetIOBegin(int socket, uint16_t address, char readWrite, char type);
+void wiznetIOBeginControl(uint16_t address, uint8_t control);
+void wiznetIOTransceiveBlock(const uint8_t* tx, uint8_t* rx, uint16_t length);
+void wiznetRegRead(uint8_t control, uint16_t addr, uint8_t* buf, uint8_t length);
+void wiznetRegWrite(uint8_t control, uint16_t addr, const uint8_t* buf, uint8_t length);
 
 inline uint8_t wiznetIOTransceive(uint8_t send) {
-	return wiznetSPITransceiveByte(send);
+	uint8_t ret;
+	wiznetStatBytes(1);
+	ret = wiznetSPITransceiveByte(send);
+	wiznetTraceData(&send, &ret, 1);
+	return ret;
 }
 
 inline void wiznetIOFinish(void) {
+	wiznetStatInc(chipSelects);
 	wiznetSPIChipDisable();
+	wiznetTraceEnd();
+}
+
+/* Register access helpers. The control byte is worked out here, so that it
+** is folded at compile time wherever the socket is known.
+*/
+static inline void wiznetRegWriteByte(int socket, uint16_t addr, uint8_t byte) {
+	wiznetRegWrite(wiznetRegControl(socket, 1), addr, &byte, 1);
 }
+
+static inline uint8_t wiznetRegReadByte(int socket, uint16_t addr) {
+	uint8_t ret;
+	wiznetRegRead(wiznetRegControl(socket, 0), addr, &ret, 1);
+	return ret;
+}
+
+/* This function writes a single word (16-bit) to the wiznet.
+** The wiznet uses big-endian format for words.
+*/
+static inline void wiznetRegWriteWord(int socket, uint16_t addr, uint16_t word) {
+	uint8_t buf[2] = {BYTE1(word), BYTE0(word)};
+	wiznetRegWrite(wiznetRegControl(socket, 1), addr, buf, sizeof(buf));
+}
+
+/* This function reads a single word (16-bit) from the wiznet.
+** The wiznet uses big-endian format for words.
+*/
+static inline uint16_t wiznetRegReadWord(int socket, uint16_t addr) {
+	uint8_t buf[2];
+	wiznetRegRead(wiznetRegControl(socket, 0), addr, buf, sizeof(buf));
+	return (((uint16_t)buf[0]) << 8) + buf[1];
+}
+
+static inline void wiznetRegWriteIP(int socket, uint16_t addr, uint8_t* ip) {
+	wiznetRegWrite(wiznetRegControl(socket, 1), addr, ip, 4);
+}
+
+static inline void wiznetRegReadIP(int socket, uint16_t addr, uint8_t* ip) {
+	wiznetRegRead(wiznetRegControl(socket, 0), addr, ip, 4);
+}
+
+static inline void wiznetRegWriteMAC(int socket, uint16_t addr, uint8_t* mac) {
+	wiznetRegWrite(wiznetRegControl(socket, 1), addr, mac, 6);
+}
+
+static inline void wiznetRegReadMAC(int socket, uint16_t addr, uint8_t* mac) {
+	wiznetRegRead(wiznetRegControl(socket, 0), addr, mac, 6);
+}
+
+#endif
@@ -0,0 +1,166 @@
+#include <stdint.h>
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/snmp.h"
+#include "lwip/etharp.h"
+#include "lwip/ethip6.h"
+#include "netif/ethernet.h"
+#include "io_assignment.h"
+#include "util.h"
+#include "wiznet.h"
+#include "wiznet_arch.h"
+#include "wiznet_io.h"
+#include "wiznet_regs.h"
+#include "wiznet_lwip.h"
+
+/* This function sends a frame handed down by lwIP. The pbuf chain is
+** gathered straight into the chip's TX memory in one SPI write; chains
+** longer than WIZNET_LWIP_IOV are copied into a single pbuf first. The
+** SEND is not waited for, so lwIP can prepare the next frame meanwhile.
+*/
+static err_t wiznetLwipOutput(struct netif* netif, struct pbuf* p) {
+	struct wiznetIOVec iov[WIZNET_LWIP_IOV];
+	struct pbuf *q, *flat = NULL;
+	uint8_t count = 0;
+	int ret;
+
+	(void)netif;
+#if ETH_PAD_SIZE
+	pbuf_remove_header(p, ETH_PAD_SIZE);
+#endif
+	if (pbuf_clen(p) > WIZNET_LWIP_IOV) {
+		flat = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+		if (flat == NULL) {
+#if ETH_PAD_SIZE
+			pbuf_add_header(p, ETH_PAD_SIZE);
+#endif
+			LINK_STATS_INC(link.memerr);
+			LINK_STATS_INC(link.drop);
+			return ERR_MEM;
+		}
+	}
+	for (q = (flat != NULL) ? flat : p; q != NULL; q = q->next) {
+		iov[count].base = (const uint8_t*)q->payload;
+		iov[count].length = q->len;
+		count++;
+	}
+	ret = wiznetSendMACRAWV(WIZNET_LWIP_SOCKET, iov, count);
+	if (flat != NULL)
+		pbuf_free(flat);
+#if ETH_PAD_SIZE
+	pbuf_add_header(p, ETH_PAD_SIZE);
+#endif
+
+	if (ret != WIZNET_SUCCESS) {
+		LINK_STATS_INC(link.err);
+		return ERR_IF;
+	}
+	MIB2_STATS_NETIF_ADD(netif, ifoutoctets, p->tot_len);
+	LINK_STATS_INC(link.xmit);
+	return ERR_OK;
+}
+
+/* This function sets up the netif and opens the MACRAW socket. It is passed
+** to netif_add.
+**
+** netif - the interface being added
+**
+** returns - ERR_OK if succesful
+**         - ERR_IF if the MACRAW socket could not be opened
+*/
+err_t wiznetLwipInit(struct netif* netif) {
+	netif->name[0] = 'w';
+	netif->name[1] = 'z';
+#if LWIP_IPV4
+	netif->output = etharp_output;
+#endif
+#if LWIP_IPV6
+	netif->output_ip6 = ethip6_output;
+#endif
+	netif->linkoutput = wiznetLwipOutput;
+	MIB2_INIT_NETIF(netif, snmp_ifType_ethernet_csmacd, 0);
+
+	netif->mtu = 1500;
+	netif->hwaddr_len = ETH_HWADDR_LEN;
+	wiznetGetSourceMAC(netif->hwaddr);
+	netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET | NETIF_FLAG_LINK_UP;
+
+	if (wiznetOpenSocket(WIZNET_LWIP_SOCKET, SOCK_MACRAW, 0, WIZNET_LWIP_MODE) != WIZNET_SUCCESS)
+		return ERR_IF;
+	return ERR_OK;
+}
+
+/* This function moves the frames waiting in the chip into lwIP. Up to
+** WIZNET_LWIP_BATCH frames are read straight into pbufs, one SPI read per
+** header and per pbuf in the chain, and released to the chip with a single
+** RECEIVE before any of them is handed to netif->input. It is meant to be
+** called from the main loop, or when INTn reports Sn_IR_RECEIVE. A header
+** giving a length no frame can have drops all the data waiting, as for
+** wiznetRecvMACRAWBatch.
+**
+** netif - the interface added with wiznetLwipInit
+**
+** returns - number of frames passed to lwIP
+*/
+int wiznetLwipPoll(struct netif* netif) {
+	struct pbuf* frames[WIZNET_LWIP_BATCH];
+	struct wiznetTransaction* rx;
+	struct pbuf *p, *q;
+	uint16_t remaining, length;
+	uint8_t n = 0, taken = 0, i;
+
+	if (wiznetRxBeginBounded(WIZNET_LWIP_SOCKET, &rx, &remaining) != WIZNET_SUCCESS)
+		return 0;
+	while (taken < WIZNET_LWIP_BATCH && remaining >= 2) {
+		length = wiznetRxHeaderMACRAW(rx);
+		if (!wiznetMACRAWValid(length)) {
+			wiznetRxCommitAll(rx);
+			LINK_STATS_INC(link.err);
+			LINK_STATS_INC(link.drop);
+			MIB2_STATS_NETIF_INC(netif, ifinerrors);
+			break;
+		}
+		if ((uint32_t)length + 2 > remaining) {
+			// Only part of this frame has been received
+			rx->cur -= 2;
+			break;
+		}
+		remaining -= length + 2;
+		taken++;
+
+		p = pbuf_alloc(PBUF_RAW, length + ETH_PAD_SIZE, PBUF_POOL);
+		if (p == NULL) {
+			wiznetRxData(rx, NULL, length);
+			LINK_STATS_INC(link.memerr);
+			LINK_STATS_INC(link.drop);
+			MIB2_STATS_NETIF_INC(netif, ifindiscards);
+			continue;
+		}
+#if ETH_PAD_SIZE
+		pbuf_remove_header(p, ETH_PAD_SIZE);
+#endif
+		for (q = p; q != NULL; q = q->next)
+			wiznetRxData(rx, (uint8_t*)q->payload, q->len);
+#if ETH_PAD_SIZE
+		pbuf_add_header(p, ETH_PAD_SIZE);
+#endif
+		MIB2_STATS_NETIF_ADD(netif, ifinoctets, p->tot_len);
+		LINK_STATS_INC(link.recv);
+		frames[n++] = p;
+	}
+	// A corrupt header has already ended the transaction
+	if (rx->active) {
+		if (rx->cur == rx->start)
+			wiznetRxAbandon(rx);
+		else
+			wiznetRxCommit(rx, 0);
+	}
+	wiznetSocketStatAdd(WIZNET_LWIP_SOCKET, datagrams, taken);
+
+	for (i = 0; i < n; i++)
+		if (netif->input(frames[i], netif) != ERR_OK)
+			pbuf_free(frames[i]);
+	return n;
+}
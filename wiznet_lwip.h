@@ -0,0 +1,48 @@
+#ifndef WIZNET_LWIP_H
+#define WIZNET_LWIP_H
+#include "lwip/err.h"
+#include "lwip/netif.h"
+
+/*
+** lwIP network interface over a MACRAW socket
+**
+** Socket WIZNET_LWIP_SOCKET (socket 0, the only one the chip allows in
+** MACRAW mode) is opened in MACRAW mode and Ethernet frames are moved
+** between the chip's buffers and lwIP pbufs, so that lwIP's own TCP/IP
+** stack, with as many connections as it is configured for, runs over the
+** W5500 instead of the chip's 8 hardware sockets.
+**
+** The source MAC address must be set with wiznetSetSourceMAC before the
+** interface is added; it is read back into the netif. Typical use:
+**
+**   netif_add(&netif, &ip, &mask, &gw, NULL, wiznetLwipInit, ethernet_input);
+**   for (;;) {
+**       wiznetLwipPoll(&netif);
+**       sys_check_timeouts();
+**   }
+**
+** host/test_lwip runs this against a stand-in for the lwIP API used here
+** (pbuf, netif, err_t and the stats macros) on the host model of the chip.
+** It has not been built against a real lwIP release or run on hardware, and
+** neither lwIP's test applications nor any connection scaling or throughput
+** figures have been checked with it.
+**
+************************************/
+
+#ifndef WIZNET_LWIP_SOCKET
+#define WIZNET_LWIP_SOCKET 0
+#endif
+#ifndef WIZNET_LWIP_BATCH
+#define WIZNET_LWIP_BATCH 8     //Most frames taken per RECEIVE by wiznetLwipPoll
+#endif
+#ifndef WIZNET_LWIP_IOV
+#define WIZNET_LWIP_IOV 4       //Longest pbuf chain sent without a copy
+#endif
+#ifndef WIZNET_LWIP_MODE
+#define WIZNET_LWIP_MODE 0x80   //Sn_MR_MFEN: only frames for our MAC, broadcast and multicast
+#endif
+
+err_t wiznetLwipInit(struct netif* netif);
+int wiznetLwipPoll(struct netif* netif);
+
+#endif
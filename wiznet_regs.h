@@ -1,3 +1,5 @@
+#ifndef WIZNET_REGS_H
+#define WIZNET_REGS_H
 #include <stdint.h>
 #include "wiznet_regs_defs.h"
 
@@ -122,13 +124,22 @@ static inline uint8_t wiznetGetInterruptsOnSockets(void) {
 ** 1 - interrupt enabled
 */
 static inline void wiznetSetInterruptsOnSocketsMask(uint8_t mask) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	if (wiznetShadowSIMR == mask)
+		return;
+	wiznetShadowSIMR = mask;
+#endif
 	wiznetRegWriteByte(-1, REG_SIMR,mask);
 }
 
 /* This function reads from the socket interrupt mask register
 */
 static inline uint8_t wiznetGetInterruptsOnSocketsMask(void) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	return wiznetShadowSIMR;
+#else
 	return wiznetRegReadByte(-1, REG_SIMR);
+#endif
 }
 
 /* This function writes to the retry time register
@@ -198,13 +209,22 @@ static inline uint8_t wiznetGetChipVersion(void) {
 /* This function writes to the socket-specific mode register
 */
 static inline void wiznetSetSocketMode(uint8_t socket, uint8_t mode) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	if (wiznetShadowSockets[socket].mode == mode)
+		return;
+	wiznetShadowSockets[socket].mode = mode;
+#endif
 	wiznetRegWriteByte(socket, REG_Sn_MR, mode);
 }
 
 /* This function reads from the socket-specific mode register
 */
 static inline uint8_t wiznetGetSocketMode(uint8_t socket) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	return wiznetShadowSockets[socket].mode;
+#else
 	return wiznetRegReadByte(socket, REG_Sn_MR);
+#endif
 }
 
 /* This function write to the socket-specific command register
@@ -213,6 +233,19 @@ static inline void wiznetSetSocketCommand(uint8_t socket, uint8_t command) {
 	wiznetRegWriteByte(socket, REG_Sn_CR, command);
 }
 
+/* This function writes the socket-specific mode register and then the
+** command register in one transaction, so the command sees the new mode.
+** The caller waits for the command with wiznetSocketCommandWait.
+*/
+static inline void wiznetSetSocketModeAndCommand(uint8_t socket, uint8_t mode, uint8_t command) {
+	uint8_t buf[2] = {mode, command};
+	struct wiznetRegOp ops[1] = {{REG_Sn_MR, 2, 1, buf}};
+#ifdef WIZNET_SHADOW_REGISTERS
+	wiznetShadowSockets[socket].mode = mode;
+#endif
+	wiznetRegBurst(socket, ops, 1);
+}
+
 /* This function reads from the socket-specific command register
 ** The command register is cleared to 0 when a command has finished
 */
@@ -239,16 +272,40 @@ static inline uint8_t wiznetGetSocketStatus(uint8_t socket) {
 	return wiznetRegReadByte(socket, REG_Sn_SR);
 }
 
+/* This function reads the socket-specific interrupt and status registers
+** together
+**
+** ir - set to the interrupt register
+**
+** returns - the status register
+*/
+static inline uint8_t wiznetGetSocketInterruptAndStatus(uint8_t socket, uint8_t* ir) {
+	uint8_t buf[2];
+	struct wiznetRegOp ops[2] = {{REG_Sn_IR, 1, 0, &buf[0]}, {REG_Sn_SR, 1, 0, &buf[1]}};
+	wiznetRegBurst(socket, ops, 2);
+	*ir = buf[0];
+	return buf[1];
+}
+
 /* This function writes the socket-specific source port
 */
 static inline void wiznetSetSocketSourcePort(uint8_t socket, uint16_t port) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	if (wiznetShadowSockets[socket].port == port)
+		return;
+	wiznetShadowSockets[socket].port = port;
+#endif
 	wiznetRegWriteWord(socket, REG_Sn_PORT, port);
 }
 
 /* This function reads the socket-specific source port
 */
 static inline uint16_t wiznetGetSocketSourcePort(uint8_t socket) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	return wiznetShadowSockets[socket].port;
+#else
 	return wiznetRegReadWord(socket, REG_Sn_PORT);
+#endif
 }
 
 /* This function writes the destination MAC address
@@ -266,6 +323,17 @@ static inline void wiznetGetSocketDestMAC(uint8_t socket, uint8_t* mac) {
 /* This function writes the socket-specific destination IP Address
 */
 static inline void wiznetSetSocketDestIP(uint8_t socket, uint8_t* dIP) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	struct wiznetShadowSocket* shadow = &wiznetShadowSockets[socket];
+	if ((shadow->destValid & WIZNET_SHADOW_DEST_IP) && shadow->destIP[0] == dIP[0]
+			&& shadow->destIP[1] == dIP[1] && shadow->destIP[2] == dIP[2] && shadow->destIP[3] == dIP[3])
+		return;
+	shadow->destIP[0] = dIP[0];
+	shadow->destIP[1] = dIP[1];
+	shadow->destIP[2] = dIP[2];
+	shadow->destIP[3] = dIP[3];
+	shadow->destValid |= WIZNET_SHADOW_DEST_IP;
+#endif
 	wiznetRegWriteIP(socket, REG_Sn_DIPR, dIP);
 }
 
@@ -278,6 +346,13 @@ static inline void wiznetGetSocketDestIP(uint8_t socket, uint8_t* dIP) {
 /* This function writes to the socket-specific destination port register
 */
 static inline void wiznetSetSocketDestPort(uint8_t socket, uint16_t port) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	struct wiznetShadowSocket* shadow = &wiznetShadowSockets[socket];
+	if ((shadow->destValid & WIZNET_SHADOW_DEST_PORT) && shadow->destPort == port)
+		return;
+	shadow->destPort = port;
+	shadow->destValid |= WIZNET_SHADOW_DEST_PORT;
+#endif
 	wiznetRegWriteWord(socket, REG_Sn_DPORT, port);
 }
 
@@ -287,6 +362,28 @@ static inline uint16_t wiznetGetSocketDestPort(uint8_t socket) {
 	return wiznetRegReadWord(socket, REG_Sn_DPORT);
 }
 
+/* This function writes the socket-specific destination IP and port
+** registers in one transaction
+*/
+static inline void wiznetSetSocketDest(uint8_t socket, uint8_t* dIP, uint16_t port) {
+	uint8_t portBuf[2] = {BYTE1(port), BYTE0(port)};
+	struct wiznetRegOp ops[2] = {{REG_Sn_DIPR, 4, 1, dIP}, {REG_Sn_DPORT, 2, 1, portBuf}};
+#ifdef WIZNET_SHADOW_REGISTERS
+	struct wiznetShadowSocket* shadow = &wiznetShadowSockets[socket];
+	if (shadow->destValid == (WIZNET_SHADOW_DEST_IP | WIZNET_SHADOW_DEST_PORT) && shadow->destPort == port
+			&& shadow->destIP[0] == dIP[0] && shadow->destIP[1] == dIP[1]
+			&& shadow->destIP[2] == dIP[2] && shadow->destIP[3] == dIP[3])
+		return;
+	shadow->destIP[0] = dIP[0];
+	shadow->destIP[1] = dIP[1];
+	shadow->destIP[2] = dIP[2];
+	shadow->destIP[3] = dIP[3];
+	shadow->destPort = port;
+	shadow->destValid = WIZNET_SHADOW_DEST_IP | WIZNET_SHADOW_DEST_PORT;
+#endif
+	wiznetRegBurst(socket, ops, 2);
+}
+
 /* This function writes to the socket-specific maximum segment size register
 */
 static inline void wiznetSetSocketMaximumSegmentSize(uint8_t socket, uint8_t mssr) {
@@ -326,25 +423,43 @@ static inline uint8_t wiznetGetSocketTimeToLive(uint8_t socket) {
 /* This function writes to the socket-specific reception buffer size register
 */
 static inline void wiznetSetSocketRXBufferSize(uint8_t socket, uint8_t size) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	if (wiznetShadowSockets[socket].rxBufSize == size)
+		return;
+	wiznetShadowSockets[socket].rxBufSize = size;
+#endif
 	wiznetRegWriteByte(socket, REG_Sn_RXBUF_SIZE, size);
 }
 
 /* This function reads from the socket-specific reception buffer size register
 */
 static inline uint8_t wiznetGetSocketRXBufferSize(uint8_t socket) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	return wiznetShadowSockets[socket].rxBufSize;
+#else
 	return wiznetRegReadByte(socket, REG_Sn_RXBUF_SIZE);
+#endif
 }
 
 /* This function writes to the socket-specific transmission buffer size register
 */
 static inline void wiznetSetSocketTXBufferSize(uint8_t socket, uint8_t size) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	if (wiznetShadowSockets[socket].txBufSize == size)
+		return;
+	wiznetShadowSockets[socket].txBufSize = size;
+#endif
 	wiznetRegWriteByte(socket, REG_Sn_TXBUF_SIZE, size);
 }
 
 /* This function reads from the socket-specific transmission buffer size register
 */
 static inline uint8_t wiznetGetSocketTXBufferSize(uint8_t socket) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	return wiznetShadowSockets[socket].txBufSize;
+#else
 	return wiznetRegReadByte(socket, REG_Sn_TXBUF_SIZE);
+#endif
 }
 
 /* This function reads from the socket-specific Transmission buffer free size register
@@ -364,13 +479,22 @@ static inline uint16_t wiznetGetSocketTXReadPointer(uint8_t socket) {
 /* This function writes to the socket-specific Transmission write pointer register
 */
 static inline void wiznetSetSocketTXWritePointer(uint8_t socket, uint16_t addr) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	if (wiznetShadowSockets[socket].txWrite == addr)
+		return;
+	wiznetShadowSockets[socket].txWrite = addr;
+#endif
 	wiznetRegWriteWord(socket, REG_Sn_TX_WR, addr);
 }
 
 /* This function reads from the socket-specific Transmission write pointer register
 */
 static inline uint16_t wiznetGetSocketTXWritePointer(uint8_t socket) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	return wiznetShadowSockets[socket].txWrite;
+#else
 	return wiznetRegReadWord(socket, REG_Sn_TX_WR);
+#endif
 }
 
 /* This function reads from the socket-specific Reception buffer received size register
@@ -380,14 +504,43 @@ static inline uint16_t wiznetGetSocketRXReceivedSize(uint8_t socket) {
 	return wiznetRegReadWord(socket, REG_Sn_RX_RSR);
 }
 
+/* This function reads the socket-specific reception buffer received size and
+** read-pointer registers together
+**
+** rsr - set to the received size
+**
+** returns - the read pointer
+*/
+static inline uint16_t wiznetGetSocketRXState(uint8_t socket, uint16_t* rsr) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	*rsr = wiznetRegReadWord(socket, REG_Sn_RX_RSR);
+	return wiznetShadowSockets[socket].rxRead;
+#else
+	uint8_t buf[4];
+	struct wiznetRegOp ops[2] = {{REG_Sn_RX_RSR, 2, 0, &buf[0]}, {REG_Sn_RX_RD, 2, 0, &buf[2]}};
+	wiznetRegBurst(socket, ops, 2);
+	*rsr = (((uint16_t)buf[0]) << 8) + buf[1];
+	return (((uint16_t)buf[2]) << 8) + buf[3];
+#endif
+}
+
 /* This function reads from the socket-specific reception buffer read-pointer register
 */
 static inline uint16_t wiznetGetSocketRXReadPointer(uint8_t socket) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	return wiznetShadowSockets[socket].rxRead;
+#else
 	return wiznetRegReadWord(socket, REG_Sn_RX_RD);
+#endif
 }
 /* This function writes to the socket-specific reception buffer read-pointer register
 */
 static inline void wiznetSetSocketRXReadPointer(uint8_t socket, uint16_t addr) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	if (wiznetShadowSockets[socket].rxRead == addr)
+		return;
+	wiznetShadowSockets[socket].rxRead = addr;
+#endif
 	wiznetRegWriteWord(socket, REG_Sn_RX_RD, addr);
 }
 
@@ -406,13 +559,22 @@ static inline uint16_t wiznetGetSocketRXWritePointer(uint8_t socket) {
 /* This function writea to the socket-specific interrupt mask register
 */
 static inline void wiznetSetSocketInterruptMask(uint8_t socket, uint8_t mask) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	if (wiznetShadowSockets[socket].interruptMask == mask)
+		return;
+	wiznetShadowSockets[socket].interruptMask = mask;
+#endif
 	wiznetRegWriteByte(socket, REG_Sn_IMR, mask);
 }
 
 /* This function reads from the socket-specific interrupt mask register
 */
 static inline uint8_t wiznetGetSocketInterruptMask(uint8_t socket) {
+#ifdef WIZNET_SHADOW_REGISTERS
+	return wiznetShadowSockets[socket].interruptMask;
+#else
 	return wiznetRegReadByte(socket, REG_Sn_IMR);
+#endif
 }
 
 /* This function writea to the socket-specific fragment offset register
@@ -439,3 +601,4 @@ static inline uint8_t wiznetGetSocketKeepAliveTime(uint8_t socket) {
 	return wiznetRegReadByte(socket, REG_Sn_KPALVTR);
 }
 
+#endif
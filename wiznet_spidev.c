@@ -0,0 +1,288 @@
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+#include "wiznet_spidev.h"
+#ifdef WIZNET_SPIDEV_STANDIN
+#include "wiznet_host.h"
+#endif
+
+/* Queued transfers and the bytes they carry
+*/
+static struct spi_ioc_transfer spidevXfers[WIZNET_SPIDEV_MAX_TRANSFERS];
+static uint8_t spidevTX[WIZNET_SPIDEV_BUFFER_SIZE];
+static uint8_t spidevRX[WIZNET_SPIDEV_BUFFER_SIZE];
+static uint16_t spidevUsed;
+static uint8_t spidevCount;
+static int spidevFd = -1;
+
+/* State of the transaction currently being built
+*/
+static uint8_t spidevSelected;
+static uint8_t spidevPhase;
+static uint8_t spidevHeader[3];
+static uint8_t spidevXferOpen;
+static uint16_t spidevXferStart;
+
+static struct wiznetSpidevStats spidevStats;
+static int spidevError;
+
+#ifdef WIZNET_SPIDEV_STANDIN
+static uint8_t spidevFailures;
+
+/* This function stands in for ioctl(SPI_IOC_MESSAGE) by clocking each
+** transfer through the host chip model, honouring cs_change between them.
+*/
+static int spidevIoctl(int fd, uint8_t count, struct spi_ioc_transfer* xfers) {
+	uint8_t i, selected = 0;
+	(void)fd;
+	if (spidevFailures) {
+		spidevFailures--;
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		if (!selected) {
+			wiznetHostChipEnable();
+			selected = 1;
+		}
+		wiznetHostTransceiveBlock((const uint8_t*)(uintptr_t)xfers[i].tx_buf,
+				(uint8_t*)(uintptr_t)xfers[i].rx_buf, xfers[i].len);
+		if (xfers[i].cs_change || i == count - 1) {
+			wiznetHostChipDisable();
+			selected = 0;
+		}
+	}
+	return 0;
+}
+
+/* This function makes the next ioctls fail without reaching the chip model
+**
+** count - number of SPI_IOC_MESSAGE calls to fail
+*/
+void wiznetSpidevFailNext(uint8_t count) {
+	spidevFailures = count;
+}
+#else
+static int spidevIoctl(int fd, uint8_t count, struct spi_ioc_transfer* xfers) {
+	return ioctl(fd, SPI_IOC_MESSAGE(count), xfers);
+}
+#endif
+
+/* This function closes the transfer being built so that the chip is
+** de-selected after it.
+*/
+static void spidevCloseXfer(void) {
+	struct spi_ioc_transfer* xfer;
+	if (!spidevXferOpen)
+		return;
+	xfer = &spidevXfers[spidevCount++];
+	memset(xfer, 0, sizeof(*xfer));
+	xfer->tx_buf = (uintptr_t)&spidevTX[spidevXferStart];
+	xfer->rx_buf = (uintptr_t)&spidevRX[spidevXferStart];
+	xfer->len = spidevUsed - spidevXferStart;
+	xfer->cs_change = 1;
+	spidevXferOpen = 0;
+}
+
+/* This function opens a new transfer with the current header. The header
+** address is advanced as data is queued, so a transaction split across
+** transfers resumes at the right place in variable-length data mode.
+*/
+static void spidevOpenXfer(void) {
+	if (spidevCount == WIZNET_SPIDEV_MAX_TRANSFERS || spidevUsed + sizeof(spidevHeader) >= WIZNET_SPIDEV_BUFFER_SIZE)
+		wiznetSpidevFlush();
+	spidevXferStart = spidevUsed;
+	memcpy(&spidevTX[spidevUsed], spidevHeader, sizeof(spidevHeader));
+	spidevUsed += sizeof(spidevHeader);
+	spidevXferOpen = 1;
+}
+
+/* This function queues data-phase bytes. Reads are flushed straight away,
+** together with everything queued before them, so their result can be
+** handed back. A read whose message failed returns zeros rather than
+** whatever was last left in the receive buffer.
+*/
+static void spidevData(const uint8_t* tx, uint8_t* rx, uint16_t len) {
+	uint16_t chunk, addr, start;
+	while (len) {
+		if (!spidevXferOpen)
+			spidevOpenXfer();
+		chunk = WIZNET_SPIDEV_BUFFER_SIZE - spidevUsed;
+		if (chunk == 0) {
+			spidevCloseXfer();
+			wiznetSpidevFlush();
+			continue;
+		}
+		if (chunk > len)
+			chunk = len;
+		start = spidevUsed;
+		if (tx != NULL) {
+			memcpy(&spidevTX[start], tx, chunk);
+			tx += chunk;
+		} else
+			memset(&spidevTX[start], 0xFF, chunk);
+		spidevUsed += chunk;
+		len -= chunk;
+
+		addr = (((uint16_t)spidevHeader[0]) << 8) + spidevHeader[1] + chunk;
+		spidevHeader[0] = (uint8_t)(addr >> 8);
+		spidevHeader[1] = (uint8_t)addr;
+
+		if (rx != NULL) {
+			spidevCloseXfer();
+			if (wiznetSpidevFlush() == 0)
+				memcpy(rx, &spidevRX[start], chunk);
+			else
+				memset(rx, 0, chunk);
+			rx += chunk;
+		}
+	}
+}
+
+/* This function clocks one byte. Header and write bytes are queued and
+** return 0; a read byte is fetched at once.
+*/
+uint8_t wiznetSpidevTransceiveByte(uint8_t data) {
+	uint8_t ret;
+	if (spidevPhase < sizeof(spidevHeader)) {
+		spidevHeader[spidevPhase++] = data;
+		return 0x00;
+	}
+	if (spidevHeader[2] & 0x04) {
+		spidevData(&data, NULL, 1);
+		return 0x00;
+	}
+	spidevData(&data, &ret, 1);
+	return ret;
+}
+
+/* This function clocks a block of bytes as part of the current transaction
+*/
+void wiznetSpidevTransceiveBlock(const uint8_t* tx, uint8_t* rx, uint16_t len) {
+	while (spidevPhase < sizeof(spidevHeader) && len) {
+		wiznetSpidevTransceiveByte(tx ? *tx++ : 0xFF);
+		len--;
+	}
+	if (spidevHeader[2] & 0x04)
+		rx = NULL;
+	spidevData(tx, rx, len);
+}
+
+/* This function starts a new transaction
+*/
+void wiznetSpidevChipEnable(void) {
+	spidevSelected = 1;
+	spidevPhase = 0;
+}
+
+/* This function ends the current transaction. Unless writes are posted it
+** is sent immediately.
+*/
+void wiznetSpidevChipDisable(void) {
+	if (!spidevSelected)
+		return;
+	spidevSelected = 0;
+	spidevCloseXfer();
+#ifdef WIZNET_SPIDEV_POSTED_WRITES
+	if (spidevCount < WIZNET_SPIDEV_MAX_TRANSFERS)
+		return;
+#endif
+	wiznetSpidevFlush();
+}
+
+/* This function sends every queued transfer in a single SPI_IOC_MESSAGE.
+** A failure is latched for wiznetSpidevError and the queue is dropped.
+**
+** returns - 0 if succesful, -1 if the ioctl failed
+*/
+int wiznetSpidevFlush(void) {
+	int ret = 0;
+	if (spidevCount == 0)
+		return 0;
+	// cs_change on the final transfer would leave the chip selected
+	spidevXfers[spidevCount - 1].cs_change = 0;
+	if (spidevIoctl(spidevFd, spidevCount, spidevXfers) < 0) {
+		spidevError = -1;
+		spidevStats.errors++;
+		ret = -1;
+	} else {
+		spidevStats.syscalls++;
+		spidevStats.transfers += spidevCount;
+		spidevStats.bytes += spidevUsed;
+	}
+	spidevCount = 0;
+	spidevUsed = 0;
+	return ret;
+}
+
+/* This function reports and clears a latched ioctl failure. Register reads
+** carried by a failed message returned zeros, and writes in it were lost.
+**
+** returns - 0 if every ioctl since the last call succeeded, -1 otherwise
+*/
+int wiznetSpidevError(void) {
+	int ret = spidevError;
+	spidevError = 0;
+	return ret;
+}
+
+/* This function opens and configures the spidev device (SPI mode 0, 8 bits)
+**
+** path  - device node, e.g. "/dev/spidev0.0"
+** speed - SCLK frequency in Hz
+**
+** returns - 0 if succesful, -1 otherwise
+*/
+int wiznetSpidevOpen(const char* path, uint32_t speed) {
+	uint8_t mode = SPI_MODE_0, bits = 8;
+	spidevCount = 0;
+	spidevUsed = 0;
+	spidevXferOpen = 0;
+	spidevSelected = 0;
+	spidevError = 0;
+#ifdef WIZNET_SPIDEV_STANDIN
+	(void)path;
+	(void)speed;
+	(void)mode;
+	(void)bits;
+	spidevFd = 0;
+	return 0;
+#else
+	spidevFd = open(path, O_RDWR);
+	if (spidevFd < 0)
+		return -1;
+	if (ioctl(spidevFd, SPI_IOC_WR_MODE, &mode) < 0
+			|| ioctl(spidevFd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0
+			|| ioctl(spidevFd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
+		wiznetSpidevClose();
+		return -1;
+	}
+	return 0;
+#endif
+}
+
+/* This function flushes any queued transfers and closes the device
+*/
+void wiznetSpidevClose(void) {
+	if (spidevFd < 0)
+		return;
+	wiznetSpidevFlush();
+#ifndef WIZNET_SPIDEV_STANDIN
+	close(spidevFd);
+#endif
+	spidevFd = -1;
+}
+
+/* This function copies out the system call statistics
+*/
+void wiznetSpidevGetStats(struct wiznetSpidevStats* stats) {
+	*stats = spidevStats;
+}
+
+/* This function clears the system call statistics
+*/
+void wiznetSpidevResetStats(void) {
+	memset(&spidevStats, 0, sizeof(spidevStats));
+}
@@ -0,0 +1,62 @@
+#ifndef WIZNET_SPIDEV_H
+#define WIZNET_SPIDEV_H
+#include <stdint.h>
+
+/*
+** Linux user-space backend on /dev/spidevX.Y
+**
+** Each transaction opened by wiznetIOBegin is sent as a single
+** spi_ioc_transfer holding the 3-byte header and the data phase. Transactions
+** are queued and go out together in one SPI_IOC_MESSAGE when a read needs its
+** result, when the queue fills, or when the chip is de-selected.
+**
+** With WIZNET_SPIDEV_POSTED_WRITES defined, write transactions stay queued
+** after the chip is de-selected so that consecutive register writes and the
+** read that follows them share one ioctl. The driver flushes at the end of
+** the calls that leave writes behind; code that writes registers directly
+** through wiznet_regs.h must call wiznetSpidevFlush() itself.
+**
+** With WIZNET_SPIDEV_STANDIN defined, the ioctl layer is replaced by a local
+** stand-in that plays each message through the host chip model
+** (wiznet_host.c), so the backend can be exercised without hardware.
+** wiznetSpidevFailNext then makes messages fail as a broken ioctl would.
+**
+** A failed ioctl is latched and reported by wiznetSpidevError. Reads carried
+** by the failed message return zeros and its writes are lost.
+**
+************************************/
+
+#ifndef WIZNET_SPIDEV_MAX_TRANSFERS
+#define WIZNET_SPIDEV_MAX_TRANSFERS 32
+#endif
+#ifndef WIZNET_SPIDEV_BUFFER_SIZE
+#define WIZNET_SPIDEV_BUFFER_SIZE 4096    //spidev's default bufsiz
+#endif
+
+/* System call accounting for the spidev link
+*/
+struct wiznetSpidevStats {
+	uint32_t syscalls;     //SPI_IOC_MESSAGE ioctls that succeeded
+	uint32_t errors;       //SPI_IOC_MESSAGE ioctls that failed
+	uint32_t transfers;    //spi_ioc_transfer entries sent
+	uint32_t bytes;        //Bytes clocked on the bus
+};
+
+// SPI backend hooks, used by wiznet_arch.h
+uint8_t wiznetSpidevTransceiveByte(uint8_t data);
+void wiznetSpidevTransceiveBlock(const uint8_t* tx, uint8_t* rx, uint16_t len);
+void wiznetSpidevChipEnable(void);
+void wiznetSpidevChipDisable(void);
+int wiznetSpidevFlush(void);
+
+int wiznetSpidevOpen(const char* path, uint32_t speed);
+void wiznetSpidevClose(void);
+int wiznetSpidevError(void);
+#ifdef WIZNET_SPIDEV_STANDIN
+void wiznetSpidevFailNext(uint8_t count);
+#endif
+
+void wiznetSpidevGetStats(struct wiznetSpidevStats* stats);
+void wiznetSpidevResetStats(void);
+
+#endif
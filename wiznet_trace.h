@@ -0,0 +1,71 @@
+#ifndef WIZNET_TRACE_H
+#define WIZNET_TRACE_H
+#include <stdint.h>
+
+/*
+** SPI transaction trace
+**
+** With WIZNET_TRACE defined, wiznetIOBeginControl and wiznetIOFinish record
+** every SPI transaction in a ring of WIZNET_TRACE_DEPTH records: the block,
+** address and direction (the control byte as sent), the data-phase length,
+** the first WIZNET_TRACE_DATA data bytes, the call site, and the time the
+** chip was selected and for how long. With WIZNET_TRACE_HASH also defined,
+** a hash of the whole data phase is kept as well.
+**
+** wiznetTraceExport writes a wiznetTraceHeader followed by the records,
+** oldest first, in the byte order of the target. The host model can load,
+** replay and analyse such a trace, see wiznet_host.h.
+**
+** Call sites are stored as an offset from wiznetIOBegin, whose address is
+** in the header, so they can be resolved with addr2line against the image
+** that produced the trace. Register accesses are attributed to the code that
+** called the register helper, buffer accesses to the code that opened the
+** transaction.
+**
+************************************/
+
+#ifndef WIZNET_TRACE_DEPTH
+#define WIZNET_TRACE_DEPTH 64     //Records kept, 24 bytes each
+#endif
+#define WIZNET_TRACE_DATA 8       //Data bytes kept per record, enough for any register access
+#define WIZNET_TRACE_MAGIC 0x52543557UL    //"W5TR" when stored little-endian
+#define WIZNET_TRACE_VERSION 1
+
+enum {
+	WIZNET_TRACE_FLAG_HASH = 0x01    //Records carry a hash of the whole data phase
+};
+
+/* Header written ahead of the records. The layout has no padding on any of
+** the supported targets.
+*/
+struct wiznetTraceHeader {
+	uint32_t magic;
+	uint8_t version;
+	uint8_t recordSize;
+	uint8_t flags;
+	uint8_t reserved;
+	uint64_t siteBase;    //Address of wiznetIOBegin
+	uint32_t tickNs;      //Nanoseconds per time tick, 0 if times are sequence numbers
+	uint32_t count;       //Records that follow
+	uint32_t dropped;     //Records overwritten before the export
+};
+
+/* One SPI transaction
+*/
+struct wiznetTraceRecord {
+	uint32_t time;        //Timestamp when the chip was selected
+	int32_t site;         //Call site, as an offset from siteBase
+	uint16_t address;
+	uint16_t length;      //Data-phase bytes
+	uint16_t duration;    //Ticks until the chip was de-selected, saturating
+	uint8_t control;      //Control phase: BSB<<3 | RWB<<2 | OM
+	uint8_t hash;         //Data-phase hash with WIZNET_TRACE_HASH, otherwise 0
+	uint8_t data[WIZNET_TRACE_DATA];    //Leading data bytes, zero filled
+};
+
+typedef void (*wiznetTraceWriter)(void* ctx, const uint8_t* data, uint16_t length);
+
+void wiznetTraceReset(void);
+uint16_t wiznetTraceExport(wiznetTraceWriter writer, void* ctx);
+
+#endif